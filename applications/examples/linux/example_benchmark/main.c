@@ -0,0 +1,160 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "libspectrometer.h"
+
+/*
+ * Measures the throughput of the protocol paths that dominate acquisition time:
+ * the status round trip, getFrame(), getFrames() and readFlash().
+ *
+ * Run it against simulated devices to get reproducible numbers without hardware:
+ *     SPECTROMETER_VIRTUAL_DEVICES=1 ./libspectrometer-example-benchmark [iterations] [deviceIndex] [maxSpinMicroseconds]
+ *
+ * A non-zero maxSpinMicroseconds makes the reads spin before they sleep, see setBusyPollWindow().
+ *
+ * Against real hardware, compare the transports by running it once per backend:
+ *     ./libspectrometer-example-benchmark 1000
+ *     SPECTROMETER_IO_URING=1 ./libspectrometer-example-benchmark 1000
+ *     SPECTROMETER_BACKEND=libusb ./libspectrometer-example-benchmark 1000    (library built with -DWITH_LIBUSB=ON)
+ *     SPECTROMETER_BACKEND=usbfs ./libspectrometer-example-benchmark 1000
+ */
+
+#define DEFAULT_ITERATIONS 100
+#define BENCHMARK_EXPOSURE 10               //multiple of 10 us
+#define BENCHMARK_FRAMES 16
+#define BENCHMARK_WAIT_MILLISECONDS 1000
+#define BENCHMARK_FLASH_BYTES 0x20000
+#define PIXELS_IN_PACKET 30
+#define FLASH_BYTES_IN_PACKET 60
+
+double secondsSince(const struct timespec* const start)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+void printResult(const char* name, int iterations, double seconds, double packetsPerIteration)
+{
+    printf("%-12s %6d calls in %8.3f s: %10.1f calls/s, %8.1f us/call, %10.1f packets/s\n",
+           name, iterations, seconds, iterations / seconds, seconds * 1e6 / iterations, iterations * packetsPerIteration / seconds);
+}
+
+/* Splits the last exchange of the device into turnaround and transfer, see getLastTransferTimestamps() */
+void printLastTransfer(uintptr_t* deviceHandle)
+{
+    TransferTimestamps_t timestamps;
+
+    if (getLastTransferTimestamps(&timestamps, deviceHandle) != OK || !timestamps.lastReplyTime) {
+        return;
+    }
+
+    printf("%-12s first packet after %8.1f us, last packet after %8.1f us\n", "",
+           (timestamps.firstReplyTime - timestamps.requestTime) / 1e3, (timestamps.lastReplyTime - timestamps.requestTime) / 1e3);
+}
+
+int main(int argc, char* argv[])
+{
+    uintptr_t deviceHandle = 0;
+    uint16_t numOfPixelsInFrame = 0;
+    uint16_t* frameBuffer = NULL;
+    uint8_t* flashBuffer = NULL;
+    struct timespec start;
+    int iterations = (argc > 1)? atoi(argv[1]) : DEFAULT_ITERATIONS;
+    unsigned int deviceIndex = (argc > 2)? (unsigned int)atoi(argv[2]) : 0;
+    uint32_t maxSpinMicroseconds = (argc > 3)? (uint32_t)atoi(argv[3]) : 0;
+    int index = 0;
+    int result = OK;
+
+    if (iterations <= 0) {
+        iterations = DEFAULT_ITERATIONS;
+    }
+
+    result = connectToDeviceByIndex(deviceIndex, &deviceHandle);
+    if (result != OK) {
+        printf("failed to connect the device with index %u, error: %d\n", deviceIndex, result);
+        return EXIT_FAILURE;
+    }
+
+    if (maxSpinMicroseconds) {
+        result = setBusyPollWindow(maxSpinMicroseconds, &deviceHandle);
+        if (result != OK) {
+            printf("failed to set the busy poll window, error: %d\n", result);
+        }
+    }
+
+    result = getFrameFormat(NULL, NULL, NULL, &numOfPixelsInFrame, &deviceHandle);
+    if (result != OK) {
+        printf("failed to get frame format, error: %d\n", result);
+        disconnectDeviceContext(&deviceHandle);
+        return EXIT_FAILURE;
+    }
+
+    result = setAcquisitionParameters(BENCHMARK_FRAMES, 0, 0, BENCHMARK_EXPOSURE, &deviceHandle);
+    if (result == OK) {
+        result = triggerAcquisition(&deviceHandle);
+    }
+    if (result == OK) {
+        result = waitForFrames(BENCHMARK_FRAMES, BENCHMARK_WAIT_MILLISECONDS, NULL, NULL, &deviceHandle);
+    }
+    if (result != OK) {
+        printf("failed to acquire a frame, error: %d\n", result);
+        disconnectDeviceContext(&deviceHandle);
+        return EXIT_FAILURE;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (index = 0; index < iterations && result == OK; ++index) {
+        result = getStatus(NULL, NULL, &deviceHandle);
+    }
+    if (result != OK) {
+        printf("getStatus failed, error: %d\n", result);
+    } else {
+        printResult("getStatus", iterations, secondsSince(&start), 1);
+        printLastTransfer(&deviceHandle);
+    }
+
+    frameBuffer = (uint16_t*)calloc(BENCHMARK_FRAMES * numOfPixelsInFrame, sizeof(uint16_t));
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (index = 0; index < iterations && result == OK; ++index) {
+        result = getFrame(frameBuffer, 0, &deviceHandle);
+    }
+    if (result != OK) {
+        printf("getFrame failed, error: %d\n", result);
+    } else {
+        printResult("getFrame", iterations, secondsSince(&start), (numOfPixelsInFrame + PIXELS_IN_PACKET - 1) / PIXELS_IN_PACKET);
+        printLastTransfer(&deviceHandle);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (index = 0; index < iterations && result == OK; ++index) {
+        result = getFrames(frameBuffer, 0, BENCHMARK_FRAMES, &deviceHandle);
+    }
+    if (result != OK) {
+        printf("getFrames failed, error: %d\n", result);
+    } else {
+        printResult("getFrames", iterations, secondsSince(&start), BENCHMARK_FRAMES * ((numOfPixelsInFrame + PIXELS_IN_PACKET - 1) / PIXELS_IN_PACKET));
+        printLastTransfer(&deviceHandle);
+    }
+
+    flashBuffer = (uint8_t*)calloc(BENCHMARK_FLASH_BYTES, sizeof(uint8_t));
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (index = 0; index < iterations && result == OK; ++index) {
+        result = readFlash(flashBuffer, 0, BENCHMARK_FLASH_BYTES, &deviceHandle);
+    }
+    if (result != OK) {
+        printf("readFlash failed, error: %d\n", result);
+    } else {
+        printResult("readFlash", iterations, secondsSince(&start), (BENCHMARK_FLASH_BYTES + FLASH_BYTES_IN_PACKET - 1) / FLASH_BYTES_IN_PACKET);
+    }
+
+    free(frameBuffer);
+    free(flashBuffer);
+    disconnectDeviceContext(&deviceHandle);
+
+    return (result == OK)? EXIT_SUCCESS : EXIT_FAILURE;
+}
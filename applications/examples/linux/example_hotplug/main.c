@@ -0,0 +1,73 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <signal.h>
+#include <poll.h>
+
+#include "libspectrometer.h"
+
+/*
+ * Prints the spectrometers that are plugged in or unplugged until Ctrl+C is pressed.
+ * A supervisor would reconnect the device in onHotplug() instead of printing it.
+ */
+
+static volatile sig_atomic_t g_stop = 0;
+
+void onSignal(int signal)
+{
+    (void)signal;
+    g_stop = 1;
+}
+
+void onHotplug(uint8_t event, const char* serialNumber, void* userData)
+{
+    unsigned int* numOfDevices = (unsigned int*)userData;
+
+    if (event == HOTPLUG_DEVICE_ARRIVED) {
+        ++(*numOfDevices);
+        printf("connected:    %s (%u devices)\n", serialNumber, *numOfDevices);
+    } else {
+        --(*numOfDevices);
+        printf("disconnected: %s (%u devices)\n", serialNumber, *numOfDevices);
+    }
+    fflush(stdout);
+}
+
+int main()
+{
+    uintptr_t hotplugHandle = 0;
+    unsigned int numOfDevices = getDevicesCount();
+    struct pollfd fds;
+    int result = OK;
+
+    result = startHotplugMonitor(onHotplug, &numOfDevices, &hotplugHandle);
+    if (result == OK) {
+        result = getHotplugFileDescriptor(&fds.fd, &hotplugHandle);
+    }
+    if (result != OK) {
+        printf("failed to start the hotplug monitor, error: %d\n", result);
+        stopHotplugMonitor(&hotplugHandle);
+        return EXIT_FAILURE;
+    }
+
+    signal(SIGINT, onSignal);
+    signal(SIGTERM, onSignal);
+
+    printf("%u devices connected, waiting for changes\n", numOfDevices);
+
+    fds.events = POLLIN;
+    while (!g_stop && result == OK) {
+        if (poll(&fds, 1, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+
+        result = processHotplugEvents(&hotplugHandle);
+    }
+
+    stopHotplugMonitor(&hotplugHandle);
+
+    return (result == OK)? EXIT_SUCCESS : EXIT_FAILURE;
+}
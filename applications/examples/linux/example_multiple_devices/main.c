@@ -13,6 +13,7 @@
 #define FLASH_OFFSET 0
 #define FLASH_NUM_OF_BYTES_TO_READ 100
 #define FRAMES_REQUIRED 10
+#define WAIT_FOR_FRAME_MILLISECONDS 1000
 
 
 typedef struct {
@@ -356,7 +357,7 @@ void exampleReadFrames(ThreadInfo_t* const info)
         }
         mutexedPrint("success! Status flags (hex): %x\n", statusFlags);
 
-        if (statusFlags & 2) {
+        if (statusFlags & STATUS_MEMORY_FULL) {
             mutexedPrint("exampleReadFrames on device %d: memory is full!\n", info->index);
 
             mutexedPrint("exampleReadFrames on device %d: clearing memory... ", info->index);
@@ -380,8 +381,18 @@ void exampleReadFrames(ThreadInfo_t* const info)
         }
 
         if (!framesInMemory) {
-            sleep(1);
-            continue;
+            mutexedPrint("exampleReadFrames on device %d: waiting for a frame...", info->index);
+            result = waitForFrames(1, WAIT_FOR_FRAME_MILLISECONDS, &statusFlags, &framesInMemory, &(info->pDeviceContext));
+            if (result == WAIT_FOR_FRAMES_TIMEOUT) {
+                mutexedPrint("timed out\n");
+                continue;
+            }
+            if (result != OK) {
+                mutexedPrint("failed with code %d\n", result);
+                free(frameBuffer);
+                return;
+            }
+            mutexedPrint("success! Frames in memory: %d\n", framesInMemory);
         }
 
         if (framesInMemory) {
@@ -0,0 +1,210 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "libspectrometer.h"
+
+/*
+ * Collects frames from all connected devices with one thread: every device polls its status
+ * and reads a frame as soon as one is in memory, all driven by runReactor().
+ *
+ *     SPECTROMETER_VIRTUAL_DEVICES=16 ./libspectrometer-example-reactor [framesPerDevice]
+ */
+
+#define DEFAULT_FRAMES_REQUIRED 10
+#define EXPOSURE 100                    //multiple of 10 us
+#define STATUS_POLL_INTERVAL_MS 1
+#define MAX_DEVICES 64
+
+typedef enum {WAITING_FOR_STATUS, READING_FRAME, POLL_PENDING, DONE} DeviceState_t;
+
+typedef struct {
+    unsigned int index;
+    uintptr_t deviceContext;
+    DeviceState_t state;
+    uint8_t statusFlags;
+    uint16_t framesInMemory;
+    uint16_t* frameBuffer;
+    unsigned int framesCollected;
+    struct timespec nextPoll;
+    int result;
+} Device_t;
+
+static uintptr_t g_reactor = 0;
+static unsigned int g_framesRequired = DEFAULT_FRAMES_REQUIRED;
+
+void scheduleNextPoll(Device_t* device)
+{
+    clock_gettime(CLOCK_MONOTONIC, &device->nextPoll);
+    device->nextPoll.tv_nsec += STATUS_POLL_INTERVAL_MS * 1000000L;
+    if (device->nextPoll.tv_nsec >= 1000000000L) {
+        device->nextPoll.tv_nsec -= 1000000000L;
+        ++device->nextPoll.tv_sec;
+    }
+    device->state = POLL_PENDING;
+}
+
+void finish(Device_t* device, int result)
+{
+    device->result = result;
+    device->state = DONE;
+    if (result != OK) {
+        printf("device %u failed with error: %d\n", device->index, result);
+    }
+}
+
+void onRequestCompleted(int result, uintptr_t* deviceContextPtr, void* userData)
+{
+    Device_t* device = (Device_t*)userData;
+    (void)deviceContextPtr;
+
+    if (result != OK) {
+        finish(device, result);
+        return;
+    }
+
+    if (device->state == READING_FRAME) {
+        if (++device->framesCollected == g_framesRequired) {
+            finish(device, OK);
+            return;
+        }
+    } else if (device->framesInMemory) {
+        //the status reply: read the frame right away from this callback
+        result = submitGetFrame(device->frameBuffer, 0xFFFF, onRequestCompleted, device, &device->deviceContext, &g_reactor);
+        if (result != OK) {
+            finish(device, result);
+        } else {
+            device->state = READING_FRAME;
+        }
+        return;
+    }
+
+    scheduleNextPoll(device);
+}
+
+int isDue(const struct timespec* const time)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec > time->tv_sec) || (now.tv_sec == time->tv_sec && now.tv_nsec >= time->tv_nsec);
+}
+
+int main(int argc, char* argv[])
+{
+    Device_t* devices = NULL;
+    uintptr_t deviceContexts[MAX_DEVICES];
+    int connectResults[MAX_DEVICES];
+    uint32_t count = 0;
+    unsigned int index = 0, numOfDone = 0;
+    uint16_t numOfPixelsInFrame = 0;
+    struct timespec start, end;
+    int result = OK;
+
+    if (argc > 1 && atoi(argv[1]) > 0) {
+        g_framesRequired = (unsigned int)atoi(argv[1]);
+    }
+
+    //all the devices are opened in parallel from a single enumeration
+    result = connectAllDevices(deviceContexts, connectResults, MAX_DEVICES, &count);
+    printf("Number of devices: %u\n", count);
+    if (result != OK && result != CONNECT_ERROR_NOT_FOUND) {
+        printf("failed to connect the devices, error: %d\n", result);
+    }
+    for (index = 0; index < MAX_DEVICES; ++index) {
+        if (connectResults[index] != OK && connectResults[index] != CONNECT_ERROR_NOT_FOUND) {
+            printf("device %u failed to connect, error: %d\n", index, connectResults[index]);
+        }
+    }
+    if (!count) {
+        return EXIT_SUCCESS;
+    }
+
+    result = createReactor(&g_reactor);
+    if (result != OK) {
+        printf("failed to create the reactor, error: %d\n", result);
+        return EXIT_FAILURE;
+    }
+
+    devices = (Device_t*)calloc(count, sizeof(Device_t));
+
+    for (index = 0; index < count; ++index) {
+        Device_t* device = devices + index;
+        device->index = index;
+        device->state = DONE;
+        device->deviceContext = deviceContexts[index];
+
+        //the handle of a device that failed to connect is 0, its error was printed above
+        if (!device->deviceContext) {
+            device->result = connectResults[index];
+            continue;
+        }
+
+        result = setAcquisitionParameters(1, 0, 0, EXPOSURE, &device->deviceContext);
+        if (result == OK) {
+            result = getFrameFormat(NULL, NULL, NULL, &numOfPixelsInFrame, &device->deviceContext);
+        }
+        if (result == OK) {
+            result = addDeviceToReactor(&device->deviceContext, &g_reactor);
+        }
+        if (result == OK) {
+            result = triggerAcquisition(&device->deviceContext);
+        }
+        if (result != OK) {
+            printf("failed to prepare device %u, error: %d\n", index, result);
+            device->result = result;
+            continue;
+        }
+
+        device->frameBuffer = (uint16_t*)calloc(numOfPixelsInFrame, sizeof(uint16_t));
+        device->state = POLL_PENDING;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    while (result == OK) {
+        numOfDone = 0;
+
+        for (index = 0; index < count; ++index) {
+            Device_t* device = devices + index;
+
+            if (device->state == DONE) {
+                ++numOfDone;
+            } else if (device->state == POLL_PENDING && isDue(&device->nextPoll)) {
+                device->state = WAITING_FOR_STATUS;
+                if (submitGetStatus(&device->statusFlags, &device->framesInMemory, onRequestCompleted, device,
+                                    &device->deviceContext, &g_reactor) != OK) {
+                    finish(device, WRITING_PROCESS_FAILED);
+                }
+            }
+        }
+
+        if (numOfDone == count) {
+            break;
+        }
+
+        result = runReactor(STATUS_POLL_INTERVAL_MS, &g_reactor);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    for (index = 0; index < count; ++index) {
+        if (devices[index].result != OK) {
+            result = devices[index].result;
+        }
+        printf("device %u: %u frames\n", index, devices[index].framesCollected);
+
+        removeDeviceFromReactor(&devices[index].deviceContext, &g_reactor);
+        if (devices[index].deviceContext) {
+            disconnectDeviceContext(&devices[index].deviceContext);
+        }
+        free(devices[index].frameBuffer);
+    }
+
+    printf("%u devices, %.3f s\n", count, (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9);
+
+    destroyReactor(&g_reactor);
+    free(devices);
+
+    return (result == OK)? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,341 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <getopt.h>
+
+#include <linux/uhid.h>
+#include <linux/input.h>
+
+#include "virtual_device.h"
+
+/*
+ * Creates virtual E220:0100 spectrometers through /dev/uhid. The kernel exposes them as
+ * ordinary hidraw nodes, so the unmodified udev enumeration, hid_open_path() and the
+ * poll()/read() path of the library are exercised end to end.
+ *
+ * usage: libspectrometer-virtual-spectrometer-uhid [-n numOfDevices] [-i packetIntervalMicroseconds]
+ * (requires write access to /dev/uhid; stop it with Ctrl+C)
+ */
+
+#define MAX_DEVICES VIRTUAL_DEVICE_MAX_COUNT
+#define REPORT_SIZE 64
+#define INITIAL_QUEUE_CAPACITY 256
+
+/* Vendor defined collection with one 64 byte input and one 64 byte output report, no report IDs */
+static const unsigned char reportDescriptor[] = {
+    0x06, 0x00, 0xFF,       // Usage Page (Vendor Defined 0xFF00)
+    0x09, 0x01,             // Usage (0x01)
+    0xA1, 0x01,             // Collection (Application)
+    0x15, 0x00,             //   Logical Minimum (0)
+    0x26, 0xFF, 0x00,       //   Logical Maximum (255)
+    0x75, 0x08,             //   Report Size (8)
+    0x95, REPORT_SIZE,      //   Report Count (64)
+    0x09, 0x01,             //   Usage (0x01)
+    0x81, 0x02,             //   Input (Data, Var, Abs)
+    0x95, REPORT_SIZE,      //   Report Count (64)
+    0x09, 0x01,             //   Usage (0x01)
+    0x91, 0x02,             //   Output (Data, Var, Abs)
+    0xC0                    // End Collection
+};
+
+typedef struct {
+    unsigned char data[REPORT_SIZE];
+    unsigned long long dueTime;
+} QueuedReport_t;
+
+typedef struct {
+    int fd;
+    struct virtual_device* device;
+
+    QueuedReport_t* queue;
+    size_t queueHead;
+    size_t queueCount;
+    size_t queueCapacity;
+    unsigned long long nextReportTime;
+} UhidDevice_t;
+
+static volatile sig_atomic_t g_stop = 0;
+static unsigned long long g_packetIntervalNs = 0;
+
+void onSignal(int signal)
+{
+    (void)signal;
+    g_stop = 1;
+}
+
+unsigned long long monotonicNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+int writeEvent(int fd, const struct uhid_event* event)
+{
+    ssize_t result = write(fd, event, sizeof(*event));
+    if (result != sizeof(*event)) {
+        fprintf(stderr, "uhid write failed: %s\n", strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+int createDevice(UhidDevice_t* uhidDevice, unsigned int index)
+{
+    struct uhid_event event;
+    const char* serial = NULL;
+
+    uhidDevice->fd = open("/dev/uhid", O_RDWR | O_CLOEXEC);
+    if (uhidDevice->fd < 0) {
+        fprintf(stderr, "Can't open /dev/uhid: %s\n", strerror(errno));
+        return -1;
+    }
+
+    uhidDevice->device = virtual_device_new(index);
+    if (!uhidDevice->device) {
+        fprintf(stderr, "Can't create the firmware model of device %u\n", index);
+        close(uhidDevice->fd);
+        return -1;
+    }
+    serial = virtual_device_serial(uhidDevice->device);
+
+    memset(&event, 0, sizeof(event));
+    event.type = UHID_CREATE2;
+    snprintf((char*)event.u.create2.name, sizeof(event.u.create2.name), "Virtual spectrometer %u", index);
+    snprintf((char*)event.u.create2.phys, sizeof(event.u.create2.phys), "uhid-spectrometer/%u", index);
+    snprintf((char*)event.u.create2.uniq, sizeof(event.u.create2.uniq), "%s", serial);
+    memcpy(event.u.create2.rd_data, reportDescriptor, sizeof(reportDescriptor));
+    event.u.create2.rd_size = sizeof(reportDescriptor);
+    /* hid_enumerate() skips BUS_USB devices without a USB parent node, which uhid devices never have.
+       For BUS_BLUETOOTH it takes the serial number from HID_UNIQ, i.e. the uniq field above. */
+    event.u.create2.bus = BUS_BLUETOOTH;
+    event.u.create2.vendor = VIRTUAL_DEVICE_VID;
+    event.u.create2.product = VIRTUAL_DEVICE_PID;
+
+    if (writeEvent(uhidDevice->fd, &event) != 0) {
+        close(uhidDevice->fd);
+        virtual_device_free(uhidDevice->device);
+        return -1;
+    }
+
+    printf("Created virtual spectrometer %u (serial %s)\n", index, serial);
+    return 0;
+}
+
+void destroyDevice(UhidDevice_t* uhidDevice)
+{
+    struct uhid_event event;
+
+    memset(&event, 0, sizeof(event));
+    event.type = UHID_DESTROY;
+    writeEvent(uhidDevice->fd, &event);
+
+    close(uhidDevice->fd);
+    virtual_device_free(uhidDevice->device);
+    free(uhidDevice->queue);
+}
+
+/* Called by the firmware model for every reply report: the report is sent when it is due */
+void queueReport(void* context, const unsigned char* report, size_t length)
+{
+    UhidDevice_t* uhidDevice = (UhidDevice_t*)context;
+    QueuedReport_t* queued = NULL;
+    QueuedReport_t* queue = NULL;
+    size_t capacity = 0;
+    unsigned long long now = monotonicNs();
+
+    if (uhidDevice->queueHead + uhidDevice->queueCount == uhidDevice->queueCapacity) {
+        memmove(uhidDevice->queue, uhidDevice->queue + uhidDevice->queueHead, uhidDevice->queueCount * sizeof(QueuedReport_t));
+        uhidDevice->queueHead = 0;
+
+        if (uhidDevice->queueCount == uhidDevice->queueCapacity) {
+            capacity = uhidDevice->queueCapacity? 2 * uhidDevice->queueCapacity : INITIAL_QUEUE_CAPACITY;
+            queue = (QueuedReport_t*)realloc(uhidDevice->queue, capacity * sizeof(QueuedReport_t));
+            if (!queue) {
+                /* The reports queued so far are kept, the host sees this one as lost */
+                fprintf(stderr, "Out of memory, a report was dropped\n");
+                return;
+            }
+            uhidDevice->queue = queue;
+            uhidDevice->queueCapacity = capacity;
+        }
+    }
+
+    if (uhidDevice->nextReportTime < now) {
+        uhidDevice->nextReportTime = now;
+    }
+
+    queued = uhidDevice->queue + uhidDevice->queueHead + uhidDevice->queueCount;
+    memset(queued->data, 0, sizeof(queued->data));
+    memcpy(queued->data, report, (length > REPORT_SIZE)? REPORT_SIZE : length);
+    queued->dueTime = uhidDevice->nextReportTime;
+
+    uhidDevice->nextReportTime += g_packetIntervalNs;
+    ++uhidDevice->queueCount;
+}
+
+/* Sends the reports that are due and returns the time until the next one in ms (-1 if none) */
+int flushReports(UhidDevice_t* uhidDevice, unsigned long long now)
+{
+    struct uhid_event event;
+
+    while (uhidDevice->queueCount) {
+        QueuedReport_t* queued = uhidDevice->queue + uhidDevice->queueHead;
+
+        if (queued->dueTime > now) {
+            return (int)((queued->dueTime - now + 999999ULL) / 1000000ULL);
+        }
+
+        memset(&event, 0, sizeof(event));
+        event.type = UHID_INPUT2;
+        event.u.input2.size = REPORT_SIZE;
+        memcpy(event.u.input2.data, queued->data, REPORT_SIZE);
+        writeEvent(uhidDevice->fd, &event);
+
+        ++uhidDevice->queueHead;
+        --uhidDevice->queueCount;
+    }
+
+    uhidDevice->queueHead = 0;
+    return -1;
+}
+
+void handleEvent(UhidDevice_t* uhidDevice)
+{
+    struct uhid_event event;
+    const unsigned char* data = NULL;
+    size_t size = 0;
+    ssize_t result;
+
+    result = read(uhidDevice->fd, &event, sizeof(event));
+    if (result <= 0) {
+        return;
+    }
+
+    switch (event.type) {
+        case UHID_OUTPUT:
+            if (event.u.output.rtype != UHID_OUTPUT_REPORT) {
+                break;
+            }
+
+            data = event.u.output.data;
+            size = event.u.output.size;
+
+            /* hidraw passes the report ID byte through, it is 0 for unnumbered reports */
+            if (size > REPORT_SIZE && data[0] == 0) {
+                ++data;
+                --size;
+            }
+
+            virtual_device_handle_report(uhidDevice->device, data, size, queueReport, uhidDevice);
+            break;
+
+        case UHID_GET_REPORT: {
+            struct uhid_event reply;
+
+            memset(&reply, 0, sizeof(reply));
+            reply.type = UHID_GET_REPORT_REPLY;
+            reply.u.get_report_reply.id = event.u.get_report.id;
+            reply.u.get_report_reply.err = EIO;
+            writeEvent(uhidDevice->fd, &reply);
+            break;
+        }
+
+        case UHID_SET_REPORT: {
+            struct uhid_event reply;
+
+            memset(&reply, 0, sizeof(reply));
+            reply.type = UHID_SET_REPORT_REPLY;
+            reply.u.set_report_reply.id = event.u.set_report.id;
+            reply.u.set_report_reply.err = EIO;
+            writeEvent(uhidDevice->fd, &reply);
+            break;
+        }
+
+        default:
+            //UHID_START, UHID_STOP, UHID_OPEN, UHID_CLOSE: nothing to do
+            break;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    UhidDevice_t devices[MAX_DEVICES];
+    struct pollfd fds[MAX_DEVICES];
+    unsigned int numOfDevices = 1;
+    unsigned int index = 0;
+    int option = 0;
+
+    while ((option = getopt(argc, argv, "n:i:h")) != -1) {
+        switch (option) {
+            case 'n':
+                numOfDevices = (unsigned int)atoi(optarg);
+                break;
+            case 'i':
+                g_packetIntervalNs = strtoull(optarg, NULL, 10) * 1000ULL;
+                break;
+            default:
+                printf("usage: %s [-n numOfDevices] [-i packetIntervalMicroseconds]\n", argv[0]);
+                return (option == 'h')? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+
+    if (numOfDevices == 0 || numOfDevices > MAX_DEVICES) {
+        printf("numOfDevices should be between 1 and %d\n", MAX_DEVICES);
+        return EXIT_FAILURE;
+    }
+
+    signal(SIGINT, onSignal);
+    signal(SIGTERM, onSignal);
+
+    memset(devices, 0, sizeof(devices));
+    for (index = 0; index < numOfDevices; ++index) {
+        if (createDevice(devices + index, index) != 0) {
+            while (index--) {
+                destroyDevice(devices + index);
+            }
+            return EXIT_FAILURE;
+        }
+
+        fds[index].fd = devices[index].fd;
+        fds[index].events = POLLIN;
+    }
+
+    while (!g_stop) {
+        unsigned long long now = monotonicNs();
+        int timeout = -1;
+
+        for (index = 0; index < numOfDevices; ++index) {
+            int deviceTimeout = flushReports(devices + index, now);
+            if (deviceTimeout >= 0 && (timeout < 0 || deviceTimeout < timeout)) {
+                timeout = deviceTimeout;
+            }
+        }
+
+        if (poll(fds, numOfDevices, timeout) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            fprintf(stderr, "poll failed: %s\n", strerror(errno));
+            break;
+        }
+
+        for (index = 0; index < numOfDevices; ++index) {
+            if (fds[index].revents & POLLIN) {
+                handleEvent(devices + index);
+            }
+        }
+    }
+
+    for (index = 0; index < numOfDevices; ++index) {
+        destroyDevice(devices + index);
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,108 @@
+/*******************************************************
+ libusb report transport
+
+ Alternative backend of the Linux hidapi layer that claims the HID
+ interface with libusb and moves the reports with asynchronous interrupt
+ transfers. Several IN transfers stay submitted at all times, so the host
+ controller always has a buffer for the next packet of a getFrame() or
+ readFlash() burst, and the reports skip the hidraw queue and its copy.
+
+ Built when the library is configured with -DWITH_LIBUSB=ON, selected at
+ connect time with SPECTROMETER_BACKEND=libusb. Opening falls back to
+ hidraw when the interface can't be claimed (permissions, busy device).
+********************************************************/
+
+#ifndef HID_LIBUSB_H__
+#define HID_LIBUSB_H__
+
+#include <stddef.h>
+#include <wchar.h>
+
+#define HID_BACKEND_ENV "SPECTROMETER_BACKEND"
+#define HID_BACKEND_LIBUSB "libusb"
+
+/* IN transfers kept submitted */
+#define HID_LIBUSB_IN_TRANSFERS 8
+/* Reports received but not read yet; the oldest are dropped beyond that, like hidraw does */
+#define HID_LIBUSB_QUEUE_LENGTH 256
+#define HID_LIBUSB_MAX_REPORT_SIZE 64
+#define HID_LIBUSB_WRITE_TIMEOUT_MS 1000
+
+#define HID_LIBUSB_STRING_MANUFACTURER 0
+#define HID_LIBUSB_STRING_PRODUCT 1
+#define HID_LIBUSB_STRING_SERIAL 2
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct hid_libusb;
+
+#ifdef HIDAPI_WITH_LIBUSB
+
+/* Returns 1 if SPECTROMETER_BACKEND selects libusb. */
+int hid_libusb_requested(void);
+
+/* Claims the HID interface interface_number of the USB device busnum:devnum, or returns NULL. */
+struct hid_libusb *hid_libusb_open(int busnum, int devnum, int interface_number);
+
+/* Cancels the transfers and gives the interface back to the kernel driver. */
+void hid_libusb_close(struct hid_libusb *dev);
+
+/* Same contracts as hid_write() and hid_read_timeout(). */
+int hid_libusb_write(struct hid_libusb *dev, const unsigned char *data, size_t length);
+int hid_libusb_read_timeout(struct hid_libusb *dev, unsigned char *data, size_t length, int milliseconds);
+
+/* Reads one of the HID_LIBUSB_STRING_* string descriptors of the device. */
+int hid_libusb_get_string(struct hid_libusb *dev, int string_id, wchar_t *string, size_t maxlen);
+
+#else
+
+/* Built without libusb: the backend is never selected and hidraw is used */
+static inline int hid_libusb_requested(void) { return 0; }
+static inline struct hid_libusb *hid_libusb_open(int busnum, int devnum, int interface_number)
+{
+	(void)busnum;
+	(void)devnum;
+	(void)interface_number;
+	return NULL;
+}
+
+static inline void hid_libusb_close(struct hid_libusb *dev)
+{
+	(void)dev;
+}
+
+static inline int hid_libusb_write(struct hid_libusb *dev, const unsigned char *data, size_t length)
+{
+	(void)dev;
+	(void)data;
+	(void)length;
+	return -1;
+}
+
+static inline int hid_libusb_read_timeout(struct hid_libusb *dev, unsigned char *data, size_t length, int milliseconds)
+{
+	(void)dev;
+	(void)data;
+	(void)length;
+	(void)milliseconds;
+	return -1;
+}
+
+static inline int hid_libusb_get_string(struct hid_libusb *dev, int string_id, wchar_t *string, size_t maxlen)
+{
+	(void)dev;
+	(void)string_id;
+	(void)string;
+	(void)maxlen;
+	return -1;
+}
+
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
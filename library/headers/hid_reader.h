@@ -0,0 +1,59 @@
+/*******************************************************
+ Reader thread report transport
+
+ Optional input path of the Linux hidapi backend. A thread per device
+ drains the hidraw descriptor as soon as reports arrive and stores them,
+ stamped with their arrival time, in a preallocated single-producer /
+ single-consumer ring. hid_read_timeout() then takes the reports from the
+ ring without a system call, and the small hidraw queue never overflows
+ while the protocol thread is busy elsewhere.
+
+ The thread signals new reports through an eventfd, which is also the
+ descriptor hid_get_fd() returns, so the device still works with poll()
+ and the reactor. Output reports keep using write(2) directly.
+
+ Enabled by the SPECTROMETER_READER_THREAD environment variable; takes
+ precedence over SPECTROMETER_IO_URING.
+********************************************************/
+
+#ifndef HID_READER_H__
+#define HID_READER_H__
+
+#include <stddef.h>
+
+#define HID_READER_ENV "SPECTROMETER_READER_THREAD"
+
+/* Reports the ring holds, a power of 2; the thread stops draining hidraw while it is full */
+#define HID_READER_RING_LENGTH 1024
+/* Largest input report stored, longer reports are truncated like by read(2) */
+#define HID_READER_REPORT_SIZE 64
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct hid_reader;
+
+/* Returns 1 if SPECTROMETER_READER_THREAD is set to anything but "0". */
+int hid_reader_enabled(void);
+
+/* Starts the thread reading from fd, which must be non-blocking, or returns NULL. */
+struct hid_reader *hid_reader_new(int fd);
+
+/* Stops the thread; fd must stay open until then. */
+void hid_reader_free(struct hid_reader *reader);
+
+/* Descriptor that becomes readable when a report is in the ring. */
+int hid_reader_get_fd(struct hid_reader *reader);
+
+/* Same contract as hid_read_timeout(); time_ns receives the CLOCK_MONOTONIC_RAW arrival time of the report. */
+int hid_reader_read(struct hid_reader *reader, unsigned char *data, size_t length, int milliseconds, long long *time_ns);
+
+/* Takes a report from the ring without any system call, 0 if there is none. */
+int hid_reader_read_completed(struct hid_reader *reader, unsigned char *data, size_t length, long long *time_ns);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
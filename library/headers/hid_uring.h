@@ -0,0 +1,59 @@
+/*******************************************************
+ io_uring report transport
+
+ Optional input path of the Linux hidapi backend. A chain of reads is kept
+ posted on the device descriptor, so the reports of a burst complete in
+ the kernel while the previous ones are being processed, and one
+ io_uring_enter() both re-arms the chain and waits, where hid_read_timeout()
+ otherwise costs a poll() and a read() per report.
+
+ The reads of a chain are hard-linked: they execute one after another,
+ which keeps the reports in arrival order. Output reports keep using
+ write(2) directly.
+
+ Enabled by the SPECTROMETER_IO_URING environment variable; any failure to
+ set the ring up (old kernel, io_uring disabled by seccomp or sysctl)
+ falls back silently to poll() and read().
+********************************************************/
+
+#ifndef HID_URING_H__
+#define HID_URING_H__
+
+#include <stddef.h>
+
+#define HID_URING_ENV "SPECTROMETER_IO_URING"
+
+/* Reads posted at once; a frame of 124 reports needs 4 chains */
+#define HID_URING_DEPTH 32
+/* Largest input report delivered, longer reports are truncated like by read(2) */
+#define HID_URING_REPORT_SIZE 256
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct hid_uring;
+
+/* Returns 1 if SPECTROMETER_IO_URING is set to anything but "0". */
+int hid_uring_enabled(void);
+
+/* Sets up a ring reading from fd, or returns NULL if io_uring is unavailable. */
+struct hid_uring *hid_uring_new(int fd);
+
+void hid_uring_free(struct hid_uring *ring);
+
+/* Descriptor that becomes readable when a report has completed, or -1 on error.
+   Submits the reads queued so far, the calling thread must outlive them like a reading one. */
+int hid_uring_get_fd(struct hid_uring *ring);
+
+/* Same contract as hid_read_timeout(): the report length, 0 on timeout or -1 on error. */
+int hid_uring_read(struct hid_uring *ring, unsigned char *data, size_t length, int milliseconds);
+
+/* Takes a report that has already completed without entering the kernel, 0 if there is none. */
+int hid_uring_read_completed(struct hid_uring *ring, unsigned char *data, size_t length);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,62 @@
+/*******************************************************
+ usbfs report transport
+
+ Alternative backend of the Linux hidapi layer that claims the HID
+ interface through /dev/bus/usb and moves the input reports with
+ asynchronous interrupt URBs (USBDEVFS_SUBMITURB / USBDEVFS_REAPURBNDELAY).
+ Several URBs stay submitted at all times, so the host controller always
+ has a buffer for the next packet of a burst, like with the libusb
+ backend but with nothing more than the kernel headers.
+
+ Selected at connect time with SPECTROMETER_BACKEND=usbfs. Opening falls
+ back to hidraw when the interface can't be claimed (permissions, busy
+ device).
+********************************************************/
+
+#ifndef HID_USBFS_H__
+#define HID_USBFS_H__
+
+#include <stddef.h>
+#include <wchar.h>
+
+#ifndef HID_BACKEND_ENV
+#define HID_BACKEND_ENV "SPECTROMETER_BACKEND"
+#endif
+#define HID_BACKEND_USBFS "usbfs"
+
+/* Interrupt IN URBs kept submitted */
+#define HID_USBFS_URBS 8
+#define HID_USBFS_MAX_REPORT_SIZE 64
+#define HID_USBFS_WRITE_TIMEOUT_MS 1000
+
+#define HID_USBFS_STRING_MANUFACTURER 0
+#define HID_USBFS_STRING_PRODUCT 1
+#define HID_USBFS_STRING_SERIAL 2
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct hid_usbfs;
+
+/* Returns 1 if SPECTROMETER_BACKEND selects usbfs. */
+int hid_usbfs_requested(void);
+
+/* Claims the HID interface interface_number of the USB device busnum:devnum, or returns NULL. */
+struct hid_usbfs *hid_usbfs_open(int busnum, int devnum, int interface_number);
+
+/* Discards the URBs and gives the interface back to the kernel driver. */
+void hid_usbfs_close(struct hid_usbfs *dev);
+
+/* Same contracts as hid_write() and hid_read_timeout(). */
+int hid_usbfs_write(struct hid_usbfs *dev, const unsigned char *data, size_t length);
+int hid_usbfs_read_timeout(struct hid_usbfs *dev, unsigned char *data, size_t length, int milliseconds);
+
+/* Reads one of the HID_USBFS_STRING_* string descriptors of the device. */
+int hid_usbfs_get_string(struct hid_usbfs *dev, int string_id, wchar_t *string, size_t maxlen);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
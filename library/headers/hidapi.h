@@ -223,6 +223,79 @@ extern "C" {
 		*/
 		int HID_API_EXPORT HID_API_CALL hid_read_timeout(hid_device *dev, unsigned char *data, size_t length, int milliseconds);
 
+		/** @brief Read every Input report already queued, after waiting for the first one.
+
+			Waits like hid_read_timeout() for one report, then takes
+			the reports the device has queued meanwhile without waiting
+			again, up to @p max_reports. Bursts of reports (e.g. the
+			packets of one request) thus cost one wait per batch
+			instead of one per report.
+
+			@ingroup API
+			@param device A device handle returned from hid_open().
+			@param data A buffer of @p max_reports slots of
+				@p report_length bytes each. Report i is stored at
+				data + i * report_length.
+			@param report_length The number of bytes of a report. A
+				shorter report is dropped: it ends the batch, or makes
+				the call return -1 if it is the first one.
+			@param max_reports The number of slots in @p data.
+			@param milliseconds timeout for the first report in
+				milliseconds or -1 for blocking wait.
+
+			@returns
+				This function returns the number of reports read, 0 if
+				none arrived within the timeout period and -1 on error.
+				An error after the first report ends the batch and is
+				returned by the next call.
+		*/
+		int HID_API_EXPORT HID_API_CALL hid_read_many(hid_device *dev, unsigned char *data, size_t report_length, size_t max_reports, int milliseconds);
+
+		/** @brief Get the arrival times of the reports of the last read.
+
+			Covers the reports returned by the last call to
+			hid_read_timeout() or hid_read_many(): @p first_ns is the
+			arrival time of the first of them, @p last_ns of the last
+			one. With the reader thread (SPECTROMETER_READER_THREAD)
+			the reports are stamped when the thread takes them from the
+			kernel, otherwise when hid_read_timeout() or
+			hid_read_many() returns them.
+
+			@ingroup API
+			@param device A device handle returned from hid_open().
+			@param first_ns The CLOCK_MONOTONIC_RAW time in nanoseconds.
+			@param last_ns The CLOCK_MONOTONIC_RAW time in nanoseconds.
+
+			@returns
+				This function returns 0 on success and -1 if no report
+				was read yet or on platforms without report times.
+		*/
+		int HID_API_EXPORT HID_API_CALL hid_get_report_times(hid_device *device, long long *first_ns, long long *last_ns);
+
+		/** @brief Make reads spin before they block.
+
+			With a spin window set, hid_read_timeout() and
+			hid_read_many() keep polling the device without sleeping
+			for up to that time before they wait in poll(). A report
+			arriving meanwhile is taken without the scheduler wakeup
+			of a sleeping thread, at the cost of one busy CPU.
+
+			The actual window follows the gaps observed between the
+			reports of a burst (twice their moving average), bounded
+			by @p max_spin_us, so a device that answers slower than
+			the window doesn't burn CPU for nothing.
+
+			@ingroup API
+			@param device A device handle returned from hid_open().
+			@param max_spin_us The largest spin window in
+				microseconds, 0 to block right away (the default).
+
+			@returns
+				This function returns 0 on success and -1 on error or
+				on platforms without busy polling.
+		*/
+		int HID_API_EXPORT HID_API_CALL hid_set_busy_poll(hid_device *device, int max_spin_us);
+
 		/** @brief Read an Input report from a HID device.
 
 			Input reports are returned
@@ -383,6 +456,80 @@ extern "C" {
 		*/
 		HID_API_EXPORT const wchar_t* HID_API_CALL hid_error(hid_device *device);
 
+		/** @brief Get the file descriptor the device reads from.
+
+			The descriptor becomes readable when an input report is
+			queued, which lets callers wait on many devices at once
+			with poll(), select() or epoll. It belongs to the device
+			and must not be closed or read from directly.
+
+			@ingroup API
+			@param device A device handle returned from hid_open().
+
+			@returns
+				This function returns the file descriptor, or -1 on
+				platforms without one.
+		*/
+		int HID_API_EXPORT HID_API_CALL hid_get_fd(hid_device *device);
+
+		struct hid_hotplug_monitor_;
+		typedef struct hid_hotplug_monitor_ hid_hotplug_monitor; /**< opaque hotplug monitor structure */
+
+		/** Hotplug event types */
+		enum hid_hotplug_event {
+			HID_HOTPLUG_EVENT_ARRIVED = 1, /**< A matching device was connected */
+			HID_HOTPLUG_EVENT_LEFT = 2,    /**< A matching device was disconnected */
+		};
+
+		/** @brief Start watching for matching devices being connected or disconnected.
+
+			Devices present when the monitor is created are not reported.
+
+			@ingroup API
+			@param vendor_id The Vendor ID (VID) of the types of device
+				to watch (0 matches any).
+			@param product_id The Product ID (PID) of the types of
+				device to watch (0 matches any).
+
+			@returns
+				This function returns a monitor or NULL if hotplug
+				notifications are not available on this platform.
+		*/
+		HID_API_EXPORT hid_hotplug_monitor * HID_API_CALL hid_hotplug_monitor_new(unsigned short vendor_id, unsigned short product_id);
+
+		/** @brief Get a file descriptor that becomes readable when events may be pending.
+
+			@ingroup API
+			@param monitor A monitor returned from hid_hotplug_monitor_new().
+
+			@returns
+				This function returns the descriptor or -1 on error.
+		*/
+		int HID_API_EXPORT HID_API_CALL hid_hotplug_monitor_get_fd(hid_hotplug_monitor *monitor);
+
+		/** @brief Fetch the next pending hotplug event without blocking.
+
+			@ingroup API
+			@param monitor A monitor returned from hid_hotplug_monitor_new().
+			@param event Receives one of the hid_hotplug_event values.
+			@param device Receives the device description (a one element
+				list to be freed with hid_free_enumeration()). For
+				departed devices it is the description from the time
+				the device was last seen.
+
+			@returns
+				This function returns 1 if an event was returned, 0 if
+				no event is pending and -1 on error.
+		*/
+		int HID_API_EXPORT HID_API_CALL hid_hotplug_monitor_receive(hid_hotplug_monitor *monitor, int *event, struct hid_device_info **device);
+
+		/** @brief Stop watching and free the monitor.
+
+			@ingroup API
+			@param monitor A monitor returned from hid_hotplug_monitor_new().
+		*/
+		void HID_API_EXPORT HID_API_CALL hid_hotplug_monitor_free(hid_hotplug_monitor *monitor);
+
 #ifdef __cplusplus
 }
 #endif
@@ -21,13 +21,16 @@
 #define STANDARD_TIMEOUT_MILLISECONDS 100
 #define ERASE_FLASH_TIMEOUT_MILLISECONDS 5000
 
-#define PACKET_SIZE 64
+#define PACKET_SIZE 64 //bytes of a reply, which is read without the report ID
 #define EXTENDED_PACKET_SIZE 1 + PACKET_SIZE //bytes
 #define MAX_PACKETS_IN_FRAME 124
 #define REMAINING_PACKETS_ERROR 250
 #define NUM_OF_PIXELS_IN_PACKET 30
 #define MAX_READ_FLASH_PACKETS 100
 #define MAX_FLASH_WRITE_PAYLOAD 58
+#define READ_FLASH_PAYLOAD (PACKET_SIZE - 4)
+#define MAX_SERIAL_NUMBER_LENGTH 126 //characters, the longest USB string descriptor
+#define LAST_FRAME 0xFFFF //numOfFrame of the last captured or the averaged frame
 
 #define ZERO_REPORT_ID 0
 
@@ -80,20 +83,72 @@ typedef unsigned char uint8_t;
 typedef unsigned short uint16_t;
 typedef unsigned int uint32_t;
 
+#ifndef TRANSFER_TIMESTAMPS
+#define TRANSFER_TIMESTAMPS
+typedef struct TransferTimestamps_t{
+      int64_t requestTime;
+      int64_t firstReplyTime;
+      int64_t lastReplyTime;
+} TransferTimestamps_t;
+#endif
+
+/* Flags of DeviceParameters_t.knownParameters */
+#define KNOWN_ACQUISITION_PARAMETERS 0x01   // numOfScans, numOfBlankScans, scanMode
+#define KNOWN_EXPOSURE 0x02
+#define KNOWN_EXTERNAL_TRIGGER 0x04
+#define KNOWN_OPTICAL_TRIGGER 0x08
+#define KNOWN_FRAME_FORMAT 0x10             // numOfStartElement, numOfEndElement, reductionMode and numOfPixelsInFrame of the context
+
+/* Copy of the device configuration, a value is only used while its flag says the device has it */
+typedef struct DeviceParameters_t {
+    uint8_t knownParameters;
+    uint16_t numOfScans;
+    uint16_t numOfBlankScans;
+    uint8_t scanMode;
+    uint32_t timeOfExposure;
+    uint8_t triggerEnableMode;
+    uint8_t triggerFront;
+    uint8_t opticalTriggerMode;
+    uint16_t opticalTriggerPixel;
+    uint16_t opticalTriggerThreshold;
+    uint16_t numOfStartElement;
+    uint16_t numOfEndElement;
+    uint8_t reductionMode;
+} DeviceParameters_t;
+
 typedef struct DeviceContext_t {
     hid_device*  handle;
     uint16_t numOfPixelsInFrame;
     char* serial;
+    TransferTimestamps_t timestamps; // of the last request/reply exchange
+    DeviceParameters_t parameters;
+    int64_t triggerTime;             // when triggerAcquisition() was sent, 0 if unknown
+    uint32_t numOfReconnections;     // times _reconnect() replaced the handle
 } DeviceContext_t;
 
 #ifndef DEVICE_INFO
 #define DEVICE_INFO
 typedef struct DeviceInfo_t{
       char* serialNumber;
+      char* path;
       struct DeviceInfo_t *next;
 } DeviceInfo_t;
 #endif
 
+#ifndef HOTPLUG_CALLBACK
+#define HOTPLUG_CALLBACK
+typedef void (*HotplugCallback_t)(uint8_t event, const char* serialNumber, void* userData);
+#endif
+
+typedef struct HotplugContext_t {
+    hid_hotplug_monitor* monitor;
+    HotplugCallback_t callback;
+    void* userData;
+} HotplugContext_t;
+
+/* Sleeps of _waitForFrames(), returns false to cancel the wait */
+typedef bool (*SleepFunction_t)(int64_t nanoseconds, void* userData);
+
 extern const DeviceContext_t NULL_DEVICE_CONTEXT;
 
 int connectToDeviceBySerial(const char * const serialNumber,  uintptr_t* deviceContextPtr);
@@ -102,9 +157,27 @@ int _verifyDeviceContextByPtr(const uintptr_t* const deviceContextPtr);
 
 int _reconnect(uintptr_t* deviceContextPtr);
 void _recursiveClearing(DeviceInfo_t * const devices);
+int64_t _transferClockNanoseconds(void);
+void _stampRequest(DeviceContext_t* deviceContext);
+void _stampReplies(DeviceContext_t* deviceContext, bool firstOfReply);
 int _tryWrite(unsigned char* const report, uintptr_t* deviceContextPtr);
 int _tryRead(unsigned char * const report, unsigned char correctAnswer, uint16_t timeout, uintptr_t* deviceContextPtr);
 int _writeOnlyFunction(unsigned char * const report, uintptr_t* deviceContextPtr);
 int _writeReadFunction(unsigned char* const report, uint8_t correctReply, uint16_t timeout, uintptr_t* deviceContextPtr);
+int _waitForFrames(uint16_t numOfFrames, uint32_t timeoutMilliseconds, uint8_t *statusFlags, uint16_t *framesInMemory,
+                   SleepFunction_t sleepFunction, void* sleepUserData, uintptr_t* deviceContextPtr);
+
+void _fillSetFrameFormatRequest(unsigned char* const report, uint16_t numOfStartElement, uint16_t numOfEndElement, uint8_t reductionMode);
+void _fillSetExposureRequest(unsigned char* const report, uint32_t timeOfExposure, uint8_t force);
+void _fillSetAcquisitionParametersRequest(unsigned char* const report, uint8_t request, uint16_t numOfScans, uint16_t numOfBlankScans,
+                                          uint8_t scanMode, uint32_t timeOfExposure, uint8_t enableMode, uint8_t signalFrontMode);
+void _fillSetExternalTriggerRequest(unsigned char* const report, uint8_t enableMode, uint8_t signalFrontMode);
+void _fillSetOpticalTriggerRequest(unsigned char* const report, uint8_t enableMode, uint16_t pixel, uint16_t threshold);
+void _fillGetFrameRequest(unsigned char* const report, uint16_t pixelOffset, uint16_t numOfFrame, uint8_t numOfPackets);
+int _parseGetFramePacket(const unsigned char* const report, uint8_t numOfPacketsToGet, uint8_t numOfPacketsReceived,
+                         uint16_t numOfFirstPixel, uint16_t endOfPixels, uint16_t* pixelsBuffer, uint8_t* numOfPacketsLeft);
+void _fillReadFlashRequest(unsigned char* const report, uint32_t absoluteOffset, uint8_t numOfPackets);
+int _parseReadFlashPacket(const unsigned char* const report, uint8_t numOfPacketsToGet, uint8_t numOfPacketsReceived,
+                          uint32_t bytesToRead, uint8_t* buffer, uint8_t* numOfPacketsLeft);
 
 #endif
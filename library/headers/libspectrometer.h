@@ -43,10 +43,75 @@ typedef unsigned int uint32_t;
 #define DEVICE_INFO
 typedef struct DeviceInfo_t{
       char* serialNumber;
+      char* path;
       struct DeviceInfo_t *next;
 } DeviceInfo_t;
 #endif
 
+#ifndef TRANSFER_TIMESTAMPS
+#define TRANSFER_TIMESTAMPS
+/** \brief Times of the last request/reply exchange of a device, see getLastTransferTimestamps()
+
+    Nanoseconds of CLOCK_MONOTONIC_RAW on Linux and of the performance counter on Windows,
+    0 for a time that wasn't taken.
+
+    \ingroup API
+*/
+typedef struct TransferTimestamps_t{
+      int64_t requestTime;      // when the request was handed to the system
+      int64_t firstReplyTime;   // arrival of the first packet of the reply
+      int64_t lastReplyTime;    // arrival of the last packet of the reply
+} TransferTimestamps_t;
+#endif
+
+#ifndef FRAME_REGION
+#define FRAME_REGION
+/** \brief Pixel range of a frame, see getFrameRegions()
+
+    \ingroup API
+*/
+typedef struct FrameRegion_t{
+      uint16_t numOfFirstPixel;
+      uint16_t numOfPixels;
+} FrameRegion_t;
+#endif
+
+#ifndef CONFIGURATION_TRANSACTION
+#define CONFIGURATION_TRANSACTION
+/** \brief Device parameters collected by the configure*() functions and sent together by commitConfiguration()
+
+    Initialize it with clearConfiguration(). After commitConfiguration() every *Result field holds the outcome of its command,
+    like the return value of the matching set*() function: 0 on success (or when the command wasn't collected),
+    the error code of the device or the error code of the transfer.
+
+    \ingroup API
+*/
+typedef struct ConfigurationTransaction_t{
+      uint8_t commands;                     // CONFIGURE_* flags of the collected commands
+      uint16_t numOfStartElement;           // configureFrameFormat()
+      uint16_t numOfEndElement;
+      uint8_t reductionMode;
+      uint16_t numOfScans;                  // configureAcquisitionParameters()
+      uint16_t numOfBlankScans;
+      uint8_t scanMode;
+      uint32_t acquisitionTimeOfExposure;
+      uint32_t timeOfExposure;              // configureExposure()
+      uint8_t forceExposure;
+      uint8_t triggerEnableMode;            // configureExternalTrigger()
+      uint8_t triggerFront;
+      uint8_t opticalTriggerMode;           // configureOpticalTrigger()
+      uint16_t opticalTriggerPixel;
+      uint16_t opticalTriggerThreshold;
+
+      int frameFormatResult;
+      int acquisitionParametersResult;
+      int exposureResult;
+      int externalTriggerResult;
+      int opticalTriggerResult;
+      uint16_t numOfPixelsInFrame;          // after a successful frame format command
+} ConfigurationTransaction_t;
+#endif
+
 
 /** \brief Free a device handle 
     
@@ -112,12 +177,82 @@ LIBSHARED_AND_STATIC_EXPORT int connectToDeviceBySerial(const char * const seria
 */
 LIBSHARED_AND_STATIC_EXPORT int connectToDeviceByIndex(unsigned int index, uintptr_t *deviceContextPtr);
 
+/** \brief Connects to the device at the given path, without enumerating the devices again
+
+    \param[in] path
+    \parblock
+    The platform-specific path of the device, as found in the path field of the getDevicesInfo() list
+    \endparblock
+
+    \param[out] deviceContextPtr
+    \parblock
+    This pointer should not be NULL - provide the address of a valid uintptr_t variable.
+    The handle inside will be initialized with device state information required for all the other functions.
+    Set the uintptr_t variable to 0 before calling this function for the first time to start working with a device. 
+    If the variable already holds a connected device, the device is disconnected first.
+    \endparblock
+
+    \ingroup API
+
+    \returns
+        This function returns 0 on success and error code in case of error.
+*/
+LIBSHARED_AND_STATIC_EXPORT int connectToDeviceByPath(const char * const path, uintptr_t *deviceContextPtr);
+
+/** \brief Connects to all the connected devices at once
+
+    The devices are enumerated once and opened in parallel, each from its own thread, which makes bringing up
+    a station of many devices about as fast as connecting a single one.
+
+    \param[out] deviceContexts
+    \parblock
+    An array of maxNumOfDevices uintptr_t variables. Element i receives the handle of device i in the order of getDevicesInfo(),
+    or 0 if it could not be connected; free each non-zero handle with disconnectDeviceContext()
+    \endparblock
+
+    \param[out] connectResults
+    \parblock
+    NULL or an array of maxNumOfDevices int variables. Element i receives the result of connecting device i in the order of getDevicesInfo(),
+    0 or an error code; the elements past the enumerated devices receive CONNECT_ERROR_NOT_FOUND
+    \endparblock
+
+    \param[in] maxNumOfDevices
+    \parblock
+    The number of elements of deviceContexts and connectResults, further devices are left alone
+    \endparblock
+
+    \param[out] numOfDevices
+    \parblock
+    The number of enumerated devices, i.e. of the elements of deviceContexts and connectResults filled for them
+    \endparblock
+
+    A device whose serial number can't be read is not connected, since its handle could not find it again on a reconnect.
+
+    \ingroup API
+
+    \returns
+        This function returns 0 if at least one device was connected (see connectResults for the devices that failed),
+        CONNECT_ERROR_NOT_FOUND if there is no device and the error code of the first failure if none could be connected.
+*/
+LIBSHARED_AND_STATIC_EXPORT int connectAllDevices(uintptr_t *deviceContexts, int *connectResults, uint32_t maxNumOfDevices, uint32_t *numOfDevices);
+
 /* Deprecated - left for internal use only
 LIBSHARED_AND_STATIC_EXPORT void disconnectDevice();
 */
 
 /** \brief Returns the number of the connected devices
 
+    \note On Linux, setting the SPECTROMETER_VIRTUAL_DEVICES environment variable to N replaces the real devices with N simulated ones
+    (serial numbers VIRTUAL0000, VIRTUAL0001, ...), which is useful for testing and benchmarking without hardware.
+    SPECTROMETER_VIRTUAL_PACKET_INTERVAL_US optionally sets the pause between two simulated input reports.
+    Setting SPECTROMETER_IO_URING to 1 makes the devices connected afterwards read their reports through io_uring
+    (Linux 5.11 or later, otherwise the regular path is used).
+    Setting SPECTROMETER_READER_THREAD to 1 gives every device connected afterwards a thread that moves its reports
+    from the kernel into a ring as soon as they arrive; the library functions then take them from the ring.
+    If the library is built with -DWITH_LIBUSB=ON, setting SPECTROMETER_BACKEND to libusb makes the devices connected afterwards
+    claim their USB interface through libusb with several interrupt transfers queued; such devices can't join a reactor.
+    Setting SPECTROMETER_BACKEND to usbfs does the same through /dev/bus/usb with asynchronous URBs, without any dependency.
+
     \ingroup API
 
     \returns This function returns the number of connected devices with VID = 0xE220 and PID = 0x0100
@@ -130,6 +265,7 @@ Run clearDevicesInfo() with the result of this function to clear it [Mandatory]
 structure information:
 struct DeviceInfo_t {
       char* serial; //descriptor to the string with serial number
+      char* path; //platform-specific device path, accepted by connectToDeviceByPath()
       struct DeviceInfo_t *next; //descriptor to the next element of the list or null if last element
 }
 }
@@ -148,6 +284,231 @@ LIBSHARED_AND_STATIC_EXPORT DeviceInfo_t * getDevicesInfo();
 */
 LIBSHARED_AND_STATIC_EXPORT void clearDevicesInfo(DeviceInfo_t *devices);
 
+#ifndef HOTPLUG_CALLBACK
+#define HOTPLUG_CALLBACK
+/** \brief Type of the function called by processHotplugEvents() for every device that was connected or disconnected
+
+    The event parameter is either HOTPLUG_DEVICE_ARRIVED or HOTPLUG_DEVICE_LEFT,
+    serialNumber is only valid during the call, userData is the pointer passed to startHotplugMonitor()
+
+    \ingroup API
+*/
+typedef void (*HotplugCallback_t)(uint8_t event, const char* serialNumber, void* userData);
+#endif
+
+#ifndef FLASH_PROGRESS_CALLBACK
+#define FLASH_PROGRESS_CALLBACK
+/** \brief Type of the function called by readFlashWithProgress() after every chunk
+
+    bytesRead counts the bytes from the start of the transfer that are in the buffer, out of bytesToRead,
+    userData is the pointer passed to readFlashWithProgress()
+
+    \ingroup API
+*/
+typedef void (*FlashProgressCallback_t)(uint32_t bytesRead, uint32_t bytesToRead, void* userData);
+#endif
+
+/** \brief Starts watching for connected and disconnected devices
+
+    The devices already connected when the monitor starts are not reported.
+    The monitor does not create any thread: wait until getHotplugFileDescriptor() becomes readable
+    (with poll(), select() or an event loop) and call processHotplugEvents(), which runs the callback for every change.
+
+\param[in] callback
+\parblock
+The function called for every device with VID = 0xE220 and PID = 0x0100 that was connected or disconnected
+\endparblock
+
+\param[in] userData
+\parblock
+Any pointer, it is passed to the callback unchanged
+\endparblock
+
+\param[out] hotplugContextPtr
+\parblock
+This pointer should not be NULL - provide the address of a valid uintptr_t variable.
+The handle inside will be initialized with the monitor state, free it with stopHotplugMonitor()
+\endparblock
+
+\note Hotplug monitoring is only available on Linux; on other systems the function returns HOTPLUG_MONITOR_FAILED
+
+\ingroup API
+
+\returns
+This function returns 0 on success and error code in case of error.
+*/
+LIBSHARED_AND_STATIC_EXPORT int startHotplugMonitor(HotplugCallback_t callback, void* userData, uintptr_t* hotplugContextPtr);
+
+/** \brief Obtains the file descriptor that becomes readable when connected devices may have changed
+
+\param[out] fileDescriptor
+\parblock
+The pointer to the variable receiving the file descriptor. The descriptor belongs to the monitor and must not be closed
+\endparblock
+
+\param[in] hotplugContextPtr
+\parblock
+The address of the uintptr_t variable initialized by startHotplugMonitor()
+\endparblock
+
+\ingroup API
+
+\returns
+This function returns 0 on success and error code in case of error.
+*/
+LIBSHARED_AND_STATIC_EXPORT int getHotplugFileDescriptor(int* fileDescriptor, uintptr_t* hotplugContextPtr);
+
+/** \brief Runs the callback for every device connected or disconnected since the previous call
+
+    The function does not block, call it when the descriptor from getHotplugFileDescriptor() is readable
+    or periodically. The cost of a call without pending events is a single non-blocking read.
+
+\param[in] hotplugContextPtr
+\parblock
+The address of the uintptr_t variable initialized by startHotplugMonitor()
+\endparblock
+
+\ingroup API
+
+\returns
+This function returns 0 on success and error code in case of error.
+*/
+LIBSHARED_AND_STATIC_EXPORT int processHotplugEvents(uintptr_t* hotplugContextPtr);
+
+/** \brief Stops the monitor started by startHotplugMonitor() and frees its handle
+
+\param[in] hotplugContextPtr
+\parblock
+The address of the uintptr_t variable initialized by startHotplugMonitor(), it is set to 0
+\endparblock
+
+\ingroup API
+
+\returns
+This function returns 0 on success and error code in case of error.
+*/
+LIBSHARED_AND_STATIC_EXPORT int stopHotplugMonitor(uintptr_t* hotplugContextPtr);
+
+#if !defined(_WIN32)
+#ifndef REACTOR_CALLBACK
+#define REACTOR_CALLBACK
+/** \brief Type of the function called by runReactor() when a submitted request of a device completes
+
+    The result parameter is 0 on success and error code in case of error, userData is the pointer passed with the request.
+    The device is idle again when the function is called, so it may submit the next request of the device.
+    The callbacks run once runReactor() has processed the reports, so they may also remove devices from the reactor or destroy it.
+
+    \ingroup API
+*/
+typedef void (*ReactorCallback_t)(int result, uintptr_t* deviceContextPtr, void* userData);
+#endif
+
+/** \brief Creates a reactor that drives the requests of many devices from a single thread
+
+    The reactor waits for the reports of all its devices with one epoll set. Every device runs at most one request at a time,
+    submitted with submitGetStatus(), submitGetFrame() or submitReadFlash(); runReactor() advances the requests as reports arrive.
+    The other functions of the library remain blocking and may be used on an idle device (e.g. to set parameters).
+
+\param[out] reactorPtr
+\parblock
+This pointer should not be NULL - provide the address of a valid uintptr_t variable, free the handle with destroyReactor()
+\endparblock
+
+\note Only available on Linux
+
+\ingroup API
+
+\returns
+This function returns 0 on success and error code in case of error.
+*/
+LIBSHARED_AND_STATIC_EXPORT int createReactor(uintptr_t* reactorPtr);
+
+/** \brief Frees a reactor created by createReactor(); the devices stay connected and requests in progress are abandoned
+
+\ingroup API
+
+\returns
+This function returns 0 on success and error code in case of error.
+*/
+LIBSHARED_AND_STATIC_EXPORT int destroyReactor(uintptr_t* reactorPtr);
+
+/** \brief Adds a connected device to the reactor
+
+\param[in] deviceContextPtr
+\parblock
+The address of the uintptr_t variable initialized by either connectToDeviceBySerial() or connectToDeviceByIndex() function.
+The reactor keeps the address, the variable must stay valid until the device is removed
+\endparblock
+
+\ingroup API
+
+\returns
+This function returns 0 on success and error code in case of error.
+*/
+LIBSHARED_AND_STATIC_EXPORT int addDeviceToReactor(uintptr_t* deviceContextPtr, uintptr_t* reactorPtr);
+
+/** \brief Removes a device from the reactor, abandoning its request in progress
+
+\ingroup API
+
+\returns
+This function returns 0 on success and error code in case of error.
+*/
+LIBSHARED_AND_STATIC_EXPORT int removeDeviceFromReactor(uintptr_t* deviceContextPtr, uintptr_t* reactorPtr);
+
+/** \brief Starts the getStatus() request on a device of the reactor
+
+    statusFlags and framesInMemory (either may be NULL) are filled in before the callback runs
+
+\ingroup API
+
+\returns
+This function returns 0 if the request was sent, OPERATION_IN_PROGRESS if the device has not finished its previous request and error code in case of other errors.
+*/
+LIBSHARED_AND_STATIC_EXPORT int submitGetStatus(uint8_t* statusFlags, uint16_t* framesInMemory, ReactorCallback_t callback, void* userData,
+                                                uintptr_t* deviceContextPtr, uintptr_t* reactorPtr);
+
+/** \brief Starts the getFrame() request on a device of the reactor
+
+    framePixelsBuffer must hold numOfPixelsInFrame values and stay valid until the callback runs
+
+\ingroup API
+
+\returns
+This function returns 0 if the request was sent, OPERATION_IN_PROGRESS if the device has not finished its previous request and error code in case of other errors.
+*/
+LIBSHARED_AND_STATIC_EXPORT int submitGetFrame(uint16_t* framePixelsBuffer, uint16_t numOfFrame, ReactorCallback_t callback, void* userData,
+                                               uintptr_t* deviceContextPtr, uintptr_t* reactorPtr);
+
+/** \brief Starts the readFlash() request on a device of the reactor
+
+    buffer must hold bytesToRead bytes and stay valid until the callback runs, bytesToRead must not be 0
+
+\ingroup API
+
+\returns
+This function returns 0 if the request was sent, OPERATION_IN_PROGRESS if the device has not finished its previous request and error code in case of other errors.
+*/
+LIBSHARED_AND_STATIC_EXPORT int submitReadFlash(uint8_t* buffer, uint32_t absoluteOffset, uint32_t bytesToRead, ReactorCallback_t callback, void* userData,
+                                                uintptr_t* deviceContextPtr, uintptr_t* reactorPtr);
+
+/** \brief Waits for reports of the reactor devices and advances their requests, calling the callbacks of the completed ones
+
+    A request that receives no report for 100 ms completes with READING_PROCESS_FAILED.
+
+\param[in] timeoutMilliseconds
+\parblock
+The longest time to wait for a report, -1 to wait until one arrives. The wait never extends past the timeout of a running request
+\endparblock
+
+\ingroup API
+
+\returns
+This function returns 0 on success and error code in case of error.
+*/
+LIBSHARED_AND_STATIC_EXPORT int runReactor(int timeoutMilliseconds, uintptr_t* reactorPtr);
+#endif
+
 /** \brief Sets frame parameters
 \note this function clears the memory and stops the current acquisition
 
@@ -200,7 +561,8 @@ Can be called in the middle of acquisition, exposure will be applied on the next
 
 \param[in] timeOfExposure = multiple of 10 us (microseconds)
 
-\param[in] force - set force
+\param[in] force - set force. Without force, an exposure equal to the one the library last set or read
+is not sent again (see invalidateParametersCache())
 
 \param[in] deviceContextPtr
 \parblock
@@ -394,7 +756,108 @@ LIBSHARED_AND_STATIC_EXPORT int triggerAcquisition(uintptr_t *deviceContextPtr);
 */
 LIBSHARED_AND_STATIC_EXPORT int getStatus(uint8_t *statusFlags, uint16_t *framesInMemory,  uintptr_t *deviceContextPtr);
 
+/** \brief Waits until the device has numOfFrames frames in memory
+
+    Instead of polling getStatus() at a fixed rate, the wait sleeps until shortly before the frames are
+    due, then polls with an interval starting at 100 us and doubling up to 2 ms (or one exposure if shorter).
+    The time the frames are due is computed from the acquisition parameters (see getAcquisitionParameters())
+    and the time of the last triggerAcquisition() of this handle. Without a software trigger, as with an
+    external trigger or in scan mode 2 (every frame idle), the first poll is sent right away and every poll that
+    finds frames missing sleeps for the exposures that the missing frames need at least.
+    The wait also ends when the memory of the device is full (STATUS_MEMORY_FULL).
+
+    \param[in] numOfFrames - the number of frames to wait for, at least 1
+    \param[in] timeoutMilliseconds - how long to wait at most
+    \param[out] statusFlags - the flags of the last status, provide an initialized pointer or NULL to skip this parameter
+    \param[out] framesInMemory - the frames of the last status, provide an initialized pointer or NULL to skip this parameter
+
+    \param[in] deviceContextPtr
+    \parblock
+    This pointer should not be NULL - provide the address of a valid uintptr_t variable
+    (The uintptr_t variable contains the device state information handle and should be previously initialized by either connectToDeviceBySerial() or connectToDeviceByIndex() function)
+    \endparblock
+
+    \ingroup API
+
+    \returns
+        This function returns 0 on success, WAIT_FOR_FRAMES_TIMEOUT if the frames weren't there in time and error code in case of error.
+*/
+LIBSHARED_AND_STATIC_EXPORT int waitForFrames(uint16_t numOfFrames, uint32_t timeoutMilliseconds, uint8_t *statusFlags, uint16_t *framesInMemory,
+                                              uintptr_t *deviceContextPtr);
+
+#if !defined(_WIN32)
+/** \brief Starts waitForFrames() on a thread of the library and returns at once
+
+    The file descriptor from getFramesWatchFileDescriptor() becomes readable when the wait is over, so the readiness
+    of several devices can be folded into one poll(), select() or epoll loop. Collect the outcome with stopFramesWatch().
+    Until then the thread sends the status requests of the device: don't call other functions with the device.
+
+\param[in] numOfFrames - the number of frames to wait for, at least 1
+\param[in] timeoutMilliseconds - how long to wait at most
+
+\param[out] framesWatchPtr
+\parblock
+This pointer should not be NULL - provide the address of a valid uintptr_t variable, free the handle with stopFramesWatch()
+\endparblock
+
+\param[in] deviceContextPtr
+\parblock
+The address of the uintptr_t variable initialized by either connectToDeviceBySerial() or connectToDeviceByIndex() function.
+The watch keeps the address, the variable must stay valid until the watch is stopped
+\endparblock
+
+\note Only available on Linux
+
+\ingroup API
+
+\returns
+This function returns 0 on success and error code in case of error.
+*/
+LIBSHARED_AND_STATIC_EXPORT int startFramesWatch(uint16_t numOfFrames, uint32_t timeoutMilliseconds, uintptr_t *framesWatchPtr, uintptr_t *deviceContextPtr);
+
+/** \brief Obtains the eventfd that becomes readable when the wait of startFramesWatch() is over
+
+\param[out] fileDescriptor
+\parblock
+The pointer to the variable receiving the file descriptor. The descriptor belongs to the watch and must not be closed or read
+\endparblock
+
+\param[in] framesWatchPtr
+\parblock
+The address of the uintptr_t variable initialized by startFramesWatch()
+\endparblock
+
+\ingroup API
+
+\returns
+This function returns 0 on success and error code in case of error.
+*/
+LIBSHARED_AND_STATIC_EXPORT int getFramesWatchFileDescriptor(int *fileDescriptor, uintptr_t *framesWatchPtr);
+
+/** \brief Ends the watch started by startFramesWatch(), returns the outcome of its wait and frees its handle
+
+    A watch that is still waiting is cancelled and returns WAIT_FOR_FRAMES_TIMEOUT.
+
+\param[out] statusFlags - the flags of the last status, provide an initialized pointer or NULL to skip this parameter
+\param[out] framesInMemory - the frames of the last status, provide an initialized pointer or NULL to skip this parameter
+
+\param[in] framesWatchPtr
+\parblock
+The address of the uintptr_t variable initialized by startFramesWatch(), it is set to 0
+\endparblock
+
+\ingroup API
+
+\returns
+This function returns what waitForFrames() would have returned.
+*/
+LIBSHARED_AND_STATIC_EXPORT int stopFramesWatch(uint8_t *statusFlags, uint16_t *framesInMemory, uintptr_t *framesWatchPtr);
+#endif
+
 /** \brief Returns the same values as set by setAcquisitionParameters
+
+    The values are read from the device once, then kept by the library along with the ones set
+    through this device handle (see invalidateParametersCache())
     \param[out] numOfScans - provide an initialized pointer or NULL to skip this parameter fetch
     \param[out] numOfBlankScans - provide an initialized pointer or NULL to skip this parameter fetch
     \param[out] scanMode - provide an initialized pointer or NULL to skip this parameter fetch
@@ -414,6 +877,9 @@ LIBSHARED_AND_STATIC_EXPORT int getStatus(uint8_t *statusFlags, uint16_t *frames
 LIBSHARED_AND_STATIC_EXPORT int getAcquisitionParameters(uint16_t* numOfScans, uint16_t* numOfBlankScans, uint8_t *scanMode, uint32_t* timeOfExposure, uintptr_t *deviceContextPtr);
 
 /** \brief Returns the same values as set by setFrameFormat
+
+    The values are read from the device once, then kept by the library along with the ones set
+    through this device handle (see invalidateParametersCache())
     \param[out] numOfStartElement
     \param[out] numOfEndElement
     \param[out] reductionMode
@@ -446,6 +912,9 @@ LIBSHARED_AND_STATIC_EXPORT int getFrameFormat(uint16_t *numOfStartElement, uint
     (The uintptr_t variable contains the device state information handle and should be previously initialized by either connectToDeviceBySerial() or connectToDeviceByIndex() function)
     \endparblock
 
+    Packets lost or late on the bus are requested again by their pixel offsets, up to 3 times, instead of failing the frame
+    (with numOfFrame = 0xFFFF during an acquisition the whole frame is requested again, since the last frame may have changed meanwhile).
+
     \ingroup API
 
     \returns
@@ -453,7 +922,229 @@ LIBSHARED_AND_STATIC_EXPORT int getFrameFormat(uint16_t *numOfStartElement, uint
 */
 LIBSHARED_AND_STATIC_EXPORT int getFrame(uint16_t  *framePixelsBuffer, uint16_t numOfFrame, uintptr_t *deviceContextPtr);
 
-/** \brief Clears memory
+/** \brief Gets a region of a frame
+    
+    Only the packets covering the region are transferred, so reading a few hundred pixels
+    takes a fraction of the USB time of a whole frame.
+
+    \param[out] pixelsBuffer - provide an initialized pointer to a buffer of numOfPixels unsigned short elements.
+    Element 0 receives the pixel numOfFirstPixel of the frame.
+    \param[in] numOfFrame
+    \parblock
+    numOfFrame - first frame in memory is number 0, second is 1, etc
+    numOfFrame = 0xFFFF - region of the averaged spectrum (for averaging mode), for all other modes of the last captured frame
+    \endparblock
+    \param[in] numOfFirstPixel - first pixel of the region, counted like the pixels of getFrame()
+    \param[in] numOfPixels - number of pixels of the region, at least 1.
+    The region has to end within the frame (see numOfPixelsInFrame of getFrameFormat()).
+
+    \param[in] deviceContextPtr
+    \parblock
+    This pointer should not be NULL - provide the address of a valid uintptr_t variable
+    (The uintptr_t variable contains the device state information handle and should be previously initialized by either connectToDeviceBySerial() or connectToDeviceByIndex() function)
+    \endparblock
+
+    Lost packets are requested again like with getFrame().
+
+    \ingroup API
+
+    \returns
+        This function returns 0 on success, FRAME_REGION_OUT_OF_RANGE if the region doesn't end within the frame
+        and error code in case of other errors.
+*/
+LIBSHARED_AND_STATIC_EXPORT int getFrameRegion(uint16_t *pixelsBuffer, uint16_t numOfFrame, uint16_t numOfFirstPixel, uint16_t numOfPixels, uintptr_t *deviceContextPtr);
+
+/** \brief Gets several regions of a frame in one call
+    
+    The regions are sorted and merged into as few GET_FRAME requests as possible: regions that overlap, touch
+    or are so close that one request moves no more packets than two are read together.
+    The requests are pipelined like with getFrames(), and the pixels of each region are copied
+    to the output one region after the other, in the order of the regions array.
+
+    \param[out] pixelsBuffer - provide an initialized pointer to a buffer of as many unsigned short elements
+    as the regions have pixels altogether.
+    \param[out] regionOffsets - NULL or a buffer of numOfRegions elements, receives the index in pixelsBuffer
+    of the first pixel of each region.
+    \param[in] numOfFrame - same as for getFrame()
+    \param[in] regions - the pixel ranges to read, each of them as described for getFrameRegion(). They may overlap.
+    \param[in] numOfRegions - from 1 to MAX_NUM_OF_FRAME_REGIONS
+
+    \param[in] deviceContextPtr
+    \parblock
+    This pointer should not be NULL - provide the address of a valid uintptr_t variable
+    (The uintptr_t variable contains the device state information handle and should be previously initialized by either connectToDeviceBySerial() or connectToDeviceByIndex() function)
+    \endparblock
+
+    \ingroup API
+
+    \returns
+        This function returns 0 on success, FRAME_REGION_OUT_OF_RANGE if a region doesn't end within the frame
+        and error code in case of other errors.
+        On error the content of pixelsBuffer is undefined.
+*/
+LIBSHARED_AND_STATIC_EXPORT int getFrameRegions(uint16_t *pixelsBuffer, uint32_t *regionOffsets, uint16_t numOfFrame,
+                                                const FrameRegion_t *regions, uint16_t numOfRegions, uintptr_t *deviceContextPtr);
+
+/** \brief Gets a range of frames from the memory of the device
+    
+    Reads the frames numOfFirstFrame to numOfFirstFrame + numOfFrames - 1 one after the other into one buffer.
+    The request of the next frame is sent while the packets of the current one are still arriving,
+    so the device memory is drained at the packet rate of the link instead of one round trip per frame.
+
+    \param[out] framesPixelsBuffer - provide an initialized pointer to a buffer of numOfFrames * numOfPixelsInFrame unsigned short elements.
+    Frame numOfFirstFrame + i starts at element i * numOfPixelsInFrame (see getFrameFormat()).
+    \param[in] numOfFirstFrame - first frame in memory is number 0, second is 1, etc
+    \param[in] numOfFrames
+    \parblock
+    Number of frames to read, at least 1. The range can't reach 0xFFFF, the averaged spectrum is read with getFrame().
+    \endparblock
+
+    \param[in] deviceContextPtr
+    \parblock
+    This pointer should not be NULL - provide the address of a valid uintptr_t variable
+    (The uintptr_t variable contains the device state information handle and should be previously initialized by either connectToDeviceBySerial() or connectToDeviceByIndex() function)
+    \endparblock
+
+    \ingroup API
+
+    \returns
+        This function returns 0 on success and error code in case of error.
+        On error the content of framesPixelsBuffer is undefined.
+*/
+LIBSHARED_AND_STATIC_EXPORT int getFrames(uint16_t *framesPixelsBuffer, uint16_t numOfFirstFrame, uint16_t numOfFrames, uintptr_t *deviceContextPtr);
+
+/** \brief Creates an accumulator summing frames on the host
+
+    The frames returned by the device in averaging mode are rounded to 16 bits and can't be combined across
+    exposure changes; the accumulator keeps per pixel sums of any number of frames instead and gives their
+    sum, mean and variance on demand. The sums use the vector units of the processor (AVX2 or NEON) when it has them.
+
+    \param[in] numOfPixels - the pixels of each accumulated frame, usually numOfPixelsInFrame of getFrameFormat()
+    \param[in] accumulatorType
+    \parblock
+    ACCUMULATE_UINT32 - exact 32 bits sums, up to 65537 frames
+    ACCUMULATE_UINT64 - exact 64 bits sums, up to 4294967295 frames
+    ACCUMULATE_DOUBLE - running mean and variance in double precision, the only type accepting accumulateScaledFrames()
+    \endparblock
+
+    \param[out] accumulatorPtr
+    \parblock
+    This pointer should not be NULL - provide the address of a valid uintptr_t variable, free the handle with destroyFrameAccumulator()
+    \endparblock
+
+    \ingroup API
+
+    \returns
+        This function returns 0 on success and error code in case of error.
+*/
+LIBSHARED_AND_STATIC_EXPORT int createFrameAccumulator(uint16_t numOfPixels, uint8_t accumulatorType, uintptr_t *accumulatorPtr);
+
+/** \brief Frees the accumulator created by createFrameAccumulator()
+
+    \param[in] accumulatorPtr - the address of the uintptr_t variable initialized by createFrameAccumulator(), it is set to 0
+
+    \ingroup API
+
+    \returns
+        This function returns 0 on success and error code in case of error.
+*/
+LIBSHARED_AND_STATIC_EXPORT int destroyFrameAccumulator(uintptr_t *accumulatorPtr);
+
+/** \brief Forgets the frames accumulated so far
+
+    \param[in] accumulatorPtr - the address of the uintptr_t variable initialized by createFrameAccumulator()
+
+    \ingroup API
+
+    \returns
+        This function returns 0 on success and error code in case of error.
+*/
+LIBSHARED_AND_STATIC_EXPORT int resetFrameAccumulator(uintptr_t *accumulatorPtr);
+
+/** \brief Adds frames to the accumulator
+
+    \param[in] framesPixelsBuffer - numOfFrames frames of numOfPixels pixels one after the other, as filled by getFrame() or getFrames()
+    \param[in] numOfFrames - at least 1
+    \param[in] accumulatorPtr - the address of the uintptr_t variable initialized by createFrameAccumulator()
+
+    \ingroup API
+
+    \returns
+        This function returns 0 on success and error code in case of error.
+        ACCUMULATOR_OVERFLOW if the frames would exceed the limit of the accumulator type, none of them is added then.
+*/
+LIBSHARED_AND_STATIC_EXPORT int accumulateFrames(const uint16_t *framesPixelsBuffer, uint16_t numOfFrames, uintptr_t *accumulatorPtr);
+
+/** \brief Adds frames multiplied by a factor to an ACCUMULATE_DOUBLE accumulator
+
+    Frames taken with different exposures are combined by scaling them to a common one,
+    for example with scale = referenceExposure / timeOfExposure.
+
+    \param[in] framesPixelsBuffer - same as for accumulateFrames()
+    \param[in] numOfFrames - at least 1
+    \param[in] scale - the factor applied to every pixel
+    \param[in] accumulatorPtr - the address of the uintptr_t variable initialized by createFrameAccumulator()
+
+    \ingroup API
+
+    \returns
+        This function returns 0 on success and error code in case of error.
+        OPERATION_NOT_SUPPORTED for integer accumulators unless scale is 1.
+*/
+LIBSHARED_AND_STATIC_EXPORT int accumulateScaledFrames(const uint16_t *framesPixelsBuffer, uint16_t numOfFrames, double scale, uintptr_t *accumulatorPtr);
+
+/** \brief Returns the number of frames accumulated since the accumulator was created or reset
+
+    \param[out] numOfFrames - provide an initialized pointer
+    \param[in] accumulatorPtr - the address of the uintptr_t variable initialized by createFrameAccumulator()
+
+    \ingroup API
+
+    \returns
+        This function returns 0 on success and error code in case of error.
+*/
+LIBSHARED_AND_STATIC_EXPORT int getAccumulatedFrames(uint32_t *numOfFrames, uintptr_t *accumulatorPtr);
+
+/** \brief Gets the per pixel sums of the accumulated frames
+
+    \param[out] sumBuffer - provide an initialized pointer to a buffer of numOfPixels double elements
+    \param[in] accumulatorPtr - the address of the uintptr_t variable initialized by createFrameAccumulator()
+
+    \ingroup API
+
+    \returns
+        This function returns 0 on success and error code in case of error.
+*/
+LIBSHARED_AND_STATIC_EXPORT int getAccumulatedSum(double *sumBuffer, uintptr_t *accumulatorPtr);
+
+/** \brief Gets the per pixel means of the accumulated frames, 0 while there are none
+
+    \param[out] meanBuffer - provide an initialized pointer to a buffer of numOfPixels double elements
+    \param[in] accumulatorPtr - the address of the uintptr_t variable initialized by createFrameAccumulator()
+
+    \ingroup API
+
+    \returns
+        This function returns 0 on success and error code in case of error.
+*/
+LIBSHARED_AND_STATIC_EXPORT int getAccumulatedMean(double *meanBuffer, uintptr_t *accumulatorPtr);
+
+/** \brief Gets the per pixel variances of the accumulated frames, 0 while there are none
+
+    The variance is the population one, the mean of the squared deviations from the mean (divided by the number of frames).
+    The integer types compute it without rounding from their exact sums, only the result is rounded to double.
+
+    \param[out] varianceBuffer - provide an initialized pointer to a buffer of numOfPixels double elements
+    \param[in] accumulatorPtr - the address of the uintptr_t variable initialized by createFrameAccumulator()
+
+    \ingroup API
+
+    \returns
+        This function returns 0 on success and error code in case of error.
+*/
+LIBSHARED_AND_STATIC_EXPORT int getAccumulatedVariance(double *varianceBuffer, uintptr_t *accumulatorPtr);
+
+/** \brief Clears memory
 
     \param[in] deviceContextPtr
     \parblock
@@ -500,6 +1191,8 @@ LIBSHARED_AND_STATIC_EXPORT int eraseFlash(uintptr_t *deviceContextPtr);
     (The uintptr_t variable contains the device state information handle and should be previously initialized by either connectToDeviceBySerial() or connectToDeviceByIndex() function)
     \endparblock
 
+    Chunks that fail are read again, see readFlashWithProgress().
+
     \ingroup API
 
     \returns
@@ -507,6 +1200,33 @@ LIBSHARED_AND_STATIC_EXPORT int eraseFlash(uintptr_t *deviceContextPtr);
 */
 LIBSHARED_AND_STATIC_EXPORT int readFlash(uint8_t *buffer, uint32_t absoluteOffset, uint32_t bytesToRead, uintptr_t *deviceContextPtr);
 
+/** \brief Reads from user flash memory like readFlash() and reports the progress
+
+    The flash is read in chunks of up to 100 packets. When a chunk breaks off, the transfer resumes with a new request
+    from its first missing packet instead of restarting; it fails after 3 more requests in a row that bring nothing.
+    After every chunk the callback gets the number of bytes read so far, so a transfer that still fails can be resumed
+    from absoluteOffset + bytesRead.
+
+    \param[out] buffer - provide an initialized pointer to the buffer of unsigned char elements.
+    \param[in] absoluteOffset - see readFlash()
+    \param[in] bytesToRead
+    \param[in] callback - called after every chunk, or NULL
+    \param[in] userData - any pointer, it is passed to the callback unchanged
+
+    \param[in] deviceContextPtr
+    \parblock
+    This pointer should not be NULL - provide the address of a valid uintptr_t variable
+    (The uintptr_t variable contains the device state information handle and should be previously initialized by either connectToDeviceBySerial() or connectToDeviceByIndex() function)
+    \endparblock
+
+    \ingroup API
+
+    \returns
+        This function returns 0 on success and error code in case of error.
+*/
+LIBSHARED_AND_STATIC_EXPORT int readFlashWithProgress(uint8_t *buffer, uint32_t absoluteOffset, uint32_t bytesToRead, FlashProgressCallback_t callback,
+                                                      void *userData, uintptr_t *deviceContextPtr);
+
 /** \brief Writes bytesToWrite bytes from the buffer to the user flash memory starting at offset
     \param[out] buffer
     \param[in] absoluteOffset
@@ -574,6 +1294,145 @@ This function returns 0 on success and error code in case of error.
 */
 LIBSHARED_AND_STATIC_EXPORT int detachDevice(uintptr_t *deviceContextPtr);
 
+/** \brief Makes the reads of the device spin before they sleep, for the lowest latency of every packet
+    
+    The functions reading packets (getFrame(), readFlash(), ...) keep polling the device for up to maxSpinMicroseconds
+    before they sleep until the next packet arrives, which saves the wakeup of the sleeping thread on every packet.
+    The actual window adapts to the gaps observed between the packets, a slow device doesn't make the thread spin for nothing.
+    The calling thread keeps a CPU busy while it waits.
+
+\param[in] maxSpinMicroseconds
+\parblock
+The largest spin window, 0 (the default) to sleep right away
+\endparblock
+
+\param[in] deviceContextPtr
+\parblock
+This pointer should not be NULL - provide the address of a valid uintptr_t variable
+(The uintptr_t variable contains the device state information handle and should be previously initialized by either connectToDeviceBySerial() or connectToDeviceByIndex() function)
+\endparblock
+
+\note Only available on Linux, OPERATION_NOT_SUPPORTED is returned on other platforms
+
+\ingroup API
+
+\returns
+This function returns 0 on success and error code in case of error.
+*/
+LIBSHARED_AND_STATIC_EXPORT int setBusyPollWindow(uint32_t maxSpinMicroseconds, uintptr_t *deviceContextPtr);
+
+/** \brief Gets when the last request of the device was sent and when the packets of its reply arrived
+
+    Covers the last getFrame(), getStatus() or other request/reply function called with the device,
+    for getFrames() the whole batch from its first request to the last packet of its last frame.
+    lastReplyTime - requestTime is the latency of the whole exchange, firstReplyTime - requestTime
+    the turnaround of the device and lastReplyTime - firstReplyTime the transfer time of a frame.
+    On Linux the packets are stamped when hidapi reads them, or when the reader thread takes them
+    from the kernel with SPECTROMETER_READER_THREAD=1, otherwise when the library gets them.
+    The functions of the reactor (submitGetStatus(), submitGetFrame() and submitReadFlash()) don't update these times.
+
+\param[out] timestamps
+\parblock
+The times of the last exchange, a reply time is 0 if no packet arrived
+\endparblock
+
+\param[in] deviceContextPtr
+\parblock
+This pointer should not be NULL - provide the address of a valid uintptr_t variable
+(The uintptr_t variable contains the device state information handle and should be previously initialized by either connectToDeviceBySerial() or connectToDeviceByIndex() function)
+\endparblock
+
+\ingroup API
+
+\returns
+This function returns 0 on success and error code in case of error.
+*/
+LIBSHARED_AND_STATIC_EXPORT int getLastTransferTimestamps(TransferTimestamps_t *timestamps, uintptr_t *deviceContextPtr);
+
+/** \brief Empties a configuration transaction
+
+\param[out] transaction - provide an initialized pointer
+
+\ingroup API
+
+\returns
+This function returns 0 on success and error code in case of error.
+*/
+LIBSHARED_AND_STATIC_EXPORT int clearConfiguration(ConfigurationTransaction_t *transaction);
+
+/** \brief Adds the command of setFrameFormat() to a configuration transaction, see commitConfiguration()
+    \ingroup API
+*/
+LIBSHARED_AND_STATIC_EXPORT int configureFrameFormat(uint16_t numOfStartElement, uint16_t numOfEndElement, uint8_t reductionMode, ConfigurationTransaction_t *transaction);
+
+/** \brief Adds the command of setAcquisitionParameters() to a configuration transaction, see commitConfiguration()
+    \ingroup API
+*/
+LIBSHARED_AND_STATIC_EXPORT int configureAcquisitionParameters(uint16_t numOfScans, uint16_t numOfBlankScans, uint8_t scanMode, uint32_t timeOfExposure, ConfigurationTransaction_t *transaction);
+
+/** \brief Adds the command of setExposure() to a configuration transaction, see commitConfiguration()
+    \ingroup API
+*/
+LIBSHARED_AND_STATIC_EXPORT int configureExposure(uint32_t timeOfExposure, uint8_t force, ConfigurationTransaction_t *transaction);
+
+/** \brief Adds the command of setExternalTrigger() to a configuration transaction, see commitConfiguration()
+    \ingroup API
+*/
+LIBSHARED_AND_STATIC_EXPORT int configureExternalTrigger(uint8_t enableMode, uint8_t signalFrontMode, ConfigurationTransaction_t *transaction);
+
+/** \brief Adds the command of setOpticalTrigger() to a configuration transaction, see commitConfiguration()
+    \ingroup API
+*/
+LIBSHARED_AND_STATIC_EXPORT int configureOpticalTrigger(uint8_t enableMode, uint16_t pixel, uint16_t threshold, ConfigurationTransaction_t *transaction);
+
+/** \brief Sends the commands of a configuration transaction in one burst
+
+    All the requests are written back to back, then the replies are matched in order: reconfiguring costs
+    about one round trip instead of one per parameter. The commands are sent in the order frame format,
+    acquisition parameters, exposure, external trigger, optical trigger. Acquisition parameters and external trigger
+    collected together go as the single request of setMultipleParameters(). Commands that the device already has
+    (see invalidateParametersCache()) are not sent.
+
+    The device has no transactions: a command that fails doesn't undo the ones before it.
+    The outcome of each command is in the *Result fields of the transaction.
+
+\param[in,out] transaction - the commands collected by the configure*() functions, receives their results
+
+\param[in] deviceContextPtr
+\parblock
+This pointer should not be NULL - provide the address of a valid uintptr_t variable
+(The uintptr_t variable contains the device state information handle and should be previously initialized by either connectToDeviceBySerial() or connectToDeviceByIndex() function)
+\endparblock
+
+\ingroup API
+
+\returns
+This function returns 0 if every command succeeded, otherwise the first error of the results.
+*/
+LIBSHARED_AND_STATIC_EXPORT int commitConfiguration(ConfigurationTransaction_t *transaction, uintptr_t *deviceContextPtr);
+
+/** \brief Makes the library read the device parameters from the device again
+
+    The library keeps a copy of the parameters of the device: getAcquisitionParameters() and getFrameFormat()
+    answer from it, and setExposure(), setExternalTrigger() and setOpticalTrigger() don't send a value the device
+    already has (one time triggers are always sent). setAcquisitionParameters(), setMultipleParameters() and
+    setFrameFormat() are always sent since the device clears its memory on them.
+    The copy is dropped on reconnection, resetDevice() and detachDevice(). Call this function when another
+    handle or process may have changed the parameters of the device.
+
+\param[in] deviceContextPtr
+\parblock
+This pointer should not be NULL - provide the address of a valid uintptr_t variable
+(The uintptr_t variable contains the device state information handle and should be previously initialized by either connectToDeviceBySerial() or connectToDeviceByIndex() function)
+\endparblock
+
+\ingroup API
+
+\returns
+This function returns 0 on success and error code in case of error.
+*/
+LIBSHARED_AND_STATIC_EXPORT int invalidateParametersCache(uintptr_t *deviceContextPtr);
+
 /**   \ingroup API */
 #ifndef SPECTROMETER_ERROR_CODES
 #define SPECTROMETER_ERROR_CODES
@@ -604,9 +1463,78 @@ LIBSHARED_AND_STATIC_EXPORT int detachDevice(uintptr_t *deviceContextPtr);
     /** \ingroup API */
     #define CONNECT_ERROR_WRONG_SERIAL_NUMBER 516
     /** \ingroup API */
+    #define HOTPLUG_MONITOR_FAILED 517
+    /** \ingroup API */
+    #define OPERATION_IN_PROGRESS 518
+    /** \ingroup API */
+    #define REACTOR_FAILED 519
+    /** \ingroup API */
+    #define OPERATION_NOT_SUPPORTED 520
+    /** \ingroup API */
+    #define WAIT_FOR_FRAMES_TIMEOUT 521
+    /** \ingroup API */
+    #define FRAMES_WATCH_FAILED 522
+    /** \ingroup API */
+    #define ACCUMULATOR_FAILED 523
+    /** \ingroup API */
+    #define ACCUMULATOR_OVERFLOW 524
+    /** \ingroup API */
+    #define FRAME_REGION_OUT_OF_RANGE 525
+    /** \ingroup API */
     #define NO_DEVICE_CONTEXT_ERROR 585
 #endif
 
+/**   \ingroup API */
+#ifndef STATUS_FLAGS
+#define STATUS_FLAGS
+    /** \ingroup API */
+    #define STATUS_ACQUISITION_ACTIVE 0x01
+    /** \ingroup API */
+    #define STATUS_MEMORY_FULL 0x02
+#endif
+
+/**   \ingroup API */
+#ifndef ACCUMULATOR_TYPES
+#define ACCUMULATOR_TYPES
+    /** \ingroup API */
+    #define ACCUMULATE_UINT32 1
+    /** \ingroup API */
+    #define ACCUMULATE_UINT64 2
+    /** \ingroup API */
+    #define ACCUMULATE_DOUBLE 3
+#endif
+
+/**   \ingroup API */
+#ifndef HOTPLUG_EVENTS
+#define HOTPLUG_EVENTS
+    /** \ingroup API */
+    #define HOTPLUG_DEVICE_ARRIVED 1
+    /** \ingroup API */
+    #define HOTPLUG_DEVICE_LEFT 2
+#endif
+
+/**   \ingroup API */
+#ifndef CONFIGURATION_COMMANDS
+#define CONFIGURATION_COMMANDS
+    /** \ingroup API */
+    #define CONFIGURE_FRAME_FORMAT 0x01
+    /** \ingroup API */
+    #define CONFIGURE_ACQUISITION_PARAMETERS 0x02
+    /** \ingroup API */
+    #define CONFIGURE_EXPOSURE 0x04
+    /** \ingroup API */
+    #define CONFIGURE_EXTERNAL_TRIGGER 0x08
+    /** \ingroup API */
+    #define CONFIGURE_OPTICAL_TRIGGER 0x10
+#endif
+
+/**   \ingroup API */
+#ifndef FRAME_REGION_LIMITS
+#define FRAME_REGION_LIMITS
+    /** \ingroup API */
+    #define MAX_NUM_OF_FRAME_REGIONS 128
+#endif
+
 #ifndef AS_CORE_LIBRARY
     #ifdef __cplusplus
         }
@@ -0,0 +1,88 @@
+/*******************************************************
+ Virtual spectrometer
+
+ Software model of the E220:0100 spectrometer firmware. It speaks the
+ report protocol described in internal.h and is used by the hidapi layer
+ when the SPECTROMETER_VIRTUAL_DEVICES environment variable is set, so the
+ same binaries run against real or simulated devices.
+
+ The protocol engine itself is transport independent: it consumes one
+ output report and emits the reply reports through a callback. The
+ in-process transport runs it on a firmware thread behind a SOCK_SEQPACKET
+ socket pair, which keeps the poll()/read() path of the hidraw backend
+ unchanged.
+********************************************************/
+
+#ifndef VIRTUAL_DEVICE_H__
+#define VIRTUAL_DEVICE_H__
+
+#include <stddef.h>
+#include <wchar.h>
+
+#include "hidapi.h"
+
+#define VIRTUAL_DEVICE_VID 0xE220
+#define VIRTUAL_DEVICE_PID 0x0100
+
+#define VIRTUAL_DEVICE_PATH_PREFIX "virtual:"
+#define VIRTUAL_DEVICE_SERIAL_FORMAT "VIRTUAL%04u"
+#define VIRTUAL_DEVICE_MANUFACTURER L"Virtual"
+#define VIRTUAL_DEVICE_PRODUCT L"Virtual spectrometer"
+
+/* Number of virtual devices to expose instead of the real ones */
+#define VIRTUAL_DEVICE_COUNT_ENV "SPECTROMETER_VIRTUAL_DEVICES"
+/* Optional pause between two input reports, in microseconds (e.g. 1000 for a full-speed interrupt endpoint) */
+#define VIRTUAL_DEVICE_PACKET_INTERVAL_ENV "SPECTROMETER_VIRTUAL_PACKET_INTERVAL_US"
+/* Optional loss of one input report in N on average, to exercise the recovery of the host on a marginal link */
+#define VIRTUAL_DEVICE_PACKET_LOSS_ENV "SPECTROMETER_VIRTUAL_PACKET_LOSS"
+
+#define VIRTUAL_DEVICE_MAX_COUNT 64
+#define VIRTUAL_DEVICE_FLASH_SIZE 0x20000
+#define VIRTUAL_DEVICE_MAX_FRAMES 137
+#define VIRTUAL_DEVICE_MAX_ELEMENT 3647
+#define VIRTUAL_DEVICE_LEADING_PIXELS 32
+#define VIRTUAL_DEVICE_TRAILING_PIXELS 14
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct virtual_device;
+
+/* Receives one 64-byte input report produced by the engine. */
+typedef void (*virtual_device_emit_fn)(void *context, const unsigned char *report, size_t length);
+
+/* Returns the number of virtual devices requested through VIRTUAL_DEVICE_COUNT_ENV (0 when unset). */
+unsigned int virtual_device_count(void);
+
+/* Returns 1 if path names a virtual device and stores its index. */
+int virtual_device_parse_path(const char *path, unsigned int *index);
+
+/* Builds an hid_device_info list of the virtual devices matching vendor_id/product_id (0 matches any).
+   Free it with hid_free_enumeration(). */
+struct hid_device_info *virtual_device_enumerate(unsigned short vendor_id, unsigned short product_id);
+
+/* Returns the device with the given index, creating it on first use. The state (parameters,
+   frame memory, flash) lives for the whole process, so it survives reconnects like a real device. */
+struct virtual_device *virtual_device_get(unsigned int index);
+
+/* Creates a stand-alone device that is not shared with the in-process transport (for external transports). */
+struct virtual_device *virtual_device_new(unsigned int index);
+void virtual_device_free(struct virtual_device *device);
+
+const char *virtual_device_serial(const struct virtual_device *device);
+
+/* Feeds one output report (without the report ID byte) to the firmware model.
+   Replies are passed to emit in order, each PACKET_SIZE bytes long. Thread-safe per device. */
+void virtual_device_handle_report(struct virtual_device *device, const unsigned char *report, size_t length,
+                                  virtual_device_emit_fn emit, void *context);
+
+/* Opens the in-process transport: returns a file descriptor that behaves like a hidraw node
+   (one report per read()/write()) or -1 on error. Closing the descriptor stops the firmware thread. */
+int virtual_device_open(unsigned int index);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,538 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "libspectrometer.h"
+#include "internal.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define ACCUMULATOR_AVX2
+#include <immintrin.h>
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define ACCUMULATOR_NEON
+#include <arm_neon.h>
+#endif
+
+/*
+ * Frame accumulator: per pixel sums of frames kept on the host.
+ * The integer types hold exact sums and sums of squares, the mean and the variance are computed from them on demand.
+ * The double type holds the running mean and the sum of squared deviations (Welford), which stays accurate
+ * for scaled frames whose values are not integers.
+ */
+
+/* The uint32 sums of 65537 frames of 0xFFFF still fit */
+#define MAX_UINT32_ACCUMULATED_FRAMES (UINT32_MAX / UINT16_MAX)
+#define MAX_ACCUMULATED_FRAMES UINT32_MAX
+
+/* Adds one frame. scale and weight (1 / frames including this one) are only used by the double kernels */
+typedef void (*AccumulateKernel_t)(const uint16_t* pixels, uint16_t numOfPixels, double scale, double weight, void* sums, void* squares);
+
+typedef struct FrameAccumulator_t {
+    uint8_t accumulatorType;
+    uint16_t numOfPixels;
+    uint32_t numOfFrames;
+    AccumulateKernel_t kernel;
+
+    void* sums;         // uint32_t or uint64_t sums, the running means for ACCUMULATE_DOUBLE
+    void* squares;      // uint64_t sums of squares, the sums of squared deviations for ACCUMULATE_DOUBLE
+} FrameAccumulator_t;
+
+static void _accumulateUint32(const uint16_t* pixels, uint16_t numOfPixels, double scale, double weight, void* sums, void* squares)
+{
+    uint32_t* pixelSums = (uint32_t*)sums;
+    uint64_t* pixelSquares = (uint64_t*)squares;
+    uint16_t i = 0;
+
+    (void)scale;
+    (void)weight;
+
+    for (i = 0; i < numOfPixels; ++i) {
+        pixelSums[i] += pixels[i];
+        pixelSquares[i] += (uint32_t)pixels[i] * pixels[i];
+    }
+}
+
+static void _accumulateUint64(const uint16_t* pixels, uint16_t numOfPixels, double scale, double weight, void* sums, void* squares)
+{
+    uint64_t* pixelSums = (uint64_t*)sums;
+    uint64_t* pixelSquares = (uint64_t*)squares;
+    uint16_t i = 0;
+
+    (void)scale;
+    (void)weight;
+
+    for (i = 0; i < numOfPixels; ++i) {
+        pixelSums[i] += pixels[i];
+        pixelSquares[i] += (uint32_t)pixels[i] * pixels[i];
+    }
+}
+
+static void _accumulateDouble(const uint16_t* pixels, uint16_t numOfPixels, double scale, double weight, void* sums, void* squares)
+{
+    double* means = (double*)sums;
+    double* deviations = (double*)squares;
+    double value = 0, delta = 0;
+    uint16_t i = 0;
+
+    for (i = 0; i < numOfPixels; ++i) {
+        value = pixels[i] * scale;
+        delta = value - means[i];
+        means[i] += delta * weight;
+        deviations[i] += delta * (value - means[i]);
+    }
+}
+
+#ifdef ACCUMULATOR_AVX2
+/* The vector kernels leave the pixels after the last whole vector to the scalar ones */
+
+__attribute__((target("avx2")))
+static void _accumulateUint32Avx2(const uint16_t* pixels, uint16_t numOfPixels, double scale, double weight, void* sums, void* squares)
+{
+    uint32_t* pixelSums = (uint32_t*)sums;
+    uint64_t* pixelSquares = (uint64_t*)squares;
+    __m256i values, squared;
+    uint16_t i = 0;
+
+    for (i = 0; i + 8 <= numOfPixels; i += 8) {
+        values = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)(pixels + i)));
+        squared = _mm256_mullo_epi32(values, values); // 0xFFFF squared still fits the 32 bits
+
+        _mm256_storeu_si256((__m256i*)(pixelSums + i), _mm256_add_epi32(_mm256_loadu_si256((const __m256i*)(pixelSums + i)), values));
+        _mm256_storeu_si256((__m256i*)(pixelSquares + i),
+                            _mm256_add_epi64(_mm256_loadu_si256((const __m256i*)(pixelSquares + i)),
+                                             _mm256_cvtepu32_epi64(_mm256_castsi256_si128(squared))));
+        _mm256_storeu_si256((__m256i*)(pixelSquares + i + 4),
+                            _mm256_add_epi64(_mm256_loadu_si256((const __m256i*)(pixelSquares + i + 4)),
+                                             _mm256_cvtepu32_epi64(_mm256_extracti128_si256(squared, 1))));
+    }
+
+    _accumulateUint32(pixels + i, numOfPixels - i, scale, weight, pixelSums + i, pixelSquares + i);
+}
+
+__attribute__((target("avx2")))
+static void _accumulateUint64Avx2(const uint16_t* pixels, uint16_t numOfPixels, double scale, double weight, void* sums, void* squares)
+{
+    uint64_t* pixelSums = (uint64_t*)sums;
+    uint64_t* pixelSquares = (uint64_t*)squares;
+    __m256i values, squared;
+    uint16_t i = 0;
+
+    for (i = 0; i + 8 <= numOfPixels; i += 8) {
+        values = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)(pixels + i)));
+        squared = _mm256_mullo_epi32(values, values);
+
+        _mm256_storeu_si256((__m256i*)(pixelSums + i),
+                            _mm256_add_epi64(_mm256_loadu_si256((const __m256i*)(pixelSums + i)),
+                                             _mm256_cvtepu32_epi64(_mm256_castsi256_si128(values))));
+        _mm256_storeu_si256((__m256i*)(pixelSums + i + 4),
+                            _mm256_add_epi64(_mm256_loadu_si256((const __m256i*)(pixelSums + i + 4)),
+                                             _mm256_cvtepu32_epi64(_mm256_extracti128_si256(values, 1))));
+        _mm256_storeu_si256((__m256i*)(pixelSquares + i),
+                            _mm256_add_epi64(_mm256_loadu_si256((const __m256i*)(pixelSquares + i)),
+                                             _mm256_cvtepu32_epi64(_mm256_castsi256_si128(squared))));
+        _mm256_storeu_si256((__m256i*)(pixelSquares + i + 4),
+                            _mm256_add_epi64(_mm256_loadu_si256((const __m256i*)(pixelSquares + i + 4)),
+                                             _mm256_cvtepu32_epi64(_mm256_extracti128_si256(squared, 1))));
+    }
+
+    _accumulateUint64(pixels + i, numOfPixels - i, scale, weight, pixelSums + i, pixelSquares + i);
+}
+
+__attribute__((target("avx2")))
+static void _accumulateDoubleAvx2(const uint16_t* pixels, uint16_t numOfPixels, double scale, double weight, void* sums, void* squares)
+{
+    double* means = (double*)sums;
+    double* deviations = (double*)squares;
+    __m256d scales = _mm256_set1_pd(scale), weights = _mm256_set1_pd(weight);
+    __m256d values, mean, delta;
+    uint16_t i = 0;
+
+    for (i = 0; i + 4 <= numOfPixels; i += 4) {
+        values = _mm256_mul_pd(_mm256_cvtepi32_pd(_mm_cvtepu16_epi32(_mm_loadl_epi64((const __m128i*)(pixels + i)))), scales);
+        mean = _mm256_loadu_pd(means + i);
+        delta = _mm256_sub_pd(values, mean);
+        mean = _mm256_add_pd(mean, _mm256_mul_pd(delta, weights));
+        _mm256_storeu_pd(means + i, mean);
+        _mm256_storeu_pd(deviations + i, _mm256_add_pd(_mm256_loadu_pd(deviations + i), _mm256_mul_pd(delta, _mm256_sub_pd(values, mean))));
+    }
+
+    _accumulateDouble(pixels + i, numOfPixels - i, scale, weight, means + i, deviations + i);
+}
+#endif
+
+#ifdef ACCUMULATOR_NEON
+static void _accumulateUint32Neon(const uint16_t* pixels, uint16_t numOfPixels, double scale, double weight, void* sums, void* squares)
+{
+    uint32_t* pixelSums = (uint32_t*)sums;
+    uint64_t* pixelSquares = (uint64_t*)squares;
+    uint16x8_t values;
+    uint16x4_t low, high;
+    uint32x4_t squaredLow, squaredHigh;
+    uint16_t i = 0;
+
+    for (i = 0; i + 8 <= numOfPixels; i += 8) {
+        values = vld1q_u16(pixels + i);
+        low = vget_low_u16(values);
+        high = vget_high_u16(values);
+        squaredLow = vmull_u16(low, low);
+        squaredHigh = vmull_u16(high, high);
+
+        vst1q_u32(pixelSums + i, vaddw_u16(vld1q_u32(pixelSums + i), low));
+        vst1q_u32(pixelSums + i + 4, vaddw_u16(vld1q_u32(pixelSums + i + 4), high));
+        vst1q_u64(pixelSquares + i, vaddw_u32(vld1q_u64(pixelSquares + i), vget_low_u32(squaredLow)));
+        vst1q_u64(pixelSquares + i + 2, vaddw_u32(vld1q_u64(pixelSquares + i + 2), vget_high_u32(squaredLow)));
+        vst1q_u64(pixelSquares + i + 4, vaddw_u32(vld1q_u64(pixelSquares + i + 4), vget_low_u32(squaredHigh)));
+        vst1q_u64(pixelSquares + i + 6, vaddw_u32(vld1q_u64(pixelSquares + i + 6), vget_high_u32(squaredHigh)));
+    }
+
+    _accumulateUint32(pixels + i, numOfPixels - i, scale, weight, pixelSums + i, pixelSquares + i);
+}
+
+static void _accumulateUint64Neon(const uint16_t* pixels, uint16_t numOfPixels, double scale, double weight, void* sums, void* squares)
+{
+    uint64_t* pixelSums = (uint64_t*)sums;
+    uint64_t* pixelSquares = (uint64_t*)squares;
+    uint16x8_t values;
+    uint16x4_t low, high;
+    uint32x4_t widenedLow, widenedHigh, squaredLow, squaredHigh;
+    uint16_t i = 0;
+
+    for (i = 0; i + 8 <= numOfPixels; i += 8) {
+        values = vld1q_u16(pixels + i);
+        low = vget_low_u16(values);
+        high = vget_high_u16(values);
+        widenedLow = vmovl_u16(low);
+        widenedHigh = vmovl_u16(high);
+        squaredLow = vmull_u16(low, low);
+        squaredHigh = vmull_u16(high, high);
+
+        vst1q_u64(pixelSums + i, vaddw_u32(vld1q_u64(pixelSums + i), vget_low_u32(widenedLow)));
+        vst1q_u64(pixelSums + i + 2, vaddw_u32(vld1q_u64(pixelSums + i + 2), vget_high_u32(widenedLow)));
+        vst1q_u64(pixelSums + i + 4, vaddw_u32(vld1q_u64(pixelSums + i + 4), vget_low_u32(widenedHigh)));
+        vst1q_u64(pixelSums + i + 6, vaddw_u32(vld1q_u64(pixelSums + i + 6), vget_high_u32(widenedHigh)));
+        vst1q_u64(pixelSquares + i, vaddw_u32(vld1q_u64(pixelSquares + i), vget_low_u32(squaredLow)));
+        vst1q_u64(pixelSquares + i + 2, vaddw_u32(vld1q_u64(pixelSquares + i + 2), vget_high_u32(squaredLow)));
+        vst1q_u64(pixelSquares + i + 4, vaddw_u32(vld1q_u64(pixelSquares + i + 4), vget_low_u32(squaredHigh)));
+        vst1q_u64(pixelSquares + i + 6, vaddw_u32(vld1q_u64(pixelSquares + i + 6), vget_high_u32(squaredHigh)));
+    }
+
+    _accumulateUint64(pixels + i, numOfPixels - i, scale, weight, pixelSums + i, pixelSquares + i);
+}
+
+#if defined(__aarch64__)
+static void _accumulateDoubleNeon(const uint16_t* pixels, uint16_t numOfPixels, double scale, double weight, void* sums, void* squares)
+{
+    double* means = (double*)sums;
+    double* deviations = (double*)squares;
+    float64x2_t scales = vdupq_n_f64(scale), weights = vdupq_n_f64(weight);
+    float64x2_t values, mean, delta;
+    uint32x2_t widened;
+    uint16_t i = 0;
+
+    for (i = 0; i + 2 <= numOfPixels; i += 2) {
+        widened = vcreate_u32((uint64_t)pixels[i] | ((uint64_t)pixels[i + 1] << 32));
+        values = vmulq_f64(vcvtq_f64_u64(vmovl_u32(widened)), scales);
+        mean = vld1q_f64(means + i);
+        delta = vsubq_f64(values, mean);
+        mean = vaddq_f64(mean, vmulq_f64(delta, weights));
+        vst1q_f64(means + i, mean);
+        vst1q_f64(deviations + i, vaddq_f64(vld1q_f64(deviations + i), vmulq_f64(delta, vsubq_f64(values, mean))));
+    }
+
+    _accumulateDouble(pixels + i, numOfPixels - i, scale, weight, means + i, deviations + i);
+}
+#endif
+#endif
+
+/* Picks the fastest kernel the processor running the library supports */
+static AccumulateKernel_t _selectKernel(uint8_t accumulatorType)
+{
+#ifdef ACCUMULATOR_AVX2
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        switch (accumulatorType) {
+            case ACCUMULATE_UINT32: return _accumulateUint32Avx2;
+            case ACCUMULATE_UINT64: return _accumulateUint64Avx2;
+            default: return _accumulateDoubleAvx2;
+        }
+    }
+#endif
+
+#ifdef ACCUMULATOR_NEON
+    switch (accumulatorType) {
+        case ACCUMULATE_UINT32: return _accumulateUint32Neon;
+        case ACCUMULATE_UINT64: return _accumulateUint64Neon;
+#if defined(__aarch64__)
+        default: return _accumulateDoubleNeon;
+#else
+        default: return _accumulateDouble;
+#endif
+    }
+#endif
+
+    switch (accumulatorType) {
+        case ACCUMULATE_UINT32: return _accumulateUint32;
+        case ACCUMULATE_UINT64: return _accumulateUint64;
+        default: return _accumulateDouble;
+    }
+}
+
+static size_t _sumSize(uint8_t accumulatorType)
+{
+    switch (accumulatorType) {
+        case ACCUMULATE_UINT32: return sizeof(uint32_t);
+        case ACCUMULATE_UINT64: return sizeof(uint64_t);
+        default: return sizeof(double);
+    }
+}
+
+static FrameAccumulator_t* _getAccumulator(const uintptr_t* const accumulatorPtr)
+{
+    if (!accumulatorPtr) {
+        return NULL;
+    }
+
+    return (FrameAccumulator_t*)(*accumulatorPtr);
+}
+
+/* The 128 bits product of two 64 bits numbers */
+static void _multiply64(uint64_t a, uint64_t b, uint64_t* high, uint64_t* low)
+{
+    uint64_t p0 = (a & 0xFFFFFFFFULL) * (b & 0xFFFFFFFFULL);
+    uint64_t p1 = (a & 0xFFFFFFFFULL) * (b >> 32);
+    uint64_t p2 = (a >> 32) * (b & 0xFFFFFFFFULL);
+    uint64_t p3 = (a >> 32) * (b >> 32);
+    uint64_t middle = (p0 >> 32) + (p1 & 0xFFFFFFFFULL) + (p2 & 0xFFFFFFFFULL);
+
+    *low = (middle << 32) | (p0 & 0xFFFFFFFFULL);
+    *high = p3 + (p1 >> 32) + (p2 >> 32) + (middle >> 32);
+}
+
+/* numOfFrames * sumOfSquares - sum * sum is computed exactly, only the final division rounds */
+static double _exactVariance(uint64_t sum, uint64_t sumOfSquares, uint32_t numOfFrames)
+{
+    uint64_t squaresHigh = 0, squaresLow = 0, sumHigh = 0, sumLow = 0;
+    uint64_t differenceHigh = 0, differenceLow = 0;
+
+    _multiply64(sumOfSquares, numOfFrames, &squaresHigh, &squaresLow);
+    _multiply64(sum, sum, &sumHigh, &sumLow);
+
+    differenceLow = squaresLow - sumLow;
+    differenceHigh = squaresHigh - sumHigh - (squaresLow < sumLow);
+
+    return (differenceHigh * 18446744073709551616.0 + differenceLow) / ((double)numOfFrames * numOfFrames);
+}
+
+int createFrameAccumulator(uint16_t numOfPixels, uint8_t accumulatorType, uintptr_t* accumulatorPtr)
+{
+    FrameAccumulator_t* accumulator = NULL;
+
+    if (!accumulatorPtr || !numOfPixels ||
+        (accumulatorType != ACCUMULATE_UINT32 && accumulatorType != ACCUMULATE_UINT64 && accumulatorType != ACCUMULATE_DOUBLE)) {
+        return INPUT_PARAMETER_NOT_INITIALIZED;
+    }
+
+    destroyFrameAccumulator(accumulatorPtr);
+
+    accumulator = calloc(1, sizeof(FrameAccumulator_t));
+    if (!accumulator) {
+        return ACCUMULATOR_FAILED;
+    }
+
+    accumulator->accumulatorType = accumulatorType;
+    accumulator->numOfPixels = numOfPixels;
+    accumulator->kernel = _selectKernel(accumulatorType);
+    accumulator->sums = calloc(numOfPixels, _sumSize(accumulatorType));
+    accumulator->squares = calloc(numOfPixels, (accumulatorType == ACCUMULATE_DOUBLE)? sizeof(double): sizeof(uint64_t));
+
+    if (!accumulator->sums || !accumulator->squares) {
+        free(accumulator->sums);
+        free(accumulator->squares);
+        free(accumulator);
+        return ACCUMULATOR_FAILED;
+    }
+
+    *accumulatorPtr = (uintptr_t)accumulator;
+
+    return OK;
+}
+
+int destroyFrameAccumulator(uintptr_t* accumulatorPtr)
+{
+    FrameAccumulator_t* accumulator = _getAccumulator(accumulatorPtr);
+
+    if (!accumulator) {
+        return NO_DEVICE_CONTEXT_ERROR;
+    }
+
+    free(accumulator->sums);
+    free(accumulator->squares);
+    free(accumulator);
+    *accumulatorPtr = 0;
+
+    return OK;
+}
+
+int resetFrameAccumulator(uintptr_t* accumulatorPtr)
+{
+    FrameAccumulator_t* accumulator = _getAccumulator(accumulatorPtr);
+
+    if (!accumulator) {
+        return NO_DEVICE_CONTEXT_ERROR;
+    }
+
+    memset(accumulator->sums, 0, accumulator->numOfPixels * _sumSize(accumulator->accumulatorType));
+    memset(accumulator->squares, 0, accumulator->numOfPixels * sizeof(uint64_t)); // same size as double
+    accumulator->numOfFrames = 0;
+
+    return OK;
+}
+
+int accumulateFrames(const uint16_t* framesPixelsBuffer, uint16_t numOfFrames, uintptr_t* accumulatorPtr)
+{
+    return accumulateScaledFrames(framesPixelsBuffer, numOfFrames, 1.0, accumulatorPtr);
+}
+
+int accumulateScaledFrames(const uint16_t* framesPixelsBuffer, uint16_t numOfFrames, double scale, uintptr_t* accumulatorPtr)
+{
+    FrameAccumulator_t* accumulator = _getAccumulator(accumulatorPtr);
+    uint32_t maxFrames = MAX_ACCUMULATED_FRAMES;
+    uint16_t i = 0;
+
+    if (!accumulator) {
+        return NO_DEVICE_CONTEXT_ERROR;
+    }
+
+    if (!framesPixelsBuffer || !numOfFrames) {
+        return INPUT_PARAMETER_NOT_INITIALIZED;
+    }
+
+    if (scale != 1.0 && accumulator->accumulatorType != ACCUMULATE_DOUBLE) {
+        return OPERATION_NOT_SUPPORTED;
+    }
+
+    if (accumulator->accumulatorType == ACCUMULATE_UINT32) {
+        maxFrames = MAX_UINT32_ACCUMULATED_FRAMES;
+    }
+    if (numOfFrames > maxFrames - accumulator->numOfFrames) {
+        return ACCUMULATOR_OVERFLOW;
+    }
+
+    for (i = 0; i < numOfFrames; ++i) {
+        accumulator->numOfFrames++;
+        accumulator->kernel(framesPixelsBuffer + (size_t)i * accumulator->numOfPixels, accumulator->numOfPixels,
+                            scale, 1.0 / accumulator->numOfFrames, accumulator->sums, accumulator->squares);
+    }
+
+    return OK;
+}
+
+int getAccumulatedFrames(uint32_t* numOfFrames, uintptr_t* accumulatorPtr)
+{
+    FrameAccumulator_t* accumulator = _getAccumulator(accumulatorPtr);
+
+    if (!accumulator) {
+        return NO_DEVICE_CONTEXT_ERROR;
+    }
+
+    if (!numOfFrames) {
+        return INPUT_PARAMETER_NOT_INITIALIZED;
+    }
+
+    *numOfFrames = accumulator->numOfFrames;
+
+    return OK;
+}
+
+int getAccumulatedSum(double* sumBuffer, uintptr_t* accumulatorPtr)
+{
+    FrameAccumulator_t* accumulator = _getAccumulator(accumulatorPtr);
+    uint16_t i = 0;
+
+    if (!accumulator) {
+        return NO_DEVICE_CONTEXT_ERROR;
+    }
+
+    if (!sumBuffer) {
+        return INPUT_PARAMETER_NOT_INITIALIZED;
+    }
+
+    for (i = 0; i < accumulator->numOfPixels; ++i) {
+        switch (accumulator->accumulatorType) {
+            case ACCUMULATE_UINT32: sumBuffer[i] = ((uint32_t*)accumulator->sums)[i]; break;
+            case ACCUMULATE_UINT64: sumBuffer[i] = (double)((uint64_t*)accumulator->sums)[i]; break;
+            default: sumBuffer[i] = ((double*)accumulator->sums)[i] * accumulator->numOfFrames; break;
+        }
+    }
+
+    return OK;
+}
+
+int getAccumulatedMean(double* meanBuffer, uintptr_t* accumulatorPtr)
+{
+    FrameAccumulator_t* accumulator = _getAccumulator(accumulatorPtr);
+    uint16_t i = 0;
+
+    if (!accumulator) {
+        return NO_DEVICE_CONTEXT_ERROR;
+    }
+
+    if (!meanBuffer) {
+        return INPUT_PARAMETER_NOT_INITIALIZED;
+    }
+
+    if (!accumulator->numOfFrames) {
+        memset(meanBuffer, 0, accumulator->numOfPixels * sizeof(double));
+        return OK;
+    }
+
+    if (accumulator->accumulatorType == ACCUMULATE_DOUBLE) {
+        memcpy(meanBuffer, accumulator->sums, accumulator->numOfPixels * sizeof(double));
+        return OK;
+    }
+
+    for (i = 0; i < accumulator->numOfPixels; ++i) {
+        if (accumulator->accumulatorType == ACCUMULATE_UINT32) {
+            meanBuffer[i] = (double)((uint32_t*)accumulator->sums)[i] / accumulator->numOfFrames;
+        } else {
+            meanBuffer[i] = (double)((uint64_t*)accumulator->sums)[i] / accumulator->numOfFrames;
+        }
+    }
+
+    return OK;
+}
+
+int getAccumulatedVariance(double* varianceBuffer, uintptr_t* accumulatorPtr)
+{
+    FrameAccumulator_t* accumulator = _getAccumulator(accumulatorPtr);
+    uint64_t sum = 0;
+    uint16_t i = 0;
+
+    if (!accumulator) {
+        return NO_DEVICE_CONTEXT_ERROR;
+    }
+
+    if (!varianceBuffer) {
+        return INPUT_PARAMETER_NOT_INITIALIZED;
+    }
+
+    for (i = 0; i < accumulator->numOfPixels; ++i) {
+        if (!accumulator->numOfFrames) {
+            varianceBuffer[i] = 0;
+            continue;
+        }
+
+        switch (accumulator->accumulatorType) {
+            case ACCUMULATE_UINT32: sum = ((uint32_t*)accumulator->sums)[i]; break;
+            case ACCUMULATE_UINT64: sum = ((uint64_t*)accumulator->sums)[i]; break;
+            default:
+                varianceBuffer[i] = ((double*)accumulator->squares)[i] / accumulator->numOfFrames;
+                continue;
+        }
+
+        varianceBuffer[i] = _exactVariance(sum, ((uint64_t*)accumulator->squares)[i], accumulator->numOfFrames);
+    }
+
+    return OK;
+}
@@ -1,12 +1,19 @@
 #include <stdlib.h>
+#include <string.h>
 #include "internal.h"
 
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
 //hid_device*  g_Device = NULL;
 //uint16_t g_numOfPixelsInFrame = 0;
 //char* g_savedSerial = NULL;
 
 const DeviceContext_t NULL_DEVICE_CONTEXT = { // or maybe FOO_DEFAULT or something
-    NULL, 0, NULL
+    NULL, 0, NULL, {0, 0, 0}, {0}, 0, 0
 };
 
 #define OK 0
@@ -23,6 +30,15 @@ const DeviceContext_t NULL_DEVICE_CONTEXT = { // or maybe FOO_DEFAULT or somethi
 #define READ_FLASH_REMAINING_PACKETS_ERROR 510
 
 #define CONNECT_ERROR_WRONG_SERIAL_NUMBER 516
+#define HOTPLUG_MONITOR_FAILED 517
+#define OPERATION_IN_PROGRESS 518
+#define REACTOR_FAILED 519
+#define OPERATION_NOT_SUPPORTED 520
+#define WAIT_FOR_FRAMES_TIMEOUT 521
+#define FRAMES_WATCH_FAILED 522
+#define ACCUMULATOR_FAILED 523
+#define ACCUMULATOR_OVERFLOW 524
+#define FRAME_REGION_OUT_OF_RANGE 525
 #define NO_DEVICE_CONTEXT_ERROR 585
 
 int _verifyDeviceContextByPtr(const uintptr_t* const deviceContextPtr)
@@ -41,6 +57,8 @@ int _verifyDeviceContextByPtr(const uintptr_t* const deviceContextPtr)
 int _reconnect(uintptr_t *deviceContextPtr)
 {
     int result = 0;
+    size_t serialLength = 0;
+    wchar_t *serialWChar = NULL;
     DeviceContext_t* deviceContext = NULL;
 
     result = _verifyDeviceContextByPtr(deviceContextPtr);
@@ -49,8 +67,27 @@ int _reconnect(uintptr_t *deviceContextPtr)
 
     deviceContext = (DeviceContext_t*)(*deviceContextPtr);
 
-    result = connectToDeviceBySerial(deviceContext->serial, deviceContextPtr);
-    return result;
+    //the device may have been power cycled meanwhile
+    deviceContext->parameters = NULL_DEVICE_CONTEXT.parameters;
+    deviceContext->numOfPixelsInFrame = 0;
+    deviceContext->triggerTime = 0;
+
+    if (deviceContext->serial) {
+        serialLength = strlen(deviceContext->serial) + 1;
+        serialWChar = calloc(serialLength, sizeof(wchar_t));
+        if (!serialWChar) {
+            return CONNECT_ERROR_FAILED;
+        }
+        mbstowcs(serialWChar, deviceContext->serial, serialLength);
+    }
+
+    //only the handle is opened again, the context and its serial stay those of the caller
+    hid_close(deviceContext->handle);
+    ++deviceContext->numOfReconnections;
+    deviceContext->handle = hid_open(USBD_VID, USBD_PID, (const wchar_t *)serialWChar);
+    free(serialWChar);
+
+    return deviceContext->handle? OK : CONNECT_ERROR_FAILED;
 }
 
 void _recursiveClearing(DeviceInfo_t * const devices)
@@ -60,6 +97,8 @@ void _recursiveClearing(DeviceInfo_t * const devices)
 
         free(devices->serialNumber);
         devices->serialNumber = NULL;
+        free(devices->path);
+        devices->path = NULL;
 
         //NOTE: check if this step is neccessary
         if (devices->next) {
@@ -69,6 +108,46 @@ void _recursiveClearing(DeviceInfo_t * const devices)
     }
 }
 
+/* The clock of the report stamps of hidapi, so that the times of the library and of hidapi can be subtracted */
+int64_t _transferClockNanoseconds(void)
+{
+#if defined(_WIN32)
+    LARGE_INTEGER counter, frequency;
+
+    QueryPerformanceCounter(&counter);
+    QueryPerformanceFrequency(&frequency);
+    return (int64_t)(counter.QuadPart / frequency.QuadPart) * 1000000000LL +
+           (int64_t)(counter.QuadPart % frequency.QuadPart) * 1000000000LL / frequency.QuadPart;
+#else
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+#endif
+}
+
+/* Starts the times of a new exchange, taken just before its request is written */
+void _stampRequest(DeviceContext_t* deviceContext)
+{
+    deviceContext->timestamps.requestTime = _transferClockNanoseconds();
+    deviceContext->timestamps.firstReplyTime = 0;
+    deviceContext->timestamps.lastReplyTime = 0;
+}
+
+/* Records the arrival of the packets just read, the first read of a reply also sets firstReplyTime */
+void _stampReplies(DeviceContext_t* deviceContext, bool firstOfReply)
+{
+    long long firstTime = 0, lastTime = 0;
+
+    if (hid_get_report_times(deviceContext->handle, &firstTime, &lastTime) != 0) {
+        firstTime = lastTime = _transferClockNanoseconds();
+    }
+
+    if (firstOfReply)
+        deviceContext->timestamps.firstReplyTime = firstTime;
+    deviceContext->timestamps.lastReplyTime = lastTime;
+}
+
 int _tryWrite(unsigned char* const report, uintptr_t *deviceContextPtr)
 {
     int result = -1;
@@ -84,6 +163,8 @@ int _tryWrite(unsigned char* const report, uintptr_t *deviceContextPtr)
     deviceContext = (DeviceContext_t*)(*deviceContextPtr);
 
     do {
+        _stampRequest(deviceContext);
+
         result = hid_write(deviceContext->handle, (const unsigned char*)report, EXTENDED_PACKET_SIZE);
         if (result != HID_OPERATION_WRITE_SUCCESS) {
             if (reconnectAttempted) {
@@ -119,6 +200,8 @@ int _tryRead(unsigned char * const report, unsigned char correctAnswer, uint16_t
         return READING_PROCESS_FAILED;
     }
 
+    _stampReplies(deviceContext, true);
+
     if (report[0] != correctAnswer) {
         return WRONG_ANSWER;
     }
@@ -176,3 +259,157 @@ int _writeReadFunction(unsigned char* const report, uint8_t correctReply, uint16
     return result;
 }
 
+void _fillGetFrameRequest(unsigned char* const report, uint16_t pixelOffset, uint16_t numOfFrame, uint8_t numOfPackets)
+{
+    report[0] = ZERO_REPORT_ID;
+    report[1] = GET_FRAME_REQUEST;
+    report[2] = LOW_BYTE(pixelOffset);
+    report[3] = HIGH_BYTE(pixelOffset);
+    report[4] = LOW_BYTE(numOfFrame);
+    report[5] = HIGH_BYTE(numOfFrame);
+    report[6] = numOfPackets;
+}
+
+void _fillSetFrameFormatRequest(unsigned char* const report, uint16_t numOfStartElement, uint16_t numOfEndElement, uint8_t reductionMode)
+{
+    report[0] = ZERO_REPORT_ID;
+    report[1] = SET_FRAME_FORMAT_REQUEST;
+    report[2] = LOW_BYTE(numOfStartElement);
+    report[3] = HIGH_BYTE(numOfStartElement);
+    report[4] = LOW_BYTE(numOfEndElement);
+    report[5] = HIGH_BYTE(numOfEndElement);
+    report[6] = reductionMode;
+}
+
+void _fillSetExposureRequest(unsigned char* const report, uint32_t timeOfExposure, uint8_t force)
+{
+    report[0] = ZERO_REPORT_ID;
+    report[1] = SET_EXPOSURE_REQUEST;
+    report[2] = LOW_BYTE(LOW_WORD(timeOfExposure));           //(exposure >> 24) & 0xFF;
+    report[3] = HIGH_BYTE(LOW_WORD(timeOfExposure));          //(exposure >> 16) & 0xFF;
+    report[4] = LOW_BYTE(HIGH_WORD(timeOfExposure));          //(exposure >> 8)  & 0xFF;
+    report[5] = HIGH_BYTE(HIGH_WORD(timeOfExposure));         //exposure & 0xFF;
+    report[6] = force;
+}
+
+/* SET_ALL_PARAMETERS_REQUEST is SET_ACQUISITION_PARAMETERS_REQUEST followed by the external trigger */
+void _fillSetAcquisitionParametersRequest(unsigned char* const report, uint8_t request, uint16_t numOfScans, uint16_t numOfBlankScans,
+                                          uint8_t scanMode, uint32_t timeOfExposure, uint8_t enableMode, uint8_t signalFrontMode)
+{
+    report[0] = ZERO_REPORT_ID;
+    report[1] = request;
+    report[2] = LOW_BYTE(numOfScans);
+    report[3] = HIGH_BYTE(numOfScans);
+    report[4] = LOW_BYTE(numOfBlankScans);
+    report[5] = HIGH_BYTE(numOfBlankScans);
+    report[6] = scanMode;
+    report[7] = LOW_BYTE(LOW_WORD(timeOfExposure));
+    report[8] = HIGH_BYTE(LOW_WORD(timeOfExposure));
+    report[9] = LOW_BYTE(HIGH_WORD(timeOfExposure));
+    report[10] = HIGH_BYTE(HIGH_WORD(timeOfExposure));
+    if (request == SET_ALL_PARAMETERS_REQUEST) {
+        report[11] = enableMode;
+        report[12] = signalFrontMode;
+    }
+}
+
+void _fillSetExternalTriggerRequest(unsigned char* const report, uint8_t enableMode, uint8_t signalFrontMode)
+{
+    report[0] = ZERO_REPORT_ID;
+    report[1] = SET_EXTERNAL_TRIGGER_REQUEST;
+    report[2] = enableMode;
+    report[3] = signalFrontMode;
+}
+
+void _fillSetOpticalTriggerRequest(unsigned char* const report, uint8_t enableMode, uint16_t pixel, uint16_t threshold)
+{
+    report[0] = ZERO_REPORT_ID;
+    report[1] = SET_OPTICAl_TRIGGER_REQUEST;
+    report[2] = enableMode;
+    report[3] = LOW_BYTE(pixel);
+    report[4] = HIGH_BYTE(pixel);
+    report[5] = LOW_BYTE(threshold);
+    report[6] = HIGH_BYTE(threshold);
+}
+
+/* numOfPacketsReceived counts the packets of the request including this one,
+   pixelsBuffer receives the pixels numOfFirstPixel to endOfPixels - 1 of the frame */
+int _parseGetFramePacket(const unsigned char* const report, uint8_t numOfPacketsToGet, uint8_t numOfPacketsReceived,
+                         uint16_t numOfFirstPixel, uint16_t endOfPixels, uint16_t* pixelsBuffer, uint8_t* numOfPacketsLeft)
+{
+    uint16_t pixelOffset = 0;
+    uint16_t numOfPixelsInPacket = 0;
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+    uint16_t indexOfPixelInPacket = 0;
+#endif
+
+    if (report[0] != CORRECT_GET_FRAME_REPLY) {
+        return WRONG_ANSWER;
+    }
+
+    *numOfPacketsLeft = report[3];
+    if (*numOfPacketsLeft >= REMAINING_PACKETS_ERROR) {
+        return GET_FRAME_REMAINING_PACKETS_ERROR;
+    }
+
+    /* A packet out of sequence is stored all the same, the caller may keep it and re-request the missing ones */
+    pixelOffset = (report[2] << 8) | report[1];
+    if (pixelOffset < numOfFirstPixel || pixelOffset >= endOfPixels) {
+        return (*numOfPacketsLeft != numOfPacketsToGet - numOfPacketsReceived)? GET_FRAME_REMAINING_PACKETS_ERROR : OK;
+    }
+
+    /* Only the last packet of a request is partial */
+    numOfPixelsInPacket = endOfPixels - pixelOffset;
+    if (numOfPixelsInPacket > NUM_OF_PIXELS_IN_PACKET) {
+        numOfPixelsInPacket = NUM_OF_PIXELS_IN_PACKET;
+    }
+
+    /* The payload is an array of little-endian pixels: it is the frame buffer itself on little-endian hosts */
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+    for (indexOfPixelInPacket = 0; indexOfPixelInPacket < numOfPixelsInPacket; ++indexOfPixelInPacket) {
+        pixelsBuffer[pixelOffset - numOfFirstPixel + indexOfPixelInPacket] = (report[5 + 2 * indexOfPixelInPacket] << 8) | report[4 + 2 * indexOfPixelInPacket];
+    }
+#else
+    memcpy(pixelsBuffer + (pixelOffset - numOfFirstPixel), report + 4, numOfPixelsInPacket * sizeof(uint16_t));
+#endif
+
+    return (*numOfPacketsLeft != numOfPacketsToGet - numOfPacketsReceived)? GET_FRAME_REMAINING_PACKETS_ERROR : OK;
+}
+
+void _fillReadFlashRequest(unsigned char* const report, uint32_t absoluteOffset, uint8_t numOfPackets)
+{
+    report[0] = ZERO_REPORT_ID;
+    report[1] = READ_FLASH_REQUEST;
+    report[2] = LOW_BYTE(LOW_WORD(absoluteOffset));
+    report[3] = HIGH_BYTE(LOW_WORD(absoluteOffset));
+    report[4] = LOW_BYTE(HIGH_WORD(absoluteOffset));
+    report[5] = HIGH_BYTE(HIGH_WORD(absoluteOffset));
+    report[6] = numOfPackets;
+}
+
+/* buffer and bytesToRead describe the part of the destination that starts at the requested offset */
+int _parseReadFlashPacket(const unsigned char* const report, uint8_t numOfPacketsToGet, uint8_t numOfPacketsReceived,
+                          uint32_t bytesToRead, uint8_t* buffer, uint8_t* numOfPacketsLeft)
+{
+    uint16_t localOffset = 0;
+    uint8_t indexOfByteInPacket = 0;
+
+    if (report[0] != CORRECT_READ_FLASH_REPLY) {
+        return WRONG_ANSWER;
+    }
+
+    *numOfPacketsLeft = report[3];
+    if (*numOfPacketsLeft >= REMAINING_PACKETS_ERROR ||
+        (*numOfPacketsLeft != numOfPacketsToGet - numOfPacketsReceived)) {
+        return READ_FLASH_REMAINING_PACKETS_ERROR;
+    }
+
+    localOffset = (report[2] << 8) | report[1];
+
+    while ((localOffset + indexOfByteInPacket < bytesToRead) && (indexOfByteInPacket < READ_FLASH_PAYLOAD)) {
+        buffer[localOffset + indexOfByteInPacket] = report[4 + indexOfByteInPacket];
+        ++indexOfByteInPacket;
+    }
+
+    return OK;
+}
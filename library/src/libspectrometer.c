@@ -1,5 +1,6 @@
 #include "libspectrometer.h"
 #include "internal.h"
+#include <limits.h>
 
 #if defined(_WIN32)
 #include <windows.h>
@@ -30,6 +31,9 @@
 #else
     #include <stdlib.h>
     #include <string.h>
+    #include <time.h>
+    #include <errno.h>
+    #include <pthread.h>
 
 
 #endif //defined _WIN32
@@ -69,6 +73,7 @@ int connectToDeviceBySerial(const char * const serialNumber, uintptr_t* deviceCo
 
     deviceContext = (DeviceContext_t*)(*deviceContextPtr);
     free(deviceContext);
+    *deviceContextPtr = 0;
 
     deviceContext = malloc(sizeof(DeviceContext_t));
     *deviceContext = NULL_DEVICE_CONTEXT;
@@ -87,6 +92,7 @@ int connectToDeviceBySerial(const char * const serialNumber, uintptr_t* deviceCo
     deviceContext->handle = hid_open(USBD_VID, USBD_PID, (const wchar_t *)serialWChar);
     if (deviceContext->handle == NULL) {
          free(serialWChar);
+         free(deviceContext);
          return CONNECT_ERROR_FAILED;
     }
 
@@ -100,6 +106,8 @@ int connectToDeviceBySerial(const char * const serialNumber, uintptr_t* deviceCo
         free(serialWChar);
     }
 
+    *deviceContextPtr = (uintptr_t)deviceContext;
+
     return OK;
 }
 
@@ -166,6 +174,215 @@ int connectToDeviceByIndex(unsigned int index, uintptr_t* deviceContextPtr)   //
     return OK;
 }
 
+/* Copies the serial number the enumeration reports for path, returns false if there is none */
+static bool _findSerialOfPath(const char* const path, wchar_t* serialBuffer)
+{
+    struct hid_device_info *devices = hid_enumerate(USBD_VID, USBD_PID), *device = NULL;
+    bool found = false;
+
+    for (device = devices; device; device = device->next) {
+        if (device->path && strcmp(device->path, path) == 0 && device->serial_number && device->serial_number[0]) {
+            wcsncpy(serialBuffer, device->serial_number, MAX_SERIAL_NUMBER_LENGTH);
+            serialBuffer[MAX_SERIAL_NUMBER_LENGTH] = 0;
+            found = true;
+            break;
+        }
+    }
+
+    hid_free_enumeration(devices);
+
+    return found;
+}
+
+/* Opens the device at path into a new context; serialWChar may be NULL to ask the device for it.
+   A context without its serial number would reconnect to whichever device comes first, so the serial is required. */
+static int _openDeviceContext(const char* const path, const wchar_t* serialWChar, uintptr_t* deviceContextPtr)
+{
+    wchar_t serialBuffer[MAX_SERIAL_NUMBER_LENGTH + 1];
+    int cBytesCount = 0, wcLen = 0;
+    DeviceContext_t *deviceContext = NULL;
+    hid_device *handle = hid_open_path(path);
+
+    if (handle == NULL) {
+        return CONNECT_ERROR_FAILED;
+    }
+
+    if (!serialWChar || !serialWChar[0]) {
+        serialBuffer[0] = 0;
+        if (hid_get_serial_number_string(handle, serialBuffer, MAX_SERIAL_NUMBER_LENGTH) != 0 || !serialBuffer[0]) {
+            if (!_findSerialOfPath(path, serialBuffer)) {
+                hid_close(handle);
+                return CONNECT_ERROR_FAILED;
+            }
+        }
+        serialBuffer[MAX_SERIAL_NUMBER_LENGTH] = 0;
+        serialWChar = serialBuffer;
+    }
+
+    deviceContext = malloc(sizeof(DeviceContext_t));
+    *deviceContext = NULL_DEVICE_CONTEXT;
+    deviceContext->handle = handle;
+
+    wcLen = wcslen(serialWChar);
+    cBytesCount = wcstombs(NULL, serialWChar, wcLen);
+
+    deviceContext->serial = calloc(cBytesCount + 1, sizeof(char));
+    wcstombs(deviceContext->serial, serialWChar, wcLen);
+
+    *deviceContextPtr = (uintptr_t)deviceContext;
+
+    return OK;
+}
+
+int connectToDeviceByPath(const char * const path, uintptr_t* deviceContextPtr)
+{
+    if (!deviceContextPtr) {
+        return NO_DEVICE_CONTEXT_ERROR;
+    }
+
+    if (!path) {
+        return INPUT_PARAMETER_NOT_INITIALIZED;
+    }
+
+    if (*deviceContextPtr) {
+        disconnectDeviceContext(deviceContextPtr);
+    }
+
+    return _openDeviceContext(path, NULL, deviceContextPtr);
+}
+
+typedef struct {
+    const struct hid_device_info* device;
+    uintptr_t deviceContext;
+    int result;
+} ConnectJob_t;
+
+#if defined(_WIN32)
+static DWORD WINAPI _connectJob(LPVOID argument)
+#else
+static void* _connectJob(void* argument)
+#endif
+{
+    ConnectJob_t* job = (ConnectJob_t*)argument;
+
+    job->result = _openDeviceContext(job->device->path, job->device->serial_number, &job->deviceContext);
+    return 0;
+}
+
+int connectAllDevices(uintptr_t* deviceContexts, int* connectResults, uint32_t maxNumOfDevices, uint32_t* numOfDevices)
+{
+    struct hid_device_info *devices = NULL, *device = NULL;
+    ConnectJob_t* jobs = NULL;
+    uint32_t count = 0, index = 0, connected = 0;
+    int result = OK;
+    bool allocated = false;
+#if defined(_WIN32)
+    HANDLE* threads = NULL;
+#else
+    pthread_t* threads = NULL;
+    int* started = NULL;
+#endif
+
+    if (!deviceContexts || !numOfDevices) {
+        return INPUT_PARAMETER_NOT_INITIALIZED;
+    }
+
+    *numOfDevices = 0;
+
+    devices = hid_enumerate(USBD_VID, USBD_PID);
+    for (device = devices; device && count < maxNumOfDevices; device = device->next) {
+        ++count;
+    }
+
+    if (connectResults) {
+        for (index = count; index < maxNumOfDevices; ++index) {
+            connectResults[index] = CONNECT_ERROR_NOT_FOUND;
+        }
+    }
+
+    if (!count) {
+        hid_free_enumeration(devices);
+        return CONNECT_ERROR_NOT_FOUND;
+    }
+
+    jobs = calloc(count, sizeof(ConnectJob_t));
+    threads = calloc(count, sizeof(*threads));
+    allocated = jobs && threads;
+#if !defined(_WIN32)
+    started = calloc(count, sizeof(int));
+    allocated = allocated && started;
+#endif
+    if (!allocated) {
+#if !defined(_WIN32)
+        free(started);
+#endif
+        free(threads);
+        free(jobs);
+        hid_free_enumeration(devices);
+        return CONNECT_ERROR_FAILED;
+    }
+
+    //every device is opened from its own thread, a slow one doesn't hold up the others
+    for (device = devices, index = 0; index < count; device = device->next, ++index) {
+        jobs[index].device = device;
+#if defined(_WIN32)
+        threads[index] = CreateThread(NULL, 0, _connectJob, &jobs[index], 0, NULL);
+        if (threads[index] == NULL) {
+            _connectJob(&jobs[index]);
+        }
+#else
+        started[index] = (pthread_create(&threads[index], NULL, _connectJob, &jobs[index]) == 0);
+        if (!started[index]) {
+            _connectJob(&jobs[index]);
+        }
+#endif
+    }
+
+    for (index = 0; index < count; ++index) {
+#if defined(_WIN32)
+        if (threads[index] != NULL) {
+            WaitForSingleObject(threads[index], INFINITE);
+            CloseHandle(threads[index]);
+        }
+#else
+        if (started[index]) {
+            pthread_join(threads[index], NULL);
+        }
+#endif
+
+        if (connectResults) {
+            connectResults[index] = jobs[index].result;
+        }
+
+        //the handles keep the enumeration order, so connectResults and deviceContexts share the index
+        if (jobs[index].result == OK) {
+            deviceContexts[index] = jobs[index].deviceContext;
+            ++connected;
+        } else {
+            deviceContexts[index] = 0;
+            if (result == OK) {
+                result = jobs[index].result;
+            }
+        }
+    }
+
+    *numOfDevices = count;
+
+    //the failures of single devices are in connectResults once any device is connected
+    if (connected) {
+        result = OK;
+    }
+
+#if !defined(_WIN32)
+    free(started);
+#endif
+    free(threads);
+    free(jobs);
+    hid_free_enumeration(devices);
+
+    return result;
+}
+
 uint32_t getDevicesCount()
 {
     int count = 0;
@@ -203,6 +420,8 @@ DeviceInfo_t *getDevicesInfo()
 
         current->serialNumber = calloc(cBytesCount + 1, sizeof(char));
         wcstombs(current->serialNumber, serialWChar, wcLen);
+        current->path = calloc(strlen(device->path) + 1, sizeof(char));
+        strcpy(current->path, device->path);
         current->next = NULL;
 
         if (resultList == NULL) {
@@ -227,6 +446,204 @@ void clearDevicesInfo(struct DeviceInfo_t *devices)
     free(devices);
 }
 
+int startHotplugMonitor(HotplugCallback_t callback, void* userData, uintptr_t* hotplugContextPtr)
+{
+    HotplugContext_t *hotplugContext = NULL;
+
+    if (!hotplugContextPtr) {
+        return NO_DEVICE_CONTEXT_ERROR;
+    }
+
+    if (!callback) {
+        return INPUT_PARAMETER_NOT_INITIALIZED;
+    }
+
+    stopHotplugMonitor(hotplugContextPtr);
+
+    hotplugContext = malloc(sizeof(HotplugContext_t));
+    hotplugContext->monitor = hid_hotplug_monitor_new(USBD_VID, USBD_PID);
+    hotplugContext->callback = callback;
+    hotplugContext->userData = userData;
+
+    if (!hotplugContext->monitor) {
+        free(hotplugContext);
+        return HOTPLUG_MONITOR_FAILED;
+    }
+
+    *hotplugContextPtr = (uintptr_t)hotplugContext;
+
+    return OK;
+}
+
+int getHotplugFileDescriptor(int* fileDescriptor, uintptr_t* hotplugContextPtr)
+{
+    HotplugContext_t *hotplugContext = NULL;
+
+    if (!hotplugContextPtr || !(*hotplugContextPtr)) {
+        return NO_DEVICE_CONTEXT_ERROR;
+    }
+
+    if (!fileDescriptor) {
+        return INPUT_PARAMETER_NOT_INITIALIZED;
+    }
+
+    hotplugContext = (HotplugContext_t*)(*hotplugContextPtr);
+    *fileDescriptor = hid_hotplug_monitor_get_fd(hotplugContext->monitor);
+
+    return (*fileDescriptor < 0)? HOTPLUG_MONITOR_FAILED : OK;
+}
+
+int processHotplugEvents(uintptr_t* hotplugContextPtr)
+{
+    HotplugContext_t *hotplugContext = NULL;
+    struct hid_device_info *device = NULL;
+    char *serial = NULL;
+    int cBytesCount = 0, wcLen = 0;
+    int event = 0;
+    int result = 0;
+
+    if (!hotplugContextPtr || !(*hotplugContextPtr)) {
+        return NO_DEVICE_CONTEXT_ERROR;
+    }
+
+    hotplugContext = (HotplugContext_t*)(*hotplugContextPtr);
+
+    while ((result = hid_hotplug_monitor_receive(hotplugContext->monitor, &event, &device)) > 0) {
+        serial = NULL;
+
+        if (device->serial_number) {
+            wcLen = wcslen(device->serial_number);
+            cBytesCount = wcstombs(NULL, device->serial_number, wcLen);
+
+            serial = calloc(cBytesCount + 1, sizeof(char));
+            wcstombs(serial, device->serial_number, wcLen);
+        }
+
+        hotplugContext->callback((event == HID_HOTPLUG_EVENT_ARRIVED)? HOTPLUG_DEVICE_ARRIVED : HOTPLUG_DEVICE_LEFT,
+                                 serial? serial : "", hotplugContext->userData);
+
+        free(serial);
+        hid_free_enumeration(device);
+    }
+
+    return (result < 0)? HOTPLUG_MONITOR_FAILED : OK;
+}
+
+int stopHotplugMonitor(uintptr_t* hotplugContextPtr)
+{
+    HotplugContext_t *hotplugContext = NULL;
+
+    if (!hotplugContextPtr) {
+        return OK;
+    }
+
+    hotplugContext = (HotplugContext_t*)(*hotplugContextPtr);
+    if (hotplugContext) {
+        hid_hotplug_monitor_free(hotplugContext->monitor);
+        free(hotplugContext);
+    }
+
+    *hotplugContextPtr = 0;
+
+    return OK;
+}
+
+/* The values the device acknowledged become the cached ones, a rejected request leaves them unknown */
+static void _storeAcquisitionParameters(int errorCode, uint16_t numOfScans, uint16_t numOfBlankScans, uint8_t scanMode,
+                                        uint32_t timeOfExposure, DeviceContext_t* deviceContext)
+{
+    if (errorCode) {
+        deviceContext->parameters.knownParameters &= ~(KNOWN_ACQUISITION_PARAMETERS | KNOWN_EXPOSURE);
+        return;
+    }
+
+    deviceContext->parameters.numOfScans = numOfScans;
+    deviceContext->parameters.numOfBlankScans = numOfBlankScans;
+    deviceContext->parameters.scanMode = scanMode;
+    deviceContext->parameters.timeOfExposure = timeOfExposure;
+    deviceContext->parameters.knownParameters |= KNOWN_ACQUISITION_PARAMETERS | KNOWN_EXPOSURE;
+}
+
+/* A one time trigger disarms itself on the device, so it is left unknown */
+static void _storeExternalTrigger(int errorCode, uint8_t enableMode, uint8_t signalFrontMode, DeviceContext_t* deviceContext)
+{
+    if (errorCode || enableMode == ONE_TIME_TRIGGER) {
+        deviceContext->parameters.knownParameters &= ~KNOWN_EXTERNAL_TRIGGER;
+        return;
+    }
+
+    deviceContext->parameters.triggerEnableMode = enableMode;
+    deviceContext->parameters.triggerFront = signalFrontMode;
+    deviceContext->parameters.knownParameters |= KNOWN_EXTERNAL_TRIGGER;
+}
+
+/* reply is the SET_FRAME_FORMAT reply, it carries the new frame size */
+static void _storeFrameFormat(int errorCode, uint16_t numOfStartElement, uint16_t numOfEndElement, uint8_t reductionMode,
+                              const unsigned char* const reply, DeviceContext_t* deviceContext)
+{
+    if (errorCode) {
+        deviceContext->parameters.knownParameters &= ~KNOWN_FRAME_FORMAT;
+        return;
+    }
+
+    deviceContext->numOfPixelsInFrame = (reply[3] << 8) | reply[2];
+
+    deviceContext->parameters.numOfStartElement = numOfStartElement;
+    deviceContext->parameters.numOfEndElement = numOfEndElement;
+    deviceContext->parameters.reductionMode = reductionMode;
+    deviceContext->parameters.knownParameters |= KNOWN_FRAME_FORMAT;
+}
+
+static void _storeExposure(int errorCode, uint32_t timeOfExposure, DeviceContext_t* deviceContext)
+{
+    if (errorCode) {
+        deviceContext->parameters.knownParameters &= ~KNOWN_EXPOSURE;
+        return;
+    }
+
+    deviceContext->parameters.timeOfExposure = timeOfExposure;
+    deviceContext->parameters.knownParameters |= KNOWN_EXPOSURE;
+}
+
+/* The one time modes disarm themselves on the device, so they are left unknown */
+static void _storeOpticalTrigger(int errorCode, uint8_t enableMode, uint16_t pixel, uint16_t threshold, DeviceContext_t* deviceContext)
+{
+    if (errorCode || enableMode == ONE_TIME_TRIGGER_FOR_RISING_EDGE || enableMode == ONE_TIME_TRIGGER_FOR_FALLING_EDGE) {
+        deviceContext->parameters.knownParameters &= ~KNOWN_OPTICAL_TRIGGER;
+        return;
+    }
+
+    deviceContext->parameters.opticalTriggerMode = enableMode;
+    deviceContext->parameters.opticalTriggerPixel = pixel;
+    deviceContext->parameters.opticalTriggerThreshold = threshold;
+    deviceContext->parameters.knownParameters |= KNOWN_OPTICAL_TRIGGER;
+}
+
+static bool _hasExposure(uint32_t timeOfExposure, const DeviceContext_t* deviceContext)
+{
+    return (deviceContext->parameters.knownParameters & KNOWN_EXPOSURE) && deviceContext->parameters.timeOfExposure == timeOfExposure;
+}
+
+/* A one time trigger is never cached, so each request arms it again */
+static bool _hasExternalTrigger(uint8_t enableMode, uint8_t signalFrontMode, const DeviceContext_t* deviceContext)
+{
+    return (deviceContext->parameters.knownParameters & KNOWN_EXTERNAL_TRIGGER) &&
+           deviceContext->parameters.triggerEnableMode == enableMode && deviceContext->parameters.triggerFront == signalFrontMode;
+}
+
+static bool _hasOpticalTrigger(uint8_t enableMode, uint16_t pixel, uint16_t threshold, const DeviceContext_t* deviceContext)
+{
+    return (deviceContext->parameters.knownParameters & KNOWN_OPTICAL_TRIGGER) && deviceContext->parameters.opticalTriggerMode == enableMode &&
+           deviceContext->parameters.opticalTriggerPixel == pixel && deviceContext->parameters.opticalTriggerThreshold == threshold;
+}
+
+static void _forgetParameters(DeviceContext_t* deviceContext)
+{
+    deviceContext->parameters.knownParameters = 0;
+    deviceContext->numOfPixelsInFrame = 0;
+    deviceContext->triggerTime = 0;
+}
+
 /**
 \details {
     sends:
@@ -257,26 +674,19 @@ int setFrameFormat(uint16_t numOfStartElement, uint16_t numOfEndElement, uint8_t
 
     deviceContext = (DeviceContext_t*)(*deviceContextPtr);
 
-    report[0] = ZERO_REPORT_ID;
-    report[1] = SET_FRAME_FORMAT_REQUEST;
-    report[2] = LOW_BYTE(numOfStartElement);
-    report[3] = HIGH_BYTE(numOfStartElement);
-    report[4] = LOW_BYTE(numOfEndElement);
-    report[5] = HIGH_BYTE(numOfEndElement);
-    report[6] = reductionMode;
+    _fillSetFrameFormatRequest(report, numOfStartElement, numOfEndElement, reductionMode);
 
+    //always sent, the device clears its memory on a new frame format
     result = _writeReadFunction(report, CORRECT_SET_FRAME_FORMAT_REPLY, STANDARD_TIMEOUT_MILLISECONDS, deviceContextPtr);
     if (result != OK) {
+        deviceContext->parameters.knownParameters &= ~KNOWN_FRAME_FORMAT;
         return result;
     }
 
     errorCode = report[1];
-    if (!errorCode) {
-        deviceContext->numOfPixelsInFrame = (report[3] << 8) | report[2];
-
-        if (numOfPixelsInFrame) {
-            *numOfPixelsInFrame = deviceContext->numOfPixelsInFrame;
-        }
+    _storeFrameFormat(errorCode, numOfStartElement, numOfEndElement, reductionMode, report, deviceContext);
+    if (!errorCode && numOfPixelsInFrame) {
+        *numOfPixelsInFrame = deviceContext->numOfPixelsInFrame;
     }
 
     return errorCode;
@@ -303,25 +713,29 @@ int setExposure(uint32_t timeOfExposure, uint8_t force, uintptr_t* deviceContext
     unsigned char report[EXTENDED_PACKET_SIZE];
     int result = -1;
     int errorCode = -1;
+    DeviceContext_t *deviceContext = NULL;
 
     result = _verifyDeviceContextByPtr(deviceContextPtr);
     if (result != OK)
         return result;
 
-    report[0] = ZERO_REPORT_ID;
-    report[1] = SET_EXPOSURE_REQUEST;
-    report[2] = LOW_BYTE(LOW_WORD(timeOfExposure));           //(exposure >> 24) & 0xFF;
-    report[3] = HIGH_BYTE(LOW_WORD(timeOfExposure));          //(exposure >> 16) & 0xFF;
-    report[4] = LOW_BYTE(HIGH_WORD(timeOfExposure));          //(exposure >> 8)  & 0xFF;
-    report[5] = HIGH_BYTE(HIGH_WORD(timeOfExposure));         //exposure & 0xFF;
-    report[6] = force;
+    deviceContext = (DeviceContext_t*)(*deviceContextPtr);
+
+    //the exposure the device already has is only sent again when forced
+    if (!force && _hasExposure(timeOfExposure, deviceContext)) {
+        return OK;
+    }
+
+    _fillSetExposureRequest(report, timeOfExposure, force);
 
     result = _writeReadFunction(report, CORRECT_SET_EXPOSURE_REPLY, STANDARD_TIMEOUT_MILLISECONDS, deviceContextPtr);
     if (result != OK) {
+        deviceContext->parameters.knownParameters &= ~KNOWN_EXPOSURE;
         return result;
     }
 
     errorCode = report[1];
+    _storeExposure(errorCode, timeOfExposure, deviceContext);
     return errorCode;
 }
 
@@ -345,29 +759,25 @@ int setAcquisitionParameters(uint16_t numOfScans, uint16_t numOfBlankScans, uint
     uint8_t report[EXTENDED_PACKET_SIZE];
     int result = -1;
     int errorCode = -1;
+    DeviceContext_t *deviceContext = NULL;
 
     result = _verifyDeviceContextByPtr(deviceContextPtr);
     if (result != OK)
         return result;
 
-    report[0] = ZERO_REPORT_ID;
-    report[1] = SET_ACQUISITION_PARAMETERS_REQUEST;
-    report[2] = LOW_BYTE(numOfScans);
-    report[3] = HIGH_BYTE(numOfScans);
-    report[4] = LOW_BYTE(numOfBlankScans);
-    report[5] = HIGH_BYTE(numOfBlankScans);
-    report[6] = scanMode;
-    report[7] = LOW_BYTE(LOW_WORD(timeOfExposure));
-    report[8] = HIGH_BYTE(LOW_WORD(timeOfExposure));
-    report[9] = LOW_BYTE(HIGH_WORD(timeOfExposure));
-    report[10] = HIGH_BYTE(HIGH_WORD(timeOfExposure));
+    deviceContext = (DeviceContext_t*)(*deviceContextPtr);
 
+    _fillSetAcquisitionParametersRequest(report, SET_ACQUISITION_PARAMETERS_REQUEST, numOfScans, numOfBlankScans, scanMode, timeOfExposure, 0, 0);
+
+    //always sent, the device clears its memory on new acquisition parameters
     result = _writeReadFunction(report, CORRECT_SET_ACQUISITION_PARAMETERS_REPLY, STANDARD_TIMEOUT_MILLISECONDS, deviceContextPtr);
     if (result != OK) {
+        deviceContext->parameters.knownParameters &= ~(KNOWN_ACQUISITION_PARAMETERS | KNOWN_EXPOSURE);
         return result;
     }
 
     errorCode = report[1];
+    _storeAcquisitionParameters(errorCode, numOfScans, numOfBlankScans, scanMode, timeOfExposure, deviceContext);
     return errorCode;
 }
 
@@ -376,31 +786,27 @@ int setMultipleParameters(uint16_t numOfScans, uint16_t numOfBlankScans, uint8_t
     unsigned char report[EXTENDED_PACKET_SIZE];
     int result = -1;
     int errorCode = -1;
+    DeviceContext_t *deviceContext = NULL;
 
     result = _verifyDeviceContextByPtr(deviceContextPtr);
     if (result != OK)
         return result;
 
-    report[0] = ZERO_REPORT_ID;
-    report[1] = SET_ALL_PARAMETERS_REQUEST;
-    report[2] = LOW_BYTE(numOfScans);
-    report[3] = HIGH_BYTE(numOfScans);
-    report[4] = LOW_BYTE(numOfBlankScans);
-    report[5] = HIGH_BYTE(numOfBlankScans);
-    report[6] = scanMode;
-    report[7] = LOW_BYTE(LOW_WORD(timeOfExposure));
-    report[8] = HIGH_BYTE(LOW_WORD(timeOfExposure));
-    report[9] = LOW_BYTE(HIGH_WORD(timeOfExposure));
-    report[10] = HIGH_BYTE(HIGH_WORD(timeOfExposure));
-    report[11] = enableMode;
-    report[12] = signalFrontMode;
-
-    result = _writeReadFunction(report, CORRECT_GET_ACQUISITION_PARAMETERS_REPLY, STANDARD_TIMEOUT_MILLISECONDS, deviceContextPtr);
+    deviceContext = (DeviceContext_t*)(*deviceContextPtr);
+
+    _fillSetAcquisitionParametersRequest(report, SET_ALL_PARAMETERS_REQUEST, numOfScans, numOfBlankScans, scanMode, timeOfExposure,
+                                         enableMode, signalFrontMode);
+
+    //always sent, the device clears its memory on new acquisition parameters
+    result = _writeReadFunction(report, CORRECT_SET_ALL_PARAMETERS_REPLY, STANDARD_TIMEOUT_MILLISECONDS, deviceContextPtr);
     if (result != OK) {
+        deviceContext->parameters.knownParameters &= ~(KNOWN_ACQUISITION_PARAMETERS | KNOWN_EXPOSURE | KNOWN_EXTERNAL_TRIGGER);
         return result;
     }
 
     errorCode = report[1];
+    _storeAcquisitionParameters(errorCode, numOfScans, numOfBlankScans, scanMode, timeOfExposure, deviceContext);
+    _storeExternalTrigger(errorCode, enableMode, signalFrontMode, deviceContext);
     return errorCode;
 }
 
@@ -409,22 +815,28 @@ int setExternalTrigger(uint8_t /*EnableMode_t*/ enableMode, uint8_t /*TriggerFro
     unsigned char report[EXTENDED_PACKET_SIZE];
     int result = -1;
     int errorCode = -1;
+    DeviceContext_t *deviceContext = NULL;
 
     result = _verifyDeviceContextByPtr(deviceContextPtr);
     if (result != OK)
         return result;
 
-    report[0] = ZERO_REPORT_ID;
-    report[1] = SET_EXTERNAL_TRIGGER_REQUEST;
-    report[2] = enableMode;
-    report[3] = signalFrontMode;
+    deviceContext = (DeviceContext_t*)(*deviceContextPtr);
+
+    if (_hasExternalTrigger(enableMode, signalFrontMode, deviceContext)) {
+        return OK;
+    }
+
+    _fillSetExternalTriggerRequest(report, enableMode, signalFrontMode);
 
     result = _writeReadFunction(report, CORRECT_SET_EXTERNAL_TRIGGER_REPLY, STANDARD_TIMEOUT_MILLISECONDS, deviceContextPtr);
     if (result != OK) {
+        deviceContext->parameters.knownParameters &= ~KNOWN_EXTERNAL_TRIGGER;
         return result;
     }
 
     errorCode = report[1];
+    _storeExternalTrigger(errorCode, enableMode, signalFrontMode, deviceContext);
     return errorCode;
 }
 
@@ -445,25 +857,28 @@ int setOpticalTrigger(uint8_t /*OpticalTriggerMode_t*/ enableMode, uint16_t pixe
     uint8_t report[EXTENDED_PACKET_SIZE];
     int result = -1;
     int errorCode = -1;
+    DeviceContext_t *deviceContext = NULL;
 
     result = _verifyDeviceContextByPtr(deviceContextPtr);
     if (result != OK)
         return result;
 
-    report[0] = ZERO_REPORT_ID;
-    report[1] = SET_OPTICAl_TRIGGER_REQUEST;
-    report[2] = enableMode;
-    report[3] = LOW_BYTE(pixel);
-    report[4] = HIGH_BYTE(pixel);
-    report[5] = LOW_BYTE(threshold);
-    report[6] = HIGH_BYTE(threshold);
+    deviceContext = (DeviceContext_t*)(*deviceContextPtr);
+
+    if (_hasOpticalTrigger(enableMode, pixel, threshold, deviceContext)) {
+        return OK;
+    }
+
+    _fillSetOpticalTriggerRequest(report, enableMode, pixel, threshold);
 
     result = _writeReadFunction(report, CORRECT_SET_OPTICAL_TRIGGER_REPLY, STANDARD_TIMEOUT_MILLISECONDS, deviceContextPtr);
     if (result != OK) {
+        deviceContext->parameters.knownParameters &= ~KNOWN_OPTICAL_TRIGGER;
         return result;
     }
 
     errorCode = report[1];
+    _storeOpticalTrigger(errorCode, enableMode, pixel, threshold, deviceContext);
     return errorCode;
 }
 
@@ -480,6 +895,9 @@ int triggerAcquisition(uintptr_t* deviceContextPtr)
     report[1] = SET_SOFTWARE_TRIGGER_REQUEST;
 
     result = _writeOnlyFunction(report, deviceContextPtr);
+    if (result == OK) {
+        ((DeviceContext_t*)(*deviceContextPtr))->triggerTime = _transferClockNanoseconds();
+    }
     return result;
 }
 
@@ -525,37 +943,180 @@ int getStatus(uint8_t *statusFlags, uint16_t *framesInMemory, uintptr_t* deviceC
     return OK;
 }
 
-int getAcquisitionParameters(uint16_t* numOfScans, uint16_t* numOfBlankScans, uint8_t *scanMode, uint32_t* timeOfExposure, uintptr_t* deviceContextPtr)
+#define NANOSECONDS_IN_EXPOSURE_UNIT 10000LL      // timeOfExposure is a multiple of 10 us
+#define WAIT_WAKE_MARGIN_NANOSECONDS 500000LL     // the first poll goes out this long before the frames are due
+#define WAIT_FIRST_POLL_INTERVAL_NANOSECONDS 100000LL
+#define WAIT_MAX_POLL_INTERVAL_NANOSECONDS 2000000LL
+#define WAIT_NEVER (INT64_MAX / 2)
+
+static bool _sleepNanoseconds(int64_t nanoseconds, void* userData)
 {
-    uint8_t report[EXTENDED_PACKET_SIZE];
-    int result = -1;    
+#if defined(_WIN32)
+    Sleep((DWORD)((nanoseconds + 999999) / 1000000));
+#else
+    struct timespec ts;
+
+    ts.tv_sec = nanoseconds / 1000000000LL;
+    ts.tv_nsec = nanoseconds % 1000000000LL;
+    while (nanosleep(&ts, &ts) != 0 && errno == EINTR) {
+    }
+#endif
+    (void)userData;
+    return true;
+}
+
+/* Time the device needs for numOfSlots exposures, saturated at WAIT_NEVER */
+static int64_t _exposuresDuration(int64_t numOfSlots, uint32_t timeOfExposure)
+{
+    int64_t period = (int64_t)timeOfExposure * NANOSECONDS_IN_EXPOSURE_UNIT;
+
+    if (period && numOfSlots > WAIT_NEVER / period) {
+        return WAIT_NEVER;
+    }
+    return numOfSlots * period;
+}
+
+int _waitForFrames(uint16_t numOfFrames, uint32_t timeoutMilliseconds, uint8_t *statusFlags, uint16_t *framesInMemory,
+                   SleepFunction_t sleepFunction, void* sleepUserData, uintptr_t* deviceContextPtr)
+{
+    DeviceContext_t *deviceContext = NULL;
+    uint16_t numOfScans = 0, numOfBlankScans = 0;
+    uint8_t scanMode = 0;
+    uint32_t timeOfExposure = 0;
+    int64_t slotsPerFrame = 0;
+    int64_t now = 0, deadline = 0, dueTime = 0, delay = 0;
+    int64_t pollInterval = 0, maxPollInterval = 0;
+    uint8_t flags = 0;
+    uint16_t frames = 0;
+    int result = -1;
 
     result = _verifyDeviceContextByPtr(deviceContextPtr);
     if (result != OK)
         return result;
 
-    report[0] = ZERO_REPORT_ID;
-    report[1] = GET_ACQUISITION_PARAMETERS_REQUEST;
+    if (!numOfFrames) {
+        return INPUT_PARAMETER_NOT_INITIALIZED;
+    }
+
+    deviceContext = (DeviceContext_t*)(*deviceContextPtr);
 
-    result = _writeReadFunction(report, CORRECT_GET_ACQUISITION_PARAMETERS_REPLY, STANDARD_TIMEOUT_MILLISECONDS, deviceContextPtr);
+    result = getAcquisitionParameters(&numOfScans, &numOfBlankScans, &scanMode, &timeOfExposure, deviceContextPtr);
     if (result != OK) {
         return result;
     }
 
+    // in averaging mode a frame takes numOfScans exposures, otherwise one plus the blank ones
+    slotsPerFrame = (scanMode == FRAME_AVERAGING_MODE)? (numOfScans? numOfScans: 1) : (int64_t)numOfBlankScans + 1;
+
+    maxPollInterval = _exposuresDuration(1, timeOfExposure);
+    if (maxPollInterval > WAIT_MAX_POLL_INTERVAL_NANOSECONDS) {
+        maxPollInterval = WAIT_MAX_POLL_INTERVAL_NANOSECONDS;
+    }
+    if (maxPollInterval < WAIT_FIRST_POLL_INTERVAL_NANOSECONDS) {
+        maxPollInterval = WAIT_FIRST_POLL_INTERVAL_NANOSECONDS;
+    }
+
+    now = _transferClockNanoseconds();
+    deadline = now + (int64_t)timeoutMilliseconds * 1000000LL;
+
+    // frame k is stored (k - 1) frames plus one exposure after the trigger, or a whole averaged frame after it
+    if (deviceContext->triggerTime && scanMode != EVERY_FRAME_IDLE_MODE) {
+        dueTime = deviceContext->triggerTime +
+                  _exposuresDuration((numOfFrames - 1) * slotsPerFrame + ((scanMode == FRAME_AVERAGING_MODE)? slotsPerFrame: 1), timeOfExposure);
+    }
+
+    for (;;) {
+        if (dueTime - WAIT_WAKE_MARGIN_NANOSECONDS > now) {
+            delay = dueTime - WAIT_WAKE_MARGIN_NANOSECONDS - now;
+            pollInterval = WAIT_FIRST_POLL_INTERVAL_NANOSECONDS;
+        } else {
+            delay = pollInterval;
+            pollInterval = pollInterval? pollInterval * 2 : WAIT_FIRST_POLL_INTERVAL_NANOSECONDS;
+            if (pollInterval > maxPollInterval) {
+                pollInterval = maxPollInterval;
+            }
+        }
+
+        if (delay > deadline - now) {
+            delay = deadline - now;
+        }
+        if (delay > 0 && !sleepFunction(delay, sleepUserData)) {
+            return WAIT_FOR_FRAMES_TIMEOUT;
+        }
+
+        result = getStatus(&flags, &frames, deviceContextPtr);
+        if (result != OK) {
+            return result;
+        }
+
+        if (statusFlags) {
+            *statusFlags = flags;
+        }
+
+        if (framesInMemory) {
+            *framesInMemory = frames;
+        }
+
+        if (frames >= numOfFrames || (flags & STATUS_MEMORY_FULL)) {
+            return OK;
+        }
+
+        now = _transferClockNanoseconds();
+        if (now >= deadline) {
+            return WAIT_FOR_FRAMES_TIMEOUT;
+        }
+
+        // the next frame may be about to be stored, the ones after it take their whole exposures
+        dueTime = now + _exposuresDuration((numOfFrames - frames - 1) * slotsPerFrame, timeOfExposure);
+    }
+}
+
+int waitForFrames(uint16_t numOfFrames, uint32_t timeoutMilliseconds, uint8_t *statusFlags, uint16_t *framesInMemory,
+                  uintptr_t* deviceContextPtr)
+{
+    return _waitForFrames(numOfFrames, timeoutMilliseconds, statusFlags, framesInMemory, _sleepNanoseconds, NULL, deviceContextPtr);
+}
+
+int getAcquisitionParameters(uint16_t* numOfScans, uint16_t* numOfBlankScans, uint8_t *scanMode, uint32_t* timeOfExposure, uintptr_t* deviceContextPtr)
+{
+    uint8_t report[EXTENDED_PACKET_SIZE];
+    int result = -1;    
+    DeviceContext_t *deviceContext = NULL;
+
+    result = _verifyDeviceContextByPtr(deviceContextPtr);
+    if (result != OK)
+        return result;
+
+    deviceContext = (DeviceContext_t*)(*deviceContextPtr);
+
+    if ((deviceContext->parameters.knownParameters & (KNOWN_ACQUISITION_PARAMETERS | KNOWN_EXPOSURE)) !=
+        (KNOWN_ACQUISITION_PARAMETERS | KNOWN_EXPOSURE)) {
+        report[0] = ZERO_REPORT_ID;
+        report[1] = GET_ACQUISITION_PARAMETERS_REQUEST;
+
+        result = _writeReadFunction(report, CORRECT_GET_ACQUISITION_PARAMETERS_REPLY, STANDARD_TIMEOUT_MILLISECONDS, deviceContextPtr);
+        if (result != OK) {
+            return result;
+        }
+
+        _storeAcquisitionParameters(OK, (report[2] << 8) | report[1], (report[4] << 8) | report[3], report[5],
+                                    (report[9] << 24) | (report[8] << 16) | (report[7] << 8) | report[6], deviceContext);
+    }
+
     if (numOfScans) {
-        *numOfScans = (report[2] << 8) | report[1];
+        *numOfScans = deviceContext->parameters.numOfScans;
     }
 
     if (numOfBlankScans) {
-        *numOfBlankScans = (report[4] << 8) | report[3];
+        *numOfBlankScans = deviceContext->parameters.numOfBlankScans;
     }
 
     if (scanMode) {
-        *scanMode = report[5];
+        *scanMode = deviceContext->parameters.scanMode;
     }
 
     if (timeOfExposure) {
-        *timeOfExposure = (report[9] << 24) | (report[8] << 16) | (report[7] << 8) | report[6];
+        *timeOfExposure = deviceContext->parameters.timeOfExposure;
     }
 
     return OK;
@@ -587,28 +1148,34 @@ int getFrameFormat(uint16_t *numOfStartElement, uint16_t *numOfEndElement, uint8
 
     deviceContext = (DeviceContext_t*)(*deviceContextPtr);
 
-    report[0] = ZERO_REPORT_ID;
-    report[1] = GET_FRAME_FORMAT_REQUEST;
+    if (!(deviceContext->parameters.knownParameters & KNOWN_FRAME_FORMAT)) {
+        report[0] = ZERO_REPORT_ID;
+        report[1] = GET_FRAME_FORMAT_REQUEST;
 
-    result = _writeReadFunction(report, CORRECT_GET_FRAME_FORMAT_REPLY, STANDARD_TIMEOUT_MILLISECONDS, deviceContextPtr);
-    if (result != OK) {
-        return result;
+        result = _writeReadFunction(report, CORRECT_GET_FRAME_FORMAT_REPLY, STANDARD_TIMEOUT_MILLISECONDS, deviceContextPtr);
+        if (result != OK) {
+            return result;
+        }
+
+        deviceContext->parameters.numOfStartElement = (report[2] << 8) | report[1];
+        deviceContext->parameters.numOfEndElement = (report[4] << 8) | report[3];
+        deviceContext->parameters.reductionMode = report[5];
+        deviceContext->parameters.knownParameters |= KNOWN_FRAME_FORMAT;
+        deviceContext->numOfPixelsInFrame = (report[7] << 8) | report[6];
     }
 
     if (numOfStartElement) {
-        *numOfStartElement = (report[2] << 8) | report[1];
+        *numOfStartElement = deviceContext->parameters.numOfStartElement;
     }
 
     if (numOfEndElement) {
-        *numOfEndElement = (report[4] << 8) | report[3];
+        *numOfEndElement = deviceContext->parameters.numOfEndElement;
     }
 
     if (reductionMode) {
-        *reductionMode = report[5];
+        *reductionMode = deviceContext->parameters.reductionMode;
     }
 
-    deviceContext->numOfPixelsInFrame = (report[7] << 8) | report[6];
-
     if (numOfPixelsInFrame) {
         *numOfPixelsInFrame = deviceContext->numOfPixelsInFrame;
     }
@@ -639,20 +1206,519 @@ inReport[62]=LO(frame[offset+29]);
 inReport[63]=HI(frame[offset+29]);
 }
 */
+/* Reads the packets of one GET_FRAME reply and decodes the pixels numOfFirstPixel to endOfPixels - 1 into pixelsBuffer */
+static int _readFrameReply(uint16_t *pixelsBuffer, uint16_t numOfFirstPixel, uint16_t endOfPixels, uint8_t numOfPacketsToGet,
+                           bool firstOfReply, DeviceContext_t *deviceContext)
+{
+    uint8_t reports[MAX_PACKETS_IN_FRAME][PACKET_SIZE];
+    int numOfReportsRead = 0, reportIndex = 0;
+    int result = -1;
+    uint8_t numOfPacketsLeft = 0, numOfPacketsReceived = 0;
+
+    bool continueGetInReport = true;
+
+    while (continueGetInReport) {
+        /* Takes every packet of the burst that is already queued after a single wait */
+        numOfReportsRead = hid_read_many(deviceContext->handle, (unsigned char*)reports, PACKET_SIZE,
+                                         numOfPacketsToGet - numOfPacketsReceived, STANDARD_TIMEOUT_MILLISECONDS);
+        if (numOfReportsRead <= 0) {
+            return READING_PROCESS_FAILED;
+        }
+
+        _stampReplies(deviceContext, firstOfReply && numOfPacketsReceived == 0);
+
+        for (reportIndex = 0; reportIndex < numOfReportsRead; ++reportIndex) {
+            ++numOfPacketsReceived;
+
+            result = _parseGetFramePacket(reports[reportIndex], numOfPacketsToGet, numOfPacketsReceived,
+                                          numOfFirstPixel, endOfPixels, pixelsBuffer, &numOfPacketsLeft);
+            if (result != OK) {
+                return result;
+            }
+        }
+
+        continueGetInReport = (numOfPacketsLeft > 0)? true : false;
+    }
+
+    return OK;
+}
+
+#define MAX_FRAME_RETRANSMISSIONS 3   // rounds of requests for the packets still missing from a frame
+
+/* Reads the replies of the numOfRequests GET_FRAME requests sent back to back, request i for requestPackets[i] packets
+   from the pixel requestFirstPixels[i] on in ascending order, without stopping at a packet that is missing or out
+   of sequence: every packet is stored by its pixel offset and marked in packetsReceived, indexed from numOfFirstPixel.
+   The read ends with the last packet of the last request, or when the packets stop coming. *lossResult gets the error
+   a strict read of the requests one by one would have returned, the function itself only fails when the device
+   answers with an error. */
+static int _readFramePackets(uint16_t *pixelsBuffer, uint16_t numOfFirstPixel, uint16_t endOfPixels,
+                             const uint16_t *requestFirstPixels, const uint8_t *requestPackets, uint8_t numOfRequests,
+                             bool *packetsReceived, int *lossResult, bool firstOfReply, DeviceContext_t *deviceContext)
+{
+    uint8_t reports[MAX_PACKETS_IN_FRAME][PACKET_SIZE];
+    uint8_t requestPacketsReceived[MAX_PACKETS_IN_FRAME];
+    int numOfReportsRead = 0, reportIndex = 0;
+    int result = -1;
+    uint8_t numOfPacketsLeft = 0, requestIndex = 0;
+    uint16_t numOfPacketsToGet = 0, numOfPacketsReceived = 0, numOfPacketsToRead = 0;
+    uint16_t pixelOffset = 0;
+
+    *lossResult = OK;
+
+    for (requestIndex = 0; requestIndex < numOfRequests; ++requestIndex) {
+        requestPacketsReceived[requestIndex] = 0;
+        numOfPacketsToGet += requestPackets[requestIndex];
+    }
+    requestIndex = 0;
+
+    while (numOfPacketsReceived < numOfPacketsToGet) {
+        numOfPacketsToRead = numOfPacketsToGet - numOfPacketsReceived;
+        numOfReportsRead = hid_read_many(deviceContext->handle, (unsigned char*)reports, PACKET_SIZE,
+                                         (numOfPacketsToRead < MAX_PACKETS_IN_FRAME)? numOfPacketsToRead : MAX_PACKETS_IN_FRAME,
+                                         STANDARD_TIMEOUT_MILLISECONDS);
+        if (numOfReportsRead <= 0) {
+            *lossResult = READING_PROCESS_FAILED;
+            return OK;
+        }
+
+        _stampReplies(deviceContext, firstOfReply && !numOfPacketsReceived);
+
+        for (reportIndex = 0; reportIndex < numOfReportsRead; ++reportIndex) {
+            ++numOfPacketsReceived;
+
+            /* The sequence is checked within the request the packet answers, a packet off the pixels keeps the current one */
+            pixelOffset = (reports[reportIndex][2] << 8) | reports[reportIndex][1];
+            if (pixelOffset >= numOfFirstPixel && pixelOffset < endOfPixels) {
+                for (requestIndex = numOfRequests - 1; requestIndex && requestFirstPixels[requestIndex] > pixelOffset; --requestIndex) {
+                }
+            }
+            ++requestPacketsReceived[requestIndex];
+
+            result = _parseGetFramePacket(reports[reportIndex], requestPackets[requestIndex], requestPacketsReceived[requestIndex],
+                                          numOfFirstPixel, endOfPixels, pixelsBuffer, &numOfPacketsLeft);
+            if (result == WRONG_ANSWER || numOfPacketsLeft >= REMAINING_PACKETS_ERROR) {
+                return result;
+            }
+
+            if (result != OK && *lossResult == OK) {
+                *lossResult = result;
+            }
+
+            if (pixelOffset >= numOfFirstPixel && pixelOffset < endOfPixels) {
+                packetsReceived[(pixelOffset - numOfFirstPixel) / NUM_OF_PIXELS_IN_PACKET] = true;
+            }
+
+            if (!numOfPacketsLeft && pixelOffset >= requestFirstPixels[numOfRequests - 1]) {
+                if (numOfPacketsReceived < numOfPacketsToGet && *lossResult == OK) {
+                    *lossResult = GET_FRAME_REMAINING_PACKETS_ERROR;
+                }
+                return OK;
+            }
+        }
+    }
+
+    return OK;
+}
+
+static uint8_t _countMissingPackets(const bool *packetsReceived, uint8_t numOfPackets)
+{
+    uint8_t index = 0, numOfPacketsMissing = 0;
+
+    for (index = 0; index < numOfPackets; ++index) {
+        numOfPacketsMissing += packetsReceived[index]? 0 : 1;
+    }
+
+    return numOfPacketsMissing;
+}
+
+/* Drops the packets of the lost exchanges still queued, they must not be taken for the next reply */
+static void _drainFramePackets(DeviceContext_t *deviceContext)
+{
+    uint8_t reports[MAX_PACKETS_IN_FRAME][PACKET_SIZE];
+
+    /* A failed reconnect leaves no handle to drain */
+    if (!deviceContext->handle) {
+        return;
+    }
+
+    while (hid_read_many(deviceContext->handle, (unsigned char*)reports, PACKET_SIZE, MAX_PACKETS_IN_FRAME, 0) > 0) {
+    }
+}
+
+/* Reads the reply of the GET_FRAME request just sent for the pixels numOfFirstPixel to endOfPixels - 1 of numOfFrame.
+   Each reply packet carries its pixel offset, so the packets lost or late are requested again by their offsets
+   instead of failing the whole frame: a round sends one request per run of missing packets back to back,
+   then takes all the replies. LAST_FRAME is requested whole again while the device is still storing frames,
+   it may be a newer frame by then. */
+static int _readFrameRetransmitting(uint16_t *pixelsBuffer, uint16_t numOfFrame, uint16_t numOfFirstPixel, uint16_t endOfPixels,
+                                    uint8_t numOfPacketsToGet, uintptr_t* deviceContextPtr)
+{
+    DeviceContext_t *deviceContext = (DeviceContext_t*)(*deviceContextPtr);
+    uint8_t report[EXTENDED_PACKET_SIZE];
+    bool packetsReceived[MAX_PACKETS_IN_FRAME];
+    uint16_t requestFirstPixels[MAX_PACKETS_IN_FRAME];
+    uint8_t requestPackets[MAX_PACKETS_IN_FRAME];
+    int64_t requestTime = 0, firstReplyTime = 0;
+    int result = -1, lossResult = OK, firstLossResult = OK;
+    uint8_t retransmission = 0, firstMissing = 0, endOfMissing = 0;
+    uint8_t numOfPacketsMissing = 0, numOfRequests = 0;
+    uint8_t statusFlags = 0;
+    bool lastFrameChanging = (numOfFrame == LAST_FRAME);
+
+    memset(packetsReceived, 0, sizeof(packetsReceived));
+
+    requestFirstPixels[0] = numOfFirstPixel;
+    requestPackets[0] = numOfPacketsToGet;
+    result = _readFramePackets(pixelsBuffer, numOfFirstPixel, endOfPixels, requestFirstPixels, requestPackets, 1,
+                               packetsReceived, &lossResult, true, deviceContext);
+    if (result != OK || lossResult == OK) {
+        if (result != OK) {
+            _drainFramePackets(deviceContext);
+        }
+        return result;
+    }
+
+    firstLossResult = lossResult;
+    requestTime = deviceContext->timestamps.requestTime;
+    firstReplyTime = deviceContext->timestamps.firstReplyTime;
+    numOfPacketsMissing = _countMissingPackets(packetsReceived, numOfPacketsToGet);
+
+    /* The last frame stays the same once the device stores no more frames. A late packet of the request
+       must not be taken for the status reply, so the queue is drained first */
+    if (numOfFrame == LAST_FRAME) {
+        _drainFramePackets(deviceContext);
+    }
+    if (numOfFrame == LAST_FRAME && getStatus(&statusFlags, NULL, deviceContextPtr) == OK &&
+        (!(statusFlags & STATUS_ACQUISITION_ACTIVE) || (statusFlags & STATUS_MEMORY_FULL))) {
+        lastFrameChanging = false;
+    }
+
+    for (retransmission = 0; numOfPacketsMissing && retransmission < MAX_FRAME_RETRANSMISSIONS; ++retransmission) {
+        /* Otherwise it may have been replaced meanwhile, its packets are only kept from a single round */
+        if (lastFrameChanging) {
+            memset(packetsReceived, 0, sizeof(packetsReceived));
+            numOfPacketsMissing = numOfPacketsToGet;
+        }
+
+        numOfRequests = 0;
+        for (firstMissing = 0; firstMissing < numOfPacketsToGet; firstMissing = endOfMissing) {
+            if (packetsReceived[firstMissing]) {
+                endOfMissing = firstMissing + 1;
+                continue;
+            }
+
+            for (endOfMissing = firstMissing; endOfMissing < numOfPacketsToGet && !packetsReceived[endOfMissing]; ++endOfMissing) {
+            }
+
+            requestFirstPixels[numOfRequests] = numOfFirstPixel + firstMissing * NUM_OF_PIXELS_IN_PACKET;
+            requestPackets[numOfRequests] = endOfMissing - firstMissing;
+            _fillGetFrameRequest(report, requestFirstPixels[numOfRequests], numOfFrame, requestPackets[numOfRequests]);
+            ++numOfRequests;
+            result = _tryWrite(report, deviceContextPtr);
+            if (result != OK) {
+                _drainFramePackets(deviceContext);
+                return result;
+            }
+        }
+
+        result = _readFramePackets(pixelsBuffer, numOfFirstPixel, endOfPixels, requestFirstPixels, requestPackets, numOfRequests,
+                                   packetsReceived, &lossResult, false, deviceContext);
+        if (result != OK) {
+            _drainFramePackets(deviceContext);
+            return result;
+        }
+
+        numOfPacketsMissing = _countMissingPackets(packetsReceived, numOfPacketsToGet);
+    }
+
+    _drainFramePackets(deviceContext);
+
+    deviceContext->timestamps.requestTime = requestTime;
+    deviceContext->timestamps.firstReplyTime = firstReplyTime;
+
+    return numOfPacketsMissing? firstLossResult : OK;
+}
+
+/* Makes sure the frame size is known and returns the number of packets of a frame, or 0 with *result set */
+static uint8_t _packetsInFrame(int *result, uintptr_t* deviceContextPtr)
+{
+    DeviceContext_t *deviceContext = (DeviceContext_t*)(*deviceContextPtr);
+    uint16_t numOfPacketsToGet = 0;
+
+    *result = OK;
+    if (!deviceContext->numOfPixelsInFrame) {
+        *result = getFrameFormat(NULL, NULL, NULL, NULL, deviceContextPtr);
+        if (*result != OK)
+            return 0;
+    }
+
+    numOfPacketsToGet = (deviceContext->numOfPixelsInFrame) / NUM_OF_PIXELS_IN_PACKET;
+    numOfPacketsToGet += (deviceContext->numOfPixelsInFrame % NUM_OF_PIXELS_IN_PACKET)? 1 : 0;
+
+    if (numOfPacketsToGet > MAX_PACKETS_IN_FRAME) {
+        *result = NUM_OF_PACKETS_IN_FRAME_ERROR;
+        return 0;
+    }
+
+    return (uint8_t)numOfPacketsToGet;
+}
+
 int getFrame(uint16_t *framePixelsBuffer, uint16_t numOfFrame, uintptr_t* deviceContextPtr)
 {    
     uint8_t report[EXTENDED_PACKET_SIZE];
     int result = -1;
 
-    /* Total frame request parameters: */
-    uint16_t pixelOffset = 0;
-    uint8_t numOfPacketsToGet = 0, numOfPacketsLeft = 0, numOfPacketsReceived = 0;
+    /* Total frame request parameters: */
+    uint8_t numOfPacketsToGet = 0;
+
+    DeviceContext_t *deviceContext = NULL;
+
+    result = _verifyDeviceContextByPtr(deviceContextPtr);
+    if (result != OK)
+        return result;
+
+    deviceContext = (DeviceContext_t*)(*deviceContextPtr);
+
+    if (!deviceContext->handle) {
+        result = _reconnect(deviceContextPtr);
+        if (result != OK) {
+            return result;
+        }
+    }        
+
+    if (!framePixelsBuffer) {
+        return INPUT_PARAMETER_NOT_INITIALIZED;
+    }
+
+    numOfPacketsToGet = _packetsInFrame(&result, deviceContextPtr);
+    if (result != OK) {
+        return result;
+    }
+
+    _fillGetFrameRequest(report, 0, numOfFrame, numOfPacketsToGet);
+
+    result = _tryWrite(report, deviceContextPtr);
+    if (result != OK) {
+        return result;
+    }
+
+    return _readFrameRetransmitting(framePixelsBuffer, numOfFrame, 0, deviceContext->numOfPixelsInFrame, numOfPacketsToGet, deviceContextPtr);
+}
+
+int getFrameRegion(uint16_t *pixelsBuffer, uint16_t numOfFrame, uint16_t numOfFirstPixel, uint16_t numOfPixels, uintptr_t* deviceContextPtr)
+{
+    uint8_t report[EXTENDED_PACKET_SIZE];
+    int result = -1;
+    uint8_t numOfPacketsToGet = 0;
+
+    DeviceContext_t *deviceContext = NULL;
+
+    result = _verifyDeviceContextByPtr(deviceContextPtr);
+    if (result != OK)
+        return result;
+
+    deviceContext = (DeviceContext_t*)(*deviceContextPtr);
+
+    if (!deviceContext->handle) {
+        result = _reconnect(deviceContextPtr);
+        if (result != OK) {
+            return result;
+        }
+    }
+
+    if (!pixelsBuffer) {
+        return INPUT_PARAMETER_NOT_INITIALIZED;
+    }
+
+    /* Checks the frame size as well */
+    _packetsInFrame(&result, deviceContextPtr);
+    if (result != OK) {
+        return result;
+    }
+
+    if (!numOfPixels) {
+        return INPUT_PARAMETER_NOT_INITIALIZED;
+    }
+
+    if ((uint32_t)numOfFirstPixel + numOfPixels > deviceContext->numOfPixelsInFrame) {
+        return FRAME_REGION_OUT_OF_RANGE;
+    }
+
+    /* The device starts the first packet at the requested pixel, only the packets covering the region are sent */
+    numOfPacketsToGet = (uint8_t)((numOfPixels + NUM_OF_PIXELS_IN_PACKET - 1) / NUM_OF_PIXELS_IN_PACKET);
+
+    _fillGetFrameRequest(report, numOfFirstPixel, numOfFrame, numOfPacketsToGet);
+
+    result = _tryWrite(report, deviceContextPtr);
+    if (result != OK) {
+        return result;
+    }
+
+    return _readFrameRetransmitting(pixelsBuffer, numOfFrame, numOfFirstPixel, (uint16_t)(numOfFirstPixel + numOfPixels), numOfPacketsToGet,
+                                    deviceContextPtr);
+}
+
+/* Number of packets carrying the pixels numOfFirstPixel to endOfPixels - 1 */
+static uint16_t _packetsInRange(uint16_t numOfFirstPixel, uint16_t endOfPixels)
+{
+    return (uint16_t)((endOfPixels - numOfFirstPixel + NUM_OF_PIXELS_IN_PACKET - 1) / NUM_OF_PIXELS_IN_PACKET);
+}
+
+/* Sorts the regions by first pixel and merges them into the pixel ranges of the GET_FRAME requests.
+   Two neighbours are merged when one request carries them in no more packets than two requests would. */
+static uint16_t _coalesceFrameRegions(const FrameRegion_t *regions, uint16_t numOfRegions,
+                                      uint16_t *requestFirstPixels, uint16_t *requestEndsOfPixels)
+{
+    uint16_t order[MAX_NUM_OF_FRAME_REGIONS];
+    uint16_t index = 0, position = 0, numOfRequests = 0;
+    uint16_t numOfFirstPixel = 0, endOfPixels = 0, requestPackets = 0;
+
+    for (index = 0; index < numOfRegions; ++index) {
+        for (position = index; position > 0 && regions[order[position - 1]].numOfFirstPixel > regions[index].numOfFirstPixel; --position) {
+            order[position] = order[position - 1];
+        }
+        order[position] = index;
+    }
+
+    for (index = 0; index < numOfRegions; ++index) {
+        numOfFirstPixel = regions[order[index]].numOfFirstPixel;
+        endOfPixels = numOfFirstPixel + regions[order[index]].numOfPixels;
+
+        if (numOfRequests) {
+            requestPackets = _packetsInRange(requestFirstPixels[numOfRequests - 1], requestEndsOfPixels[numOfRequests - 1]);
+            if (numOfFirstPixel <= requestEndsOfPixels[numOfRequests - 1] ||
+                _packetsInRange(requestFirstPixels[numOfRequests - 1], endOfPixels) <= requestPackets + _packetsInRange(numOfFirstPixel, endOfPixels)) {
+                if (endOfPixels > requestEndsOfPixels[numOfRequests - 1]) {
+                    requestEndsOfPixels[numOfRequests - 1] = endOfPixels;
+                }
+                continue;
+            }
+        }
+
+        requestFirstPixels[numOfRequests] = numOfFirstPixel;
+        requestEndsOfPixels[numOfRequests] = endOfPixels;
+        ++numOfRequests;
+    }
+
+    return numOfRequests;
+}
+
+/* Takes the replies left in flight by an interrupted pipeline, so that they don't look like the reply of the next request.
+   No more than the maxNumOfReplies outstanding reports are taken, and a device that keeps sending can't hold the caller
+   past a deadline allowing a millisecond per report (the interval of a full-speed interrupt endpoint). */
+static void _discardPendingReplies(uint32_t maxNumOfReplies, DeviceContext_t *deviceContext)
+{
+    uint8_t reports[MAX_PACKETS_IN_FRAME][PACKET_SIZE];
+    int64_t deadline = _transferClockNanoseconds() + (STANDARD_TIMEOUT_MILLISECONDS + (int64_t)maxNumOfReplies) * 1000000LL;
+    int64_t remainingMilliseconds = 0;
+    int numOfReportsRead = 0;
+
+    while (maxNumOfReplies) {
+        remainingMilliseconds = (deadline - _transferClockNanoseconds()) / 1000000LL;
+        if (remainingMilliseconds <= 0) {
+            break;
+        }
+
+        numOfReportsRead = hid_read_many(deviceContext->handle, (unsigned char*)reports, PACKET_SIZE,
+                                         (maxNumOfReplies < MAX_PACKETS_IN_FRAME)? maxNumOfReplies : MAX_PACKETS_IN_FRAME,
+                                         (remainingMilliseconds < STANDARD_TIMEOUT_MILLISECONDS)? (int)remainingMilliseconds : STANDARD_TIMEOUT_MILLISECONDS);
+        if (numOfReportsRead <= 0) {
+            break;
+        }
+
+        maxNumOfReplies -= ((uint32_t)numOfReportsRead < maxNumOfReplies)? (uint32_t)numOfReportsRead : maxNumOfReplies;
+    }
+}
+
+int getFrames(uint16_t *framesPixelsBuffer, uint16_t numOfFirstFrame, uint16_t numOfFrames, uintptr_t* deviceContextPtr)
+{
+    uint8_t report[EXTENDED_PACKET_SIZE];
+    int result = -1;
+    uint8_t numOfPacketsToGet = 0;
+    uint32_t frameIndex = 0;
+    int64_t requestTime = 0, firstReplyTime = 0;
+
+    DeviceContext_t *deviceContext = NULL;
+
+    result = _verifyDeviceContextByPtr(deviceContextPtr);
+    if (result != OK)
+        return result;
+
+    deviceContext = (DeviceContext_t*)(*deviceContextPtr);
+
+    if (!deviceContext->handle) {
+        result = _reconnect(deviceContextPtr);
+        if (result != OK) {
+            return result;
+        }
+    }
+
+    if (!framesPixelsBuffer) {
+        return INPUT_PARAMETER_NOT_INITIALIZED;
+    }
+
+    if (!numOfFrames || (uint32_t)numOfFirstFrame + numOfFrames > UINT16_MAX) {
+        return INPUT_PARAMETER_NOT_INITIALIZED;
+    }
+
+    numOfPacketsToGet = _packetsInFrame(&result, deviceContextPtr);
+    if (result != OK) {
+        return result;
+    }
+
+    _fillGetFrameRequest(report, 0, numOfFirstFrame, numOfPacketsToGet);
+    result = _tryWrite(report, deviceContextPtr);
+    if (result != OK) {
+        return result;
+    }
+    requestTime = deviceContext->timestamps.requestTime;
+
+    for (frameIndex = 0; frameIndex < numOfFrames; ++frameIndex) {
+        /* The request of the next frame waits in the device while the packets of this one arrive,
+           so the device starts sending it right after the last packet instead of a round trip later */
+        if (frameIndex + 1 < numOfFrames) {
+            _fillGetFrameRequest(report, 0, (uint16_t)(numOfFirstFrame + frameIndex + 1), numOfPacketsToGet);
+            result = _tryWrite(report, deviceContextPtr);
+            if (result != OK) {
+                break;
+            }
+        }
+
+        result = _readFrameReply(framesPixelsBuffer + frameIndex * deviceContext->numOfPixelsInFrame,
+                                 0, deviceContext->numOfPixelsInFrame, numOfPacketsToGet, true, deviceContext);
+        if (result != OK) {
+            break;
+        }
+
+        if (frameIndex == 0) {
+            firstReplyTime = deviceContext->timestamps.firstReplyTime;
+        }
+    }
+
+    if (result != OK) {
+        /* The rest of this reply and the reply of the next request */
+        _discardPendingReplies(2 * numOfPacketsToGet, deviceContext);
+        return result;
+    }
+
+    /* The times cover the whole batch, from the first request to the last packet */
+    deviceContext->timestamps.requestTime = requestTime;
+    deviceContext->timestamps.firstReplyTime = firstReplyTime;
 
-    bool continueGetInReport = true;
-    uint16_t totalNumOfReceivedPixels = 0;
+    return OK;
+}
 
-    uint8_t indexOfPixelInPacket = 0;
-    int indexInPacket = 0;
+int getFrameRegions(uint16_t *pixelsBuffer, uint32_t *regionOffsets, uint16_t numOfFrame,
+                    const FrameRegion_t *regions, uint16_t numOfRegions, uintptr_t* deviceContextPtr)
+{
+    uint8_t report[EXTENDED_PACKET_SIZE];
+    uint16_t requestPixels[MAX_PACKETS_IN_FRAME * NUM_OF_PIXELS_IN_PACKET];
+    uint16_t requestFirstPixels[MAX_NUM_OF_FRAME_REGIONS], requestEndsOfPixels[MAX_NUM_OF_FRAME_REGIONS];
+    uint32_t offsets[MAX_NUM_OF_FRAME_REGIONS];
+    uint16_t numOfRequests = 0, requestIndex = 0, regionIndex = 0;
+    uint32_t numOfPixels = 0;
+    int result = -1;
+    int64_t requestTime = 0, firstReplyTime = 0;
 
     DeviceContext_t *deviceContext = NULL;
 
@@ -667,77 +1733,86 @@ int getFrame(uint16_t *framePixelsBuffer, uint16_t numOfFrame, uintptr_t* device
         if (result != OK) {
             return result;
         }
-    }        
+    }
 
-    if (!framePixelsBuffer) {
+    if (!pixelsBuffer || !regions || !numOfRegions || numOfRegions > MAX_NUM_OF_FRAME_REGIONS) {
         return INPUT_PARAMETER_NOT_INITIALIZED;
     }
 
-    if (!deviceContext->numOfPixelsInFrame) {
-        result = getFrameFormat(NULL, NULL, NULL, NULL, deviceContextPtr);
-        if (result != OK)
-            return result;
+    /* Checks the frame size as well */
+    _packetsInFrame(&result, deviceContextPtr);
+    if (result != OK) {
+        return result;
     }
 
-    numOfPacketsToGet = (deviceContext->numOfPixelsInFrame) / NUM_OF_PIXELS_IN_PACKET;
-    numOfPacketsToGet += (deviceContext->numOfPixelsInFrame % NUM_OF_PIXELS_IN_PACKET)? 1 : 0;
-
-    if (numOfPacketsToGet > MAX_PACKETS_IN_FRAME) {
-        return NUM_OF_PACKETS_IN_FRAME_ERROR;
+    for (regionIndex = 0; regionIndex < numOfRegions; ++regionIndex) {
+        if (!regions[regionIndex].numOfPixels) {
+            return INPUT_PARAMETER_NOT_INITIALIZED;
+        }
+        if ((uint32_t)regions[regionIndex].numOfFirstPixel + regions[regionIndex].numOfPixels > deviceContext->numOfPixelsInFrame) {
+            return FRAME_REGION_OUT_OF_RANGE;
+        }
+        offsets[regionIndex] = numOfPixels;
+        numOfPixels += regions[regionIndex].numOfPixels;
     }
 
-    report[0] = ZERO_REPORT_ID;
-    report[1] = GET_FRAME_REQUEST;
-    report[2] = LOW_BYTE(pixelOffset);
-    report[3] = HIGH_BYTE(pixelOffset);
-    report[4] = LOW_BYTE(numOfFrame);
-    report[5] = HIGH_BYTE(numOfFrame);
-    report[6] = numOfPacketsToGet;
+    numOfRequests = _coalesceFrameRegions(regions, numOfRegions, requestFirstPixels, requestEndsOfPixels);
 
+    _fillGetFrameRequest(report, requestFirstPixels[0], numOfFrame, (uint8_t)_packetsInRange(requestFirstPixels[0], requestEndsOfPixels[0]));
     result = _tryWrite(report, deviceContextPtr);
     if (result != OK) {
         return result;
     }
-    continueGetInReport = true;
-    while (continueGetInReport) {
-        result = hid_read_timeout(deviceContext->handle, report, EXTENDED_PACKET_SIZE, STANDARD_TIMEOUT_MILLISECONDS);
-        if (result != HID_OPERATION_READ_SUCCESS){
-            return READING_PROCESS_FAILED;
+    deviceContext = (DeviceContext_t*)(*deviceContextPtr);
+    requestTime = deviceContext->timestamps.requestTime;
+
+    for (requestIndex = 0; requestIndex < numOfRequests; ++requestIndex) {
+        /* Same pipelining as getFrames(): the next request waits in the device during this reply */
+        if (requestIndex + 1 < numOfRequests) {
+            _fillGetFrameRequest(report, requestFirstPixels[requestIndex + 1], numOfFrame,
+                                 (uint8_t)_packetsInRange(requestFirstPixels[requestIndex + 1], requestEndsOfPixels[requestIndex + 1]));
+            result = _tryWrite(report, deviceContextPtr);
+            if (result != OK) {
+                break;
+            }
         }
 
-        if (report[0] != CORRECT_GET_FRAME_REPLY) {
-            return WRONG_ANSWER;
+        result = _readFrameReply(requestPixels, requestFirstPixels[requestIndex], requestEndsOfPixels[requestIndex],
+                                 (uint8_t)_packetsInRange(requestFirstPixels[requestIndex], requestEndsOfPixels[requestIndex]),
+                                 true, deviceContext);
+        if (result != OK) {
+            break;
         }
 
-        ++numOfPacketsReceived;
-
-        numOfPacketsLeft = report[3];
-        if (numOfPacketsLeft >= REMAINING_PACKETS_ERROR ||
-            (numOfPacketsLeft != numOfPacketsToGet - numOfPacketsReceived)) {
-            return GET_FRAME_REMAINING_PACKETS_ERROR;
+        if (requestIndex == 0) {
+            firstReplyTime = deviceContext->timestamps.firstReplyTime;
         }
 
-        if (numOfPacketsLeft != numOfPacketsToGet - numOfPacketsReceived) {
-            return GET_FRAME_REMAINING_PACKETS_ERROR;
+        /* Every region lies within the one request it was merged into */
+        for (regionIndex = 0; regionIndex < numOfRegions; ++regionIndex) {
+            if (regions[regionIndex].numOfFirstPixel >= requestFirstPixels[requestIndex] &&
+                regions[regionIndex].numOfFirstPixel < requestEndsOfPixels[requestIndex]) {
+                memcpy(pixelsBuffer + offsets[regionIndex], requestPixels + (regions[regionIndex].numOfFirstPixel - requestFirstPixels[requestIndex]),
+                       regions[regionIndex].numOfPixels * sizeof(uint16_t));
+            }
         }
+    }
 
-        continueGetInReport = (numOfPacketsLeft > 0)? true : false;
-
-        pixelOffset = (report[2] << 8) | report[1];
-
-        indexInPacket = 4;
-        indexOfPixelInPacket = 0;
-
-        while ((totalNumOfReceivedPixels < deviceContext->numOfPixelsInFrame) && (indexOfPixelInPacket < NUM_OF_PIXELS_IN_PACKET)) {
-            uint16_t pixel = (report[indexInPacket + 1] << 8) | report[indexInPacket];
-            framePixelsBuffer[pixelOffset + indexOfPixelInPacket] = pixel;
+    if (result != OK) {
+        _discardPendingReplies(_packetsInRange(requestFirstPixels[requestIndex], requestEndsOfPixels[requestIndex]) +
+                               ((requestIndex + 1 < numOfRequests)?
+                                _packetsInRange(requestFirstPixels[requestIndex + 1], requestEndsOfPixels[requestIndex + 1]) : 0),
+                               deviceContext);
+        return result;
+    }
 
-            indexInPacket += 2;
-            ++indexOfPixelInPacket;
-            ++totalNumOfReceivedPixels;
-        }
+    if (regionOffsets) {
+        memcpy(regionOffsets, offsets, numOfRegions * sizeof(uint32_t));
     }
 
+    deviceContext->timestamps.requestTime = requestTime;
+    deviceContext->timestamps.firstReplyTime = firstReplyTime;
+
     return OK;
 }
 
@@ -767,6 +1842,8 @@ int clearMemory(uintptr_t* deviceContextPtr)
         return result;
     }
 
+    ((DeviceContext_t*)(*deviceContextPtr))->triggerTime = 0;
+
     errorCode = report[1];
     return errorCode;
 }
@@ -818,23 +1895,100 @@ inReport[5] = flash[absoluteOffset + localOffset + 1];
 ..
 inReport[63] = flash[absoluteOffset + localOffset + 59];
 */
-int readFlash(uint8_t *buffer, uint32_t absoluteOffset, uint32_t bytesToRead, uintptr_t* deviceContextPtr)
+#define MAX_READ_FLASH_RETRIES 3   // attempts after one that brought no bytes
+
+/* Reads the numOfPacketsToGet packets of one READ_FLASH request, bytesToRead counts from the start of the chunk.
+   *bytesReceived gets the length of the part read without a gap, where a new request can take over.
+   *refused is set when the device answered with an error, which asking again won't change. */
+static int _readFlashChunk(uint8_t *buffer, uint32_t absoluteOffset, uint32_t bytesToRead, uint8_t numOfPacketsToGet,
+                           uint32_t *bytesReceived, bool *refused, uintptr_t* deviceContextPtr)
 {
+    uint8_t report[EXTENDED_PACKET_SIZE];
+    uint8_t reports[MAX_READ_FLASH_PACKETS][PACKET_SIZE];
+    int numOfReportsRead = 0, reportIndex = 0;
     int result = -1;
-    uint8_t report[EXTENDED_PACKET_SIZE];    
-
-    uint32_t numOfPacketsToGet = 0;
-    uint8_t numOfPacketsToGetCurrent = 0, numOfPacketsReceivedCurrent = 0, numOfPacketsLeftCurrent = 0;
+    uint8_t numOfPacketsReceived = 0, numOfPacketsLeft = 0;
+    int brokenResult = OK;
 
     bool continueGetInReport = true;
-    uint16_t localOffset = 0;
-    uint32_t totalNumOfReceivedBytes = 0;
 
-    uint8_t indexOfByteInPacket;
-    int indexInPacket;
+    DeviceContext_t *deviceContext = (DeviceContext_t*)(*deviceContextPtr);
+
+    *bytesReceived = 0;
+    *refused = false;
+
+    _fillReadFlashRequest(report, absoluteOffset, numOfPacketsToGet);
+
+    _stampRequest(deviceContext);
+    result = hid_write(deviceContext->handle, (const unsigned char*)report, EXTENDED_PACKET_SIZE);
+    if (result != HID_OPERATION_WRITE_SUCCESS) {
+        return WRITING_PROCESS_FAILED;
+    }
+
+    while (continueGetInReport) {
+        numOfReportsRead = hid_read_many(deviceContext->handle, (unsigned char*)reports, PACKET_SIZE,
+                                         (brokenResult == OK)? numOfPacketsToGet - numOfPacketsReceived : numOfPacketsLeft,
+                                         STANDARD_TIMEOUT_MILLISECONDS);
+        if (numOfReportsRead <= 0) {
+            return (brokenResult == OK)? READING_PROCESS_FAILED : brokenResult;
+        }
+
+        _stampReplies(deviceContext, numOfPacketsReceived == 0);
+
+        for (reportIndex = 0; reportIndex < numOfReportsRead; ++reportIndex) {
+            ++numOfPacketsReceived;
+
+            if (brokenResult != OK) {
+                /* Takes the rest of the broken reply, so that it isn't taken for the reply of the next request */
+                numOfPacketsLeft = reports[reportIndex][3];
+                if (numOfPacketsLeft >= REMAINING_PACKETS_ERROR) {
+                    return brokenResult;
+                }
+                continue;
+            }
+
+            result = _parseReadFlashPacket(reports[reportIndex], numOfPacketsToGet, numOfPacketsReceived,
+                                           bytesToRead, buffer, &numOfPacketsLeft);
+            if (result == WRONG_ANSWER || numOfPacketsLeft >= REMAINING_PACKETS_ERROR) {
+                *refused = (result != WRONG_ANSWER);
+                return result;
+            }
+
+            if (result != OK) {
+                brokenResult = result;
+                continue;
+            }
+
+            /* The packets come in the order of their offsets, all of them so far are in the buffer */
+            *bytesReceived = numOfPacketsReceived * READ_FLASH_PAYLOAD;
+            if (*bytesReceived > bytesToRead) {
+                *bytesReceived = bytesToRead;
+            }
+        }
+
+        continueGetInReport = (numOfPacketsLeft > 0)? true : false;
+    }
+
+    return brokenResult;
+}
+
+int readFlash(uint8_t *buffer, uint32_t absoluteOffset, uint32_t bytesToRead, uintptr_t* deviceContextPtr)
+{
+    return readFlashWithProgress(buffer, absoluteOffset, bytesToRead, NULL, NULL, deviceContextPtr);
+}
+
+int readFlashWithProgress(uint8_t *buffer, uint32_t absoluteOffset, uint32_t bytesToRead, FlashProgressCallback_t callback, void* userData,
+                          uintptr_t* deviceContextPtr)
+{
+    int result = -1;
 
-    uint32_t offsetIncrement = 0;
-    uint8_t payloadSize = PACKET_SIZE - 4;
+    uint32_t numOfPacketsToGet = 0;
+    uint8_t numOfPacketsToGetCurrent = 0;
+    uint8_t retry = 0;
+    bool refused = false;
+
+    uint32_t offsetIncrement = 0, bytesReceived = 0;
+    uint8_t payloadSize = READ_FLASH_PAYLOAD;
 
     DeviceContext_t *deviceContext = NULL;
 
@@ -855,62 +2009,37 @@ int readFlash(uint8_t *buffer, uint32_t absoluteOffset, uint32_t bytesToRead, ui
         }
     }
 
-    numOfPacketsToGet = bytesToRead / payloadSize;
-    numOfPacketsToGet += (bytesToRead % payloadSize)? 1 : 0;
-
-    while(numOfPacketsToGet) {
+    while (offsetIncrement < bytesToRead) {
+        numOfPacketsToGet = (bytesToRead - offsetIncrement) / payloadSize;
+        numOfPacketsToGet += ((bytesToRead - offsetIncrement) % payloadSize)? 1 : 0;
         numOfPacketsToGetCurrent = (numOfPacketsToGet > MAX_READ_FLASH_PACKETS)? MAX_READ_FLASH_PACKETS : numOfPacketsToGet;
 
-        report[0] = ZERO_REPORT_ID;
-        report[1] = READ_FLASH_REQUEST;
-        report[2] = LOW_BYTE(LOW_WORD(absoluteOffset + offsetIncrement));
-        report[3] = HIGH_BYTE(LOW_WORD(absoluteOffset + offsetIncrement));
-        report[4] = LOW_BYTE(HIGH_WORD(absoluteOffset + offsetIncrement));
-        report[5] = HIGH_BYTE(HIGH_WORD(absoluteOffset + offsetIncrement));
-        report[6] = numOfPacketsToGetCurrent;
+        result = _readFlashChunk(buffer + offsetIncrement, absoluteOffset + offsetIncrement, bytesToRead - offsetIncrement,
+                                 numOfPacketsToGetCurrent, &bytesReceived, &refused, deviceContextPtr);
 
-        result = hid_write(deviceContext->handle, (const unsigned char*)report, EXTENDED_PACKET_SIZE);
-        if (result != HID_OPERATION_WRITE_SUCCESS) {
-            return WRITING_PROCESS_FAILED;
+        /* A broken chunk is resumed from its first missing packet, what was received before it is kept */
+        offsetIncrement += bytesReceived;
+        if (bytesReceived && callback) {
+            callback(offsetIncrement, bytesToRead, userData);
         }
 
-        numOfPacketsReceivedCurrent = 0;
-        continueGetInReport = true;
-        while (continueGetInReport) {
-            result = hid_read_timeout(deviceContext->handle, report, EXTENDED_PACKET_SIZE, STANDARD_TIMEOUT_MILLISECONDS);
-            if (result != HID_OPERATION_READ_SUCCESS){
-                return READING_PROCESS_FAILED;
-            }
-
-            ++numOfPacketsReceivedCurrent;
-
-            if (report[0] != CORRECT_READ_FLASH_REPLY) {
-                return WRONG_ANSWER;
-            }
-
-            numOfPacketsLeftCurrent = report[3];
-
-            if (numOfPacketsLeftCurrent >= REMAINING_PACKETS_ERROR || (numOfPacketsLeftCurrent != numOfPacketsToGetCurrent - numOfPacketsReceivedCurrent)) {
-                return READ_FLASH_REMAINING_PACKETS_ERROR;
-            }
-            continueGetInReport = (numOfPacketsLeftCurrent > 0)? true : false;
-
-            localOffset = (report[2] << 8) | report[1];
+        if (result == OK) {
+            retry = 0;
+            continue;
+        }
 
-            indexInPacket = 4;
-            indexOfByteInPacket = 0;
+        if (result == WRITING_PROCESS_FAILED || refused) {
+            return result;
+        }
 
-            while ((totalNumOfReceivedBytes < bytesToRead) && (indexOfByteInPacket < payloadSize)) {
-                buffer[offsetIncrement + localOffset + indexOfByteInPacket++] = report[indexInPacket++];
-                ++totalNumOfReceivedBytes;
-            }
+        retry = bytesReceived? 0 : retry + 1;
+        if (retry > MAX_READ_FLASH_RETRIES) {
+            return result;
         }
 
-        if (numOfPacketsToGet > MAX_READ_FLASH_PACKETS) {
-            numOfPacketsToGet -= MAX_READ_FLASH_PACKETS;
-            offsetIncrement += MAX_READ_FLASH_PACKETS * payloadSize;
-        } else {
-            numOfPacketsToGet = 0;
+        /* Whatever else is queued can't be trusted to belong to the next request */
+        if (result == WRONG_ANSWER) {
+            _discardPendingReplies(numOfPacketsToGetCurrent, deviceContext);
         }
     }
 
@@ -1020,6 +2149,9 @@ int resetDevice(uintptr_t* deviceContextPtr)
     report[1] = RESET_REQUEST;
 
     result = _writeOnlyFunction(report, deviceContextPtr);
+
+    //every parameter goes back to its default, the frame size included
+    _forgetParameters((DeviceContext_t*)(*deviceContextPtr));
     return result;
 }
 
@@ -1036,5 +2168,306 @@ int detachDevice(uintptr_t* deviceContextPtr)
     report[1] = DETACH_REQUEST;
 
     result = _writeOnlyFunction(report, deviceContextPtr);
+
+    _forgetParameters((DeviceContext_t*)(*deviceContextPtr));
+    return result;
+}
+
+int setBusyPollWindow(uint32_t maxSpinMicroseconds, uintptr_t* deviceContextPtr)
+{
+    DeviceContext_t* deviceContext;
+    int result;
+
+    result = _verifyDeviceContextByPtr(deviceContextPtr);
+    if (result != OK)
+        return result;
+
+    if (maxSpinMicroseconds > INT_MAX)
+        maxSpinMicroseconds = INT_MAX;
+
+    deviceContext = (DeviceContext_t*)(*deviceContextPtr);
+    if (hid_set_busy_poll(deviceContext->handle, (int)maxSpinMicroseconds) != 0)
+        return OPERATION_NOT_SUPPORTED;
+
+    return OK;
+}
+
+int getLastTransferTimestamps(TransferTimestamps_t* timestamps, uintptr_t* deviceContextPtr)
+{
+    int result;
+
+    result = _verifyDeviceContextByPtr(deviceContextPtr);
+    if (result != OK)
+        return result;
+
+    if (!timestamps) {
+        return INPUT_PARAMETER_NOT_INITIALIZED;
+    }
+
+    *timestamps = ((DeviceContext_t*)(*deviceContextPtr))->timestamps;
+
+    return OK;
+}
+
+int invalidateParametersCache(uintptr_t* deviceContextPtr)
+{
+    int result;
+
+    result = _verifyDeviceContextByPtr(deviceContextPtr);
+    if (result != OK)
+        return result;
+
+    _forgetParameters((DeviceContext_t*)(*deviceContextPtr));
+
+    return OK;
+}
+
+int clearConfiguration(ConfigurationTransaction_t* transaction)
+{
+    if (!transaction) {
+        return INPUT_PARAMETER_NOT_INITIALIZED;
+    }
+
+    memset(transaction, 0, sizeof(ConfigurationTransaction_t));
+
+    return OK;
+}
+
+int configureFrameFormat(uint16_t numOfStartElement, uint16_t numOfEndElement, uint8_t reductionMode, ConfigurationTransaction_t* transaction)
+{
+    if (!transaction) {
+        return INPUT_PARAMETER_NOT_INITIALIZED;
+    }
+
+    transaction->numOfStartElement = numOfStartElement;
+    transaction->numOfEndElement = numOfEndElement;
+    transaction->reductionMode = reductionMode;
+    transaction->commands |= CONFIGURE_FRAME_FORMAT;
+
+    return OK;
+}
+
+int configureAcquisitionParameters(uint16_t numOfScans, uint16_t numOfBlankScans, uint8_t scanMode, uint32_t timeOfExposure, ConfigurationTransaction_t* transaction)
+{
+    if (!transaction) {
+        return INPUT_PARAMETER_NOT_INITIALIZED;
+    }
+
+    transaction->numOfScans = numOfScans;
+    transaction->numOfBlankScans = numOfBlankScans;
+    transaction->scanMode = scanMode;
+    transaction->acquisitionTimeOfExposure = timeOfExposure;
+    transaction->commands |= CONFIGURE_ACQUISITION_PARAMETERS;
+
+    return OK;
+}
+
+int configureExposure(uint32_t timeOfExposure, uint8_t force, ConfigurationTransaction_t* transaction)
+{
+    if (!transaction) {
+        return INPUT_PARAMETER_NOT_INITIALIZED;
+    }
+
+    transaction->timeOfExposure = timeOfExposure;
+    transaction->forceExposure = force;
+    transaction->commands |= CONFIGURE_EXPOSURE;
+
+    return OK;
+}
+
+int configureExternalTrigger(uint8_t enableMode, uint8_t signalFrontMode, ConfigurationTransaction_t* transaction)
+{
+    if (!transaction) {
+        return INPUT_PARAMETER_NOT_INITIALIZED;
+    }
+
+    transaction->triggerEnableMode = enableMode;
+    transaction->triggerFront = signalFrontMode;
+    transaction->commands |= CONFIGURE_EXTERNAL_TRIGGER;
+
+    return OK;
+}
+
+int configureOpticalTrigger(uint8_t enableMode, uint16_t pixel, uint16_t threshold, ConfigurationTransaction_t* transaction)
+{
+    if (!transaction) {
+        return INPUT_PARAMETER_NOT_INITIALIZED;
+    }
+
+    transaction->opticalTriggerMode = enableMode;
+    transaction->opticalTriggerPixel = pixel;
+    transaction->opticalTriggerThreshold = threshold;
+    transaction->commands |= CONFIGURE_OPTICAL_TRIGGER;
+
+    return OK;
+}
+
+#define MAX_CONFIGURATION_REQUESTS 5
+
+/* Stores the outcome of one request of the transaction, which covers the commands flagged in commands */
+static void _storeConfigurationResult(ConfigurationTransaction_t* transaction, uint8_t commands, int errorCode,
+                                      const unsigned char* const reply, DeviceContext_t* deviceContext)
+{
+    if (commands & CONFIGURE_FRAME_FORMAT) {
+        _storeFrameFormat(errorCode, transaction->numOfStartElement, transaction->numOfEndElement, transaction->reductionMode,
+                          reply, deviceContext);
+        if (!errorCode) {
+            transaction->numOfPixelsInFrame = deviceContext->numOfPixelsInFrame;
+        }
+        transaction->frameFormatResult = errorCode;
+    }
+
+    if (commands & CONFIGURE_ACQUISITION_PARAMETERS) {
+        _storeAcquisitionParameters(errorCode, transaction->numOfScans, transaction->numOfBlankScans, transaction->scanMode,
+                                    transaction->acquisitionTimeOfExposure, deviceContext);
+        transaction->acquisitionParametersResult = errorCode;
+    }
+
+    if (commands & CONFIGURE_EXPOSURE) {
+        _storeExposure(errorCode, transaction->timeOfExposure, deviceContext);
+        transaction->exposureResult = errorCode;
+    }
+
+    if (commands & CONFIGURE_EXTERNAL_TRIGGER) {
+        _storeExternalTrigger(errorCode, transaction->triggerEnableMode, transaction->triggerFront, deviceContext);
+        transaction->externalTriggerResult = errorCode;
+    }
+
+    if (commands & CONFIGURE_OPTICAL_TRIGGER) {
+        _storeOpticalTrigger(errorCode, transaction->opticalTriggerMode, transaction->opticalTriggerPixel,
+                             transaction->opticalTriggerThreshold, deviceContext);
+        transaction->opticalTriggerResult = errorCode;
+    }
+}
+
+int commitConfiguration(ConfigurationTransaction_t* transaction, uintptr_t* deviceContextPtr)
+{
+    uint8_t reports[MAX_CONFIGURATION_REQUESTS][EXTENDED_PACKET_SIZE];
+    uint8_t correctReplies[MAX_CONFIGURATION_REQUESTS];
+    uint8_t requestCommands[MAX_CONFIGURATION_REQUESTS];
+    int numOfRequests = 0, numOfRequestsWritten = 0, firstAnsweredRequest = 0, requestIndex = 0;
+    int result = -1, errorCode = OK, writeResult = OK, readResult = OK;
+    uint32_t numOfReconnections = 0;
+    int64_t requestTime = 0, firstReplyTime = 0;
+
+    DeviceContext_t *deviceContext = NULL;
+
+    result = _verifyDeviceContextByPtr(deviceContextPtr);
+    if (result != OK)
+        return result;
+
+    if (!transaction) {
+        return INPUT_PARAMETER_NOT_INITIALIZED;
+    }
+
+    deviceContext = (DeviceContext_t*)(*deviceContextPtr);
+
+    if (!deviceContext->handle) {
+        result = _reconnect(deviceContextPtr);
+        if (result != OK) {
+            return result;
+        }
+    }
+
+    transaction->frameFormatResult = OK;
+    transaction->acquisitionParametersResult = OK;
+    transaction->exposureResult = OK;
+    transaction->externalTriggerResult = OK;
+    transaction->opticalTriggerResult = OK;
+
+    if (transaction->commands & CONFIGURE_FRAME_FORMAT) {
+        _fillSetFrameFormatRequest(reports[numOfRequests], transaction->numOfStartElement, transaction->numOfEndElement, transaction->reductionMode);
+        correctReplies[numOfRequests] = CORRECT_SET_FRAME_FORMAT_REPLY;
+        requestCommands[numOfRequests++] = CONFIGURE_FRAME_FORMAT;
+    }
+
+    if (transaction->commands & CONFIGURE_ACQUISITION_PARAMETERS) {
+        if (transaction->commands & CONFIGURE_EXTERNAL_TRIGGER) {
+            _fillSetAcquisitionParametersRequest(reports[numOfRequests], SET_ALL_PARAMETERS_REQUEST, transaction->numOfScans,
+                                                 transaction->numOfBlankScans, transaction->scanMode, transaction->acquisitionTimeOfExposure,
+                                                 transaction->triggerEnableMode, transaction->triggerFront);
+            correctReplies[numOfRequests] = CORRECT_SET_ALL_PARAMETERS_REPLY;
+            requestCommands[numOfRequests++] = CONFIGURE_ACQUISITION_PARAMETERS | CONFIGURE_EXTERNAL_TRIGGER;
+        } else {
+            _fillSetAcquisitionParametersRequest(reports[numOfRequests], SET_ACQUISITION_PARAMETERS_REQUEST, transaction->numOfScans,
+                                                 transaction->numOfBlankScans, transaction->scanMode, transaction->acquisitionTimeOfExposure, 0, 0);
+            correctReplies[numOfRequests] = CORRECT_SET_ACQUISITION_PARAMETERS_REPLY;
+            requestCommands[numOfRequests++] = CONFIGURE_ACQUISITION_PARAMETERS;
+        }
+    }
+
+    //the acquisition parameters request above changes the exposure of the device before this one is considered
+    if ((transaction->commands & CONFIGURE_EXPOSURE) &&
+        (transaction->forceExposure || (transaction->commands & CONFIGURE_ACQUISITION_PARAMETERS) ||
+         !_hasExposure(transaction->timeOfExposure, deviceContext))) {
+        _fillSetExposureRequest(reports[numOfRequests], transaction->timeOfExposure, transaction->forceExposure);
+        correctReplies[numOfRequests] = CORRECT_SET_EXPOSURE_REPLY;
+        requestCommands[numOfRequests++] = CONFIGURE_EXPOSURE;
+    }
+
+    if ((transaction->commands & CONFIGURE_EXTERNAL_TRIGGER) && !(transaction->commands & CONFIGURE_ACQUISITION_PARAMETERS) &&
+        !_hasExternalTrigger(transaction->triggerEnableMode, transaction->triggerFront, deviceContext)) {
+        _fillSetExternalTriggerRequest(reports[numOfRequests], transaction->triggerEnableMode, transaction->triggerFront);
+        correctReplies[numOfRequests] = CORRECT_SET_EXTERNAL_TRIGGER_REPLY;
+        requestCommands[numOfRequests++] = CONFIGURE_EXTERNAL_TRIGGER;
+    }
+
+    if ((transaction->commands & CONFIGURE_OPTICAL_TRIGGER) &&
+        !_hasOpticalTrigger(transaction->opticalTriggerMode, transaction->opticalTriggerPixel, transaction->opticalTriggerThreshold, deviceContext)) {
+        _fillSetOpticalTriggerRequest(reports[numOfRequests], transaction->opticalTriggerMode, transaction->opticalTriggerPixel,
+                                      transaction->opticalTriggerThreshold);
+        correctReplies[numOfRequests] = CORRECT_SET_OPTICAL_TRIGGER_REPLY;
+        requestCommands[numOfRequests++] = CONFIGURE_OPTICAL_TRIGGER;
+    }
+
+    //the device queues the requests and answers them in order
+    numOfReconnections = deviceContext->numOfReconnections;
+    for (numOfRequestsWritten = 0; numOfRequestsWritten < numOfRequests; ++numOfRequestsWritten) {
+        writeResult = _tryWrite(reports[numOfRequestsWritten], deviceContextPtr);
+        //the replies of the requests written before a reconnection went away with the old handle
+        if (deviceContext->numOfReconnections != numOfReconnections) {
+            numOfReconnections = deviceContext->numOfReconnections;
+            firstAnsweredRequest = numOfRequestsWritten;
+        }
+        if (writeResult != OK) {
+            break;
+        }
+        if (numOfRequestsWritten == 0) {
+            requestTime = deviceContext->timestamps.requestTime;
+        }
+    }
+
+    result = OK;
+    for (requestIndex = 0; requestIndex < numOfRequests; ++requestIndex) {
+        if (requestIndex >= numOfRequestsWritten) {
+            errorCode = writeResult;
+        } else if (requestIndex < firstAnsweredRequest) {
+            errorCode = READING_PROCESS_FAILED;
+        } else if (readResult != OK) {
+            //a reply went missing, the ones after it can't be matched any more
+            errorCode = readResult;
+        } else {
+            readResult = _tryRead(reports[requestIndex], correctReplies[requestIndex], STANDARD_TIMEOUT_MILLISECONDS, deviceContextPtr);
+            errorCode = (readResult == OK)? reports[requestIndex][1] : readResult;
+            if (requestIndex == firstAnsweredRequest) {
+                firstReplyTime = deviceContext->timestamps.firstReplyTime;
+            }
+        }
+
+        _storeConfigurationResult(transaction, requestCommands[requestIndex], errorCode, reports[requestIndex], deviceContext);
+        if (result == OK) {
+            result = errorCode;
+        }
+    }
+
+    if (readResult != OK) {
+        _discardPendingReplies(numOfRequestsWritten - firstAnsweredRequest, deviceContext);
+    }
+
+    if (numOfRequestsWritten) {
+        deviceContext->timestamps.requestTime = requestTime;
+        deviceContext->timestamps.firstReplyTime = firstReplyTime;
+    }
+
     return result;
 }
@@ -0,0 +1,166 @@
+#include <stdlib.h>
+#include <limits.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/eventfd.h>
+
+#include "libspectrometer.h"
+#include "internal.h"
+
+/*
+ * Frames watch: a thread runs the wait of waitForFrames() and signals an eventfd when it is over,
+ * its sleeps wait on a second eventfd so that stopFramesWatch() can cancel them.
+ */
+
+typedef struct FramesWatch_t {
+    uintptr_t* deviceContextPtr;
+    uint16_t numOfFrames;
+    uint32_t timeoutMilliseconds;
+
+    int eventFileDescriptor;        // readable once the wait is over
+    int stopFileDescriptor;         // cancels the sleeps of the thread
+    pthread_t thread;
+
+    int result;
+    uint8_t statusFlags;
+    uint16_t framesInMemory;
+} FramesWatch_t;
+
+/* Waits on the stop descriptor for the whole milliseconds, the rest is too short to be worth cancelling */
+static bool _sleepUnlessStopped(int64_t nanoseconds, void* userData)
+{
+    FramesWatch_t* watch = (FramesWatch_t*)userData;
+    struct pollfd fds;
+    struct timespec ts;
+    int64_t milliseconds = nanoseconds / 1000000LL;
+    int result = 0;
+
+    if (milliseconds > INT_MAX) {
+        milliseconds = INT_MAX;
+    }
+
+    fds.fd = watch->stopFileDescriptor;
+    fds.events = POLLIN;
+    fds.revents = 0;
+
+    do {
+        result = poll(&fds, 1, (int)milliseconds);
+    } while (result < 0 && errno == EINTR);
+
+    if (result != 0) {
+        return false;
+    }
+
+    ts.tv_sec = 0;
+    ts.tv_nsec = nanoseconds % 1000000LL;
+    while (nanosleep(&ts, &ts) != 0 && errno == EINTR) {
+    }
+
+    return true;
+}
+
+static void* _framesWatchThread(void* argument)
+{
+    FramesWatch_t* watch = (FramesWatch_t*)argument;
+
+    watch->result = _waitForFrames(watch->numOfFrames, watch->timeoutMilliseconds, &watch->statusFlags, &watch->framesInMemory,
+                                   _sleepUnlessStopped, watch, watch->deviceContextPtr);
+
+    eventfd_write(watch->eventFileDescriptor, 1);
+    return NULL;
+}
+
+static void _freeFramesWatch(FramesWatch_t* watch)
+{
+    if (watch->eventFileDescriptor >= 0) {
+        close(watch->eventFileDescriptor);
+    }
+    if (watch->stopFileDescriptor >= 0) {
+        close(watch->stopFileDescriptor);
+    }
+    free(watch);
+}
+
+int startFramesWatch(uint16_t numOfFrames, uint32_t timeoutMilliseconds, uintptr_t* framesWatchPtr, uintptr_t* deviceContextPtr)
+{
+    FramesWatch_t* watch = NULL;
+    int result = _verifyDeviceContextByPtr(deviceContextPtr);
+
+    if (result != OK) {
+        return result;
+    }
+
+    if (!framesWatchPtr || !numOfFrames) {
+        return INPUT_PARAMETER_NOT_INITIALIZED;
+    }
+
+    stopFramesWatch(NULL, NULL, framesWatchPtr);
+
+    watch = calloc(1, sizeof(FramesWatch_t));
+    if (!watch) {
+        return FRAMES_WATCH_FAILED;
+    }
+
+    watch->deviceContextPtr = deviceContextPtr;
+    watch->numOfFrames = numOfFrames;
+    watch->timeoutMilliseconds = timeoutMilliseconds;
+    watch->result = WAIT_FOR_FRAMES_TIMEOUT;
+
+    watch->eventFileDescriptor = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    watch->stopFileDescriptor = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (watch->eventFileDescriptor < 0 || watch->stopFileDescriptor < 0 ||
+        pthread_create(&watch->thread, NULL, _framesWatchThread, watch) != 0) {
+        _freeFramesWatch(watch);
+        return FRAMES_WATCH_FAILED;
+    }
+
+    *framesWatchPtr = (uintptr_t)watch;
+
+    return OK;
+}
+
+int getFramesWatchFileDescriptor(int* fileDescriptor, uintptr_t* framesWatchPtr)
+{
+    if (!framesWatchPtr || !(*framesWatchPtr)) {
+        return NO_DEVICE_CONTEXT_ERROR;
+    }
+
+    if (!fileDescriptor) {
+        return INPUT_PARAMETER_NOT_INITIALIZED;
+    }
+
+    *fileDescriptor = ((FramesWatch_t*)(*framesWatchPtr))->eventFileDescriptor;
+
+    return OK;
+}
+
+int stopFramesWatch(uint8_t* statusFlags, uint16_t* framesInMemory, uintptr_t* framesWatchPtr)
+{
+    FramesWatch_t* watch = NULL;
+    int result = OK;
+
+    if (!framesWatchPtr || !(*framesWatchPtr)) {
+        return NO_DEVICE_CONTEXT_ERROR;
+    }
+
+    watch = (FramesWatch_t*)(*framesWatchPtr);
+
+    eventfd_write(watch->stopFileDescriptor, 1);
+    pthread_join(watch->thread, NULL);
+
+    result = watch->result;
+    if (statusFlags) {
+        *statusFlags = watch->statusFlags;
+    }
+    if (framesInMemory) {
+        *framesInMemory = watch->framesInMemory;
+    }
+
+    _freeFramesWatch(watch);
+    *framesWatchPtr = 0;
+
+    return result;
+}
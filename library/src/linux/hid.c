@@ -27,6 +27,7 @@
 #include <stdlib.h>
 #include <locale.h>
 #include <errno.h>
+#include <time.h>
 
 /* Unix */
 #include <unistd.h>
@@ -36,6 +37,7 @@
 #include <sys/utsname.h>
 #include <fcntl.h>
 #include <poll.h>
+#include <pthread.h>
 
 /* Linux */
 #include <linux/hidraw.h>
@@ -44,6 +46,11 @@
 #include <libudev.h>
 
 #include "hidapi.h"
+#include "virtual_device.h"
+#include "hid_uring.h"
+#include "hid_reader.h"
+#include "hid_libusb.h"
+#include "hid_usbfs.h"
 
 /* Definitions from linux/hidraw.h. Since these are new, some distros
    may not have header files which contain them. */
@@ -75,11 +82,60 @@ struct hid_device_ {
 	int device_handle;
 	int blocking;
 	int uses_numbered_reports;
+	int virtual_index; /* -1 for real hidraw devices */
+	struct hid_uring *uring; /* NULL when reports are read with poll() and read() */
+	struct hid_reader *reader; /* set when a thread drains the reports into a ring */
+	struct hid_libusb *libusb; /* set when the interface is claimed through libusb instead of hidraw */
+	struct hid_usbfs *usbfs; /* set when the interface is claimed through usbfs instead of hidraw */
+	char *claimed_path; /* hidraw path the device had before its interface was claimed */
+	char *path; /* of the open hidraw node, rebuilds its identity once the cache dropped it */
+	dev_t devnum; /* of the hidraw node, identifies it in the enumeration cache */
+
+	/* Spin-then-block reads, see hid_set_busy_poll() */
+	long long busy_poll_max_ns; /* 0 when reads block in poll() right away */
+	long long report_gap_ns; /* moving average of the gaps between the reports of a burst */
+	long long last_report_ns;
+
+	/* Arrival times of the reports of the last read, see hid_get_report_times() */
+	long long batch_first_ns;
+	long long report_time_ns;
 };
 
+/* The spin window covers this many average gaps */
+#define BUSY_POLL_GAP_FACTOR 2
+/* Weight of a new gap in the moving average: 1/2^shift */
+#define BUSY_POLL_GAP_SHIFT 3
+
 
 static __u32 kernel_version = 0;
 
+/* What opening and querying a hidraw node found out about it, so that reconnects and
+   string queries neither repeat the descriptor ioctls nor walk udev again. */
+struct device_identity {
+	dev_t devnum;
+	char *path;
+	int uses_numbered_reports; /* -1 until the report descriptor was read */
+	int strings_known;
+	wchar_t *strings[DEVICE_STRING_COUNT]; /* NULL for the strings the device doesn't have */
+	struct device_identity *next;
+};
+
+/* Process-wide snapshot of the hidraw devices. hid_enumerate() and hid_open() answer from it
+   until the udev monitor reports a hidraw add/remove/change event. */
+static struct {
+	pthread_mutex_t lock;
+	struct udev *udev;
+	struct udev_monitor *monitor;
+	struct hid_device_info *devices; /* every USB/Bluetooth hidraw device, unfiltered */
+	struct hid_device_info *claimed; /* devices opened through libusb or usbfs: their hidraw node is gone meanwhile */
+	struct device_identity *identities; /* dropped on the same events as the snapshot */
+	int valid;
+} enumeration_cache = { PTHREAD_MUTEX_INITIALIZER, NULL, NULL, NULL, NULL, NULL, 0 };
+
+static void invalidate_enumeration_cache(void);
+static void close_enumeration_cache(void);
+static struct device_identity *get_device_identity(dev_t devnum, const char *path);
+
 static __u32 detect_kernel_version(void)
 {
 	struct utsname name;
@@ -107,6 +163,7 @@ static hid_device *new_hid_device(void)
 	dev->device_handle = -1;
 	dev->blocking = 1;
 	dev->uses_numbered_reports = 0;
+	dev->virtual_index = -1;
 
 	return dev;
 }
@@ -257,108 +314,153 @@ next_line:
 }
 
 
-static int get_device_string(hid_device *dev, enum device_string_id key, wchar_t *string, size_t maxlen)
+static int get_virtual_device_string(hid_device *dev, enum device_string_id key, wchar_t *string, size_t maxlen)
+{
+	const char *serial;
+	size_t retm;
+
+	switch (key) {
+		case DEVICE_STRING_MANUFACTURER:
+			wcsncpy(string, VIRTUAL_DEVICE_MANUFACTURER, maxlen);
+			return 0;
+		case DEVICE_STRING_PRODUCT:
+			wcsncpy(string, VIRTUAL_DEVICE_PRODUCT, maxlen);
+			return 0;
+		case DEVICE_STRING_SERIAL:
+			serial = virtual_device_serial(virtual_device_get(dev->virtual_index));
+			if (!serial)
+				return -1;
+			retm = mbstowcs(string, serial, maxlen);
+			return (retm == (size_t)-1)? -1: 0;
+		case DEVICE_STRING_COUNT:
+		default:
+			return -1;
+	}
+}
+
+/* Reads the manufacturer, product and serial strings of the hidraw node devnum in one udev walk */
+static void read_device_strings(struct udev *udev, dev_t devnum, struct device_identity *identity)
 {
-	struct udev *udev;
 	struct udev_device *udev_dev, *parent, *hid_dev;
-	struct stat s;
-	int ret = -1;
-        char *serial_number_utf8 = NULL;
-        char *product_name_utf8 = NULL;
+	char *serial_number_utf8 = NULL;
+	char *product_name_utf8 = NULL;
+	int key;
 
-	/* Create the udev object */
-	udev = udev_new();
-	if (!udev) {
-		printf("Can't create udev\n");
-		return -1;
-	}
+	if (!udev)
+		return;
 
-	/* Get the dev_t (major/minor numbers) from the file handle. */
-	ret = fstat(dev->device_handle, &s);
-	if (-1 == ret)
-		return ret;
 	/* Open a udev device from the dev_t. 'c' means character device. */
-	udev_dev = udev_device_new_from_devnum(udev, 'c', s.st_rdev);
-	if (udev_dev) {
-		hid_dev = udev_device_get_parent_with_subsystem_devtype(
-			udev_dev,
-			"hid",
-			NULL);
-		if (hid_dev) {
-			unsigned short dev_vid;
-			unsigned short dev_pid;
-			int bus_type;
-			size_t retm;
-
-			ret = parse_uevent_info(
-			           udev_device_get_sysattr_value(hid_dev, "uevent"),
-			           &bus_type,
-			           &dev_vid,
-			           &dev_pid,
-			           &serial_number_utf8,
-			           &product_name_utf8);
-
-			if (bus_type == BUS_BLUETOOTH) {
-				switch (key) {
-					case DEVICE_STRING_MANUFACTURER:
-						wcsncpy(string, L"", maxlen);
-						ret = 0;
-						break;
-					case DEVICE_STRING_PRODUCT:
-						retm = mbstowcs(string, product_name_utf8, maxlen);
-						ret = (retm == (size_t)-1)? -1: 0;
-						break;
-					case DEVICE_STRING_SERIAL:
-						retm = mbstowcs(string, serial_number_utf8, maxlen);
-						ret = (retm == (size_t)-1)? -1: 0;
-						break;
-					case DEVICE_STRING_COUNT:
-					default:
-						ret = -1;
-						break;
-				}
-			}
-			else {
-				/* This is a USB device. Find its parent USB Device node. */
-				parent = udev_device_get_parent_with_subsystem_devtype(
-					   udev_dev,
-					   "usb",
-					   "usb_device");
-				if (parent) {
-					const char *str;
-					const char *key_str = NULL;
-
-					if (key >= 0 && key < DEVICE_STRING_COUNT) {
-						key_str = device_string_names[key];
-					} else {
-						ret = -1;
-						goto end;
-					}
+	udev_dev = udev_device_new_from_devnum(udev, 'c', devnum);
+	if (!udev_dev)
+		return;
 
-					str = udev_device_get_sysattr_value(parent, key_str);
-					if (str) {
-						/* Convert the string from UTF-8 to wchar_t */
-						retm = mbstowcs(string, str, maxlen);
-						ret = (retm == (size_t)-1)? -1: 0;
-						goto end;
-					}
-				}
+	hid_dev = udev_device_get_parent_with_subsystem_devtype(
+		udev_dev,
+		"hid",
+		NULL);
+	if (hid_dev) {
+		unsigned short dev_vid;
+		unsigned short dev_pid;
+		int bus_type;
+
+		parse_uevent_info(
+		           udev_device_get_sysattr_value(hid_dev, "uevent"),
+		           &bus_type,
+		           &dev_vid,
+		           &dev_pid,
+		           &serial_number_utf8,
+		           &product_name_utf8);
+
+		if (bus_type == BUS_BLUETOOTH) {
+			identity->strings[DEVICE_STRING_MANUFACTURER] = wcsdup(L"");
+			identity->strings[DEVICE_STRING_PRODUCT] = utf8_to_wchar_t(product_name_utf8);
+			identity->strings[DEVICE_STRING_SERIAL] = utf8_to_wchar_t(serial_number_utf8);
+		}
+		else {
+			/* This is a USB device. Find its parent USB Device node. */
+			parent = udev_device_get_parent_with_subsystem_devtype(
+				   udev_dev,
+				   "usb",
+				   "usb_device");
+			if (parent) {
+				for (key = 0; key < DEVICE_STRING_COUNT; key++)
+					identity->strings[key] = copy_udev_string(parent, device_string_names[key]);
 			}
 		}
 	}
 
-end:
-        free(serial_number_utf8);
-        free(product_name_utf8);
+	free(serial_number_utf8);
+	free(product_name_utf8);
 
 	udev_device_unref(udev_dev);
 	/* parent and hid_dev don't need to be (and can't be) unref'd.
 	   I'm not sure why, but they'll throw double-free() errors. */
+}
+
+/* Walks udev for the strings of the hidraw node without the cache, as done before there was one */
+static int read_device_string_uncached(dev_t devnum, enum device_string_id key, wchar_t *string, size_t maxlen)
+{
+	struct device_identity identity;
+	struct udev *udev;
+	int ret = -1;
+	int index;
+
+	udev = udev_new();
+	if (!udev)
+		return -1;
+
+	memset(&identity, 0, sizeof(identity));
+	read_device_strings(udev, devnum, &identity);
+	if (identity.strings[key]) {
+		wcsncpy(string, identity.strings[key], maxlen);
+		ret = 0;
+	}
+
+	for (index = 0; index < DEVICE_STRING_COUNT; index++)
+		free(identity.strings[index]);
 	udev_unref(udev);
 
 	return ret;
 }
 
+static int get_device_string(hid_device *dev, enum device_string_id key, wchar_t *string, size_t maxlen)
+{
+	struct device_identity *identity;
+	int ret = -1;
+
+	if (dev->virtual_index >= 0)
+		return get_virtual_device_string(dev, key, string, maxlen);
+	if (dev->libusb)
+		return hid_libusb_get_string(dev->libusb, key, string, maxlen);
+	if (dev->usbfs)
+		return hid_usbfs_get_string(dev->usbfs, key, string, maxlen);
+
+	if (key < 0 || key >= DEVICE_STRING_COUNT)
+		return -1;
+
+	pthread_mutex_lock(&enumeration_cache.lock);
+
+	/* Any hidraw event drops the identities, the one of an open device is built again on demand */
+	identity = get_device_identity(dev->devnum, dev->path);
+	if (identity) {
+		if (!identity->strings_known) {
+			read_device_strings(enumeration_cache.udev, dev->devnum, identity);
+			identity->strings_known = 1;
+		}
+		if (identity->strings[key]) {
+			wcsncpy(string, identity->strings[key], maxlen);
+			ret = 0;
+		}
+	}
+
+	pthread_mutex_unlock(&enumeration_cache.lock);
+
+	if (!identity)
+		return read_device_string_uncached(dev->devnum, key, string, maxlen);
+
+	return ret;
+}
+
 int HID_API_EXPORT hid_init(void)
 {
 	const char *locale;
@@ -368,21 +470,22 @@ int HID_API_EXPORT hid_init(void)
 	if (!locale)
 		setlocale(LC_CTYPE, "");
 
-	kernel_version = detect_kernel_version();
+	if (!kernel_version)
+		kernel_version = detect_kernel_version();
 
 	return 0;
 }
 
 int HID_API_EXPORT hid_exit(void)
 {
-	/* Nothing to do for this in the Linux/hidraw implementation. */
+	close_enumeration_cache();
 	return 0;
 }
 
 
-struct hid_device_info  HID_API_EXPORT *hid_enumerate(unsigned short vendor_id, unsigned short product_id)
+/* Scans the 'hidraw' subsystem and returns the USB and Bluetooth devices matching vendor_id/product_id (0 matches any). */
+static struct hid_device_info *scan_hidraw_devices(struct udev *udev, unsigned short vendor_id, unsigned short product_id)
 {
-	struct udev *udev;
 	struct udev_enumerate *enumerate;
 	struct udev_list_entry *devices, *dev_list_entry;
 
@@ -390,15 +493,6 @@ struct hid_device_info  HID_API_EXPORT *hid_enumerate(unsigned short vendor_id,
 	struct hid_device_info *cur_dev = NULL;
 	struct hid_device_info *prev_dev = NULL; /* previous device */
 
-	hid_init();
-
-	/* Create the udev object */
-	udev = udev_new();
-	if (!udev) {
-		printf("Can't create udev\n");
-		return NULL;
-	}
-
 	/* Create a list of the devices in the 'hidraw' subsystem. */
 	enumerate = udev_enumerate_new(udev);
 	udev_enumerate_add_match_subsystem(enumerate, "hidraw");
@@ -561,9 +655,268 @@ struct hid_device_info  HID_API_EXPORT *hid_enumerate(unsigned short vendor_id,
 		   unref()d.  It will cause a double-free() error.  I'm not
 		   sure why.  */
 	}
-	/* Free the enumerator and udev objects. */
+	/* Free the enumerator object. */
 	udev_enumerate_unref(enumerate);
-	udev_unref(udev);
+
+	return root;
+}
+
+static wchar_t *copy_wide_string(const wchar_t *string)
+{
+	return string? wcsdup(string): NULL;
+}
+
+/* Deep copy of a single entry, without its successors. */
+static struct hid_device_info *copy_device_info(const struct hid_device_info *device)
+{
+	struct hid_device_info *tmp = malloc(sizeof(struct hid_device_info));
+
+	*tmp = *device;
+	tmp->next = NULL;
+	tmp->path = device->path? strdup(device->path): NULL;
+	tmp->serial_number = copy_wide_string(device->serial_number);
+	tmp->manufacturer_string = copy_wide_string(device->manufacturer_string);
+	tmp->product_string = copy_wide_string(device->product_string);
+
+	return tmp;
+}
+
+/* Deep copy of the entries of list matching vendor_id/product_id (0 matches any). */
+static struct hid_device_info *copy_matching_devices(const struct hid_device_info *list, unsigned short vendor_id, unsigned short product_id)
+{
+	struct hid_device_info *root = NULL, *cur_dev = NULL;
+
+	for (; list; list = list->next) {
+		struct hid_device_info *tmp;
+
+		if ((vendor_id != 0x0 && vendor_id != list->vendor_id) ||
+		    (product_id != 0x0 && product_id != list->product_id))
+			continue;
+
+		tmp = copy_device_info(list);
+
+		if (cur_dev)
+			cur_dev->next = tmp;
+		else
+			root = tmp;
+		cur_dev = tmp;
+	}
+
+	return root;
+}
+
+/* Returns a non-blocking monitor of the hidraw subsystem or NULL. */
+static struct udev_monitor *new_hidraw_monitor(struct udev *udev)
+{
+	struct udev_monitor *monitor;
+	const char *source;
+
+	/* Without a running udevd no "udev" events are ever sent: listen to the kernel directly then */
+	source = (access("/run/udev/control", F_OK) == 0)? "udev": "kernel";
+
+	monitor = udev_monitor_new_from_netlink(udev, source);
+	if (monitor &&
+	    (udev_monitor_filter_add_match_subsystem_devtype(monitor, "hidraw", NULL) < 0 ||
+	     udev_monitor_enable_receiving(monitor) < 0)) {
+		udev_monitor_unref(monitor);
+		monitor = NULL;
+	}
+
+	return monitor;
+}
+
+/* Receives every queued event of a non-blocking monitor and returns their number. */
+static int drain_monitor(struct udev_monitor *monitor)
+{
+	struct udev_device *event_dev;
+	int count = 0;
+
+	while ((event_dev = udev_monitor_receive_device(monitor)) != NULL) {
+		udev_device_unref(event_dev);
+		++count;
+	}
+
+	return count;
+}
+
+/* Creates the udev context and the monitor that invalidates the snapshot. Called with the cache locked. */
+static void open_enumeration_cache(void)
+{
+	if (enumeration_cache.udev)
+		return;
+
+	enumeration_cache.udev = udev_new();
+	if (!enumeration_cache.udev) {
+		printf("Can't create udev\n");
+		return;
+	}
+
+	enumeration_cache.monitor = new_hidraw_monitor(enumeration_cache.udev);
+}
+
+/* Called with the cache locked. */
+static void free_device_identities(void)
+{
+	struct device_identity *identity;
+	int key;
+
+	while (enumeration_cache.identities) {
+		identity = enumeration_cache.identities;
+		enumeration_cache.identities = identity->next;
+
+		for (key = 0; key < DEVICE_STRING_COUNT; key++)
+			free(identity->strings[key]);
+		free(identity->path);
+		free(identity);
+	}
+}
+
+/* Drops the snapshot if the monitor reported any hidraw event since the last call. Called with the cache locked. */
+static void check_enumeration_cache(void)
+{
+	struct pollfd fds;
+
+	if (!enumeration_cache.monitor) {
+		/* No way to learn about changes: never trust the snapshot */
+		enumeration_cache.valid = 0;
+		free_device_identities();
+		return;
+	}
+
+	fds.fd = udev_monitor_get_fd(enumeration_cache.monitor);
+	fds.events = POLLIN;
+	fds.revents = 0;
+	if (poll(&fds, 1, 0) <= 0)
+		return;
+
+	/* The monitor socket is non-blocking, drain every queued event */
+	drain_monitor(enumeration_cache.monitor);
+	enumeration_cache.valid = 0;
+	free_device_identities();
+}
+
+static void invalidate_enumeration_cache(void)
+{
+	pthread_mutex_lock(&enumeration_cache.lock);
+	enumeration_cache.valid = 0;
+	free_device_identities();
+	pthread_mutex_unlock(&enumeration_cache.lock);
+}
+
+static void close_enumeration_cache(void)
+{
+	pthread_mutex_lock(&enumeration_cache.lock);
+	hid_free_enumeration(enumeration_cache.devices);
+	enumeration_cache.devices = NULL;
+	enumeration_cache.valid = 0;
+	free_device_identities();
+	if (enumeration_cache.monitor)
+		udev_monitor_unref(enumeration_cache.monitor);
+	enumeration_cache.monitor = NULL;
+	if (enumeration_cache.udev)
+		udev_unref(enumeration_cache.udev);
+	enumeration_cache.udev = NULL;
+	pthread_mutex_unlock(&enumeration_cache.lock);
+}
+
+/* Returns the identity of the hidraw node devnum, adding an empty one when path is given.
+   A hidraw event may mean another device behind the same node, so the monitor is checked
+   first. Called with the cache locked. */
+static struct device_identity *get_device_identity(dev_t devnum, const char *path)
+{
+	struct device_identity *identity;
+
+	open_enumeration_cache();
+	if (!enumeration_cache.udev)
+		return NULL;
+	check_enumeration_cache();
+
+	for (identity = enumeration_cache.identities; identity; identity = identity->next) {
+		if (identity->devnum == devnum && (!path || strcmp(identity->path, path) == 0))
+			return identity;
+	}
+
+	if (!path)
+		return NULL;
+
+	identity = calloc(1, sizeof(struct device_identity));
+	if (!identity)
+		return NULL;
+	identity->devnum = devnum;
+	identity->path = strdup(path);
+	if (!identity->path) {
+		free(identity);
+		return NULL;
+	}
+	identity->uses_numbered_reports = -1;
+	identity->next = enumeration_cache.identities;
+	enumeration_cache.identities = identity;
+
+	return identity;
+}
+
+/* Keeps the devices claimed through libusb or usbfs enumerable, so indices and serial lookups stay stable.
+   Called with the cache lock held. */
+static struct hid_device_info *append_claimed_devices(struct hid_device_info *root, unsigned short vendor_id, unsigned short product_id)
+{
+	struct hid_device_info *claimed, *cur_dev, **link = &root;
+	const struct hid_device_info *scanned;
+
+	while (*link)
+		link = &(*link)->next;
+
+	claimed = copy_matching_devices(enumeration_cache.claimed, vendor_id, product_id);
+	while (claimed) {
+		cur_dev = claimed;
+		claimed = claimed->next;
+		cur_dev->next = NULL;
+
+		for (scanned = root; scanned; scanned = scanned->next) {
+			if (strcmp(scanned->path, cur_dev->path) == 0)
+				break;
+		}
+
+		if (scanned) {
+			hid_free_enumeration(cur_dev);
+		} else {
+			*link = cur_dev;
+			link = &cur_dev->next;
+		}
+	}
+
+	return root;
+}
+
+struct hid_device_info  HID_API_EXPORT *hid_enumerate(unsigned short vendor_id, unsigned short product_id)
+{
+	struct hid_device_info *root = NULL; /* return object */
+
+	hid_init();
+
+	/* Simulated devices replace the real ones when requested */
+	if (virtual_device_count() > 0)
+		return virtual_device_enumerate(vendor_id, product_id);
+
+	pthread_mutex_lock(&enumeration_cache.lock);
+
+	open_enumeration_cache();
+	if (!enumeration_cache.udev) {
+		pthread_mutex_unlock(&enumeration_cache.lock);
+		return NULL;
+	}
+
+	/* The monitor is enabled before scanning, so no change can fall between the scan and the check */
+	check_enumeration_cache();
+	if (!enumeration_cache.valid) {
+		hid_free_enumeration(enumeration_cache.devices);
+		enumeration_cache.devices = scan_hidraw_devices(enumeration_cache.udev, 0x0, 0x0);
+		enumeration_cache.valid = 1;
+	}
+
+	root = copy_matching_devices(enumeration_cache.devices, vendor_id, product_id);
+	root = append_claimed_devices(root, vendor_id, product_id);
+
+	pthread_mutex_unlock(&enumeration_cache.lock);
 
 	return root;
 }
@@ -617,49 +970,198 @@ hid_device * hid_open(unsigned short vendor_id, unsigned short product_id, const
 	return handle;
 }
 
+/* Claims the USB interface behind a hidraw node through usbfs or libusb, returns 1 on success */
+static int open_claimed(hid_device *dev, const char *path)
+{
+	struct udev *udev;
+	struct udev_device *udev_dev, *interface_dev, *usb_dev;
+	const struct hid_device_info *info;
+	struct stat s;
+	const char *busnum = NULL, *devnum = NULL, *interface_number = NULL;
+
+	if (stat(path, &s) != 0)
+		return 0;
+
+	udev = udev_new();
+	if (!udev)
+		return 0;
+
+	udev_dev = udev_device_new_from_devnum(udev, 'c', s.st_rdev);
+	if (udev_dev) {
+		interface_dev = udev_device_get_parent_with_subsystem_devtype(udev_dev, "usb", "usb_interface");
+		usb_dev = udev_device_get_parent_with_subsystem_devtype(udev_dev, "usb", "usb_device");
+		if (interface_dev && usb_dev) {
+			interface_number = udev_device_get_sysattr_value(interface_dev, "bInterfaceNumber");
+			busnum = udev_device_get_sysattr_value(usb_dev, "busnum");
+			devnum = udev_device_get_sysattr_value(usb_dev, "devnum");
+		}
+
+		if (interface_number && busnum && devnum) {
+			if (hid_usbfs_requested())
+				dev->usbfs = hid_usbfs_open(atoi(busnum), atoi(devnum), (int)strtol(interface_number, NULL, 16));
+			else
+				dev->libusb = hid_libusb_open(atoi(busnum), atoi(devnum), (int)strtol(interface_number, NULL, 16));
+		}
+
+		udev_device_unref(udev_dev);
+	}
+	udev_unref(udev);
+
+	if (!dev->libusb && !dev->usbfs)
+		return 0;
+
+	/* Detaching usbhid removes the hidraw node, remember the device for hid_enumerate() */
+	dev->claimed_path = strdup(path);
+
+	pthread_mutex_lock(&enumeration_cache.lock);
+	for (info = enumeration_cache.devices; info; info = info->next) {
+		if (info->path && strcmp(info->path, path) == 0) {
+			struct hid_device_info *claimed = copy_device_info(info);
+
+			claimed->next = enumeration_cache.claimed;
+			enumeration_cache.claimed = claimed;
+			break;
+		}
+	}
+	pthread_mutex_unlock(&enumeration_cache.lock);
+
+	return 1;
+}
+
+static void close_claimed(hid_device *dev)
+{
+	struct hid_device_info **link, *claimed;
+
+	if (dev->usbfs)
+		hid_usbfs_close(dev->usbfs);
+	else
+		hid_libusb_close(dev->libusb);
+
+	pthread_mutex_lock(&enumeration_cache.lock);
+	for (link = &enumeration_cache.claimed; *link; link = &(*link)->next) {
+		if (strcmp((*link)->path, dev->claimed_path) == 0) {
+			claimed = *link;
+			*link = claimed->next;
+			claimed->next = NULL;
+			hid_free_enumeration(claimed);
+			break;
+		}
+	}
+	pthread_mutex_unlock(&enumeration_cache.lock);
+
+	free(dev->claimed_path);
+}
+
+/* Switches the input path of the device to the reader thread or io_uring when it is requested
+   and available, otherwise makes the descriptor non-blocking for hid_read_many() */
+static void open_input_path(hid_device *dev)
+{
+	int flags;
+
+	if (hid_uring_enabled() && !hid_reader_enabled())
+		dev->uring = hid_uring_new(dev->device_handle);
+
+	/* The posted reads of the ring must block: io_uring fails them on a
+	   non-blocking hidraw descriptor instead of waiting for a report */
+	if (!dev->uring) {
+		flags = fcntl(dev->device_handle, F_GETFL);
+		if (flags != -1)
+			fcntl(dev->device_handle, F_SETFL, flags | O_NONBLOCK);
+	}
+
+	/* The thread drains the descriptor until EAGAIN, so it starts once the descriptor is non-blocking */
+	if (!dev->uring && hid_reader_enabled())
+		dev->reader = hid_reader_new(dev->device_handle);
+}
+
 hid_device * HID_API_EXPORT hid_open_path(const char *path)
 {
 	hid_device *dev = NULL;
+	unsigned int virtual_index;
 
 	hid_init();
 
 	dev = new_hid_device();
 
+	if (virtual_device_parse_path(path, &virtual_index)) {
+		/* The simulator speaks unnumbered reports over a hidraw-like descriptor */
+		dev->device_handle = virtual_device_open(virtual_index);
+		if (dev->device_handle < 0) {
+			free(dev);
+			return NULL;
+		}
+		dev->virtual_index = virtual_index;
+		open_input_path(dev);
+		return dev;
+	}
+
+	/* The libusb and usbfs backends replace hidraw completely, hidraw stays the fallback */
+	if ((hid_libusb_requested() || hid_usbfs_requested()) && open_claimed(dev, path))
+		return dev;
+
 	/* OPEN HERE */
 	dev->device_handle = open(path, O_RDWR);
 
 	/* If we have a good handle, return it. */
 	if (dev->device_handle > 0) {
-
-		/* Get the report descriptor */
-		int res, desc_size = 0;
-		struct hidraw_report_descriptor rpt_desc;
-
-		memset(&rpt_desc, 0x0, sizeof(rpt_desc));
-
-		/* Get Report Descriptor Size */
-		res = ioctl(dev->device_handle, HIDIOCGRDESCSIZE, &desc_size);
-		if (res < 0)
-			perror("HIDIOCGRDESCSIZE");
-
-
-		/* Get Report Descriptor */
-		rpt_desc.size = desc_size;
-		res = ioctl(dev->device_handle, HIDIOCGRDESC, &rpt_desc);
-		if (res < 0) {
-			perror("HIDIOCGRDESC");
+		struct device_identity *identity;
+		int cached_numbered_reports = -1;
+		struct stat s;
+
+		if (fstat(dev->device_handle, &s) == 0)
+			dev->devnum = s.st_rdev;
+		dev->path = strdup(path);
+
+		/* A node opened before (e.g. on a reconnect) doesn't need its descriptor parsed again */
+		pthread_mutex_lock(&enumeration_cache.lock);
+		identity = get_device_identity(dev->devnum, path);
+		if (identity)
+			cached_numbered_reports = identity->uses_numbered_reports;
+		pthread_mutex_unlock(&enumeration_cache.lock);
+
+		if (cached_numbered_reports >= 0) {
+			dev->uses_numbered_reports = cached_numbered_reports;
 		} else {
-			/* Determine if this device uses numbered reports. */
-			dev->uses_numbered_reports =
-				uses_numbered_reports(rpt_desc.value,
-				                      rpt_desc.size);
+			/* Get the report descriptor */
+			int res, desc_size = 0;
+			struct hidraw_report_descriptor rpt_desc;
+
+			memset(&rpt_desc, 0x0, sizeof(rpt_desc));
+
+			/* Get Report Descriptor Size */
+			res = ioctl(dev->device_handle, HIDIOCGRDESCSIZE, &desc_size);
+			if (res < 0)
+				perror("HIDIOCGRDESCSIZE");
+
+
+			/* Get Report Descriptor */
+			rpt_desc.size = desc_size;
+			res = ioctl(dev->device_handle, HIDIOCGRDESC, &rpt_desc);
+			if (res < 0) {
+				perror("HIDIOCGRDESC");
+			} else {
+				/* Determine if this device uses numbered reports. */
+				dev->uses_numbered_reports =
+					uses_numbered_reports(rpt_desc.value,
+					                      rpt_desc.size);
+
+				/* The ioctls ran unlocked, the cache may have been dropped meanwhile */
+				pthread_mutex_lock(&enumeration_cache.lock);
+				identity = get_device_identity(dev->devnum, path);
+				if (identity)
+					identity->uses_numbered_reports = dev->uses_numbered_reports;
+				pthread_mutex_unlock(&enumeration_cache.lock);
+			}
 		}
 
+		open_input_path(dev);
 		return dev;
 	}
 	else {
-		/* Unable to open any devices. */
+		/* Unable to open any devices. The node may be gone before the monitor
+		   noticed it, so don't trust the enumeration snapshot any more. */
 		free(dev);
+		invalidate_enumeration_cache();
 		return NULL;
 	}
 }
@@ -669,40 +1171,98 @@ int HID_API_EXPORT hid_write(hid_device *dev, const unsigned char *data, size_t
 {
 	int bytes_written;
 
+	if (dev->libusb)
+		return hid_libusb_write(dev->libusb, data, length);
+	if (dev->usbfs)
+		return hid_usbfs_write(dev->usbfs, data, length);
+
 	bytes_written = write(dev->device_handle, data, length);
 
 	return bytes_written;
 }
 
 
-int HID_API_EXPORT hid_read_timeout(hid_device *dev, unsigned char *data, size_t length, int milliseconds)
+static int read_queued_report(hid_device *dev, unsigned char *data, size_t length);
+
+static long long monotonic_ns(void)
 {
-	int bytes_read;
+	struct timespec ts;
 
-	if (milliseconds >= 0) {
-		/* Milliseconds is either 0 (non-blocking) or > 0 (contains
-		   a valid timeout). In both cases we want to call poll()
-		   and wait for data to arrive.  Don't rely on non-blocking
-		   operation (O_NONBLOCK) since some kernels don't seem to
-		   properly report device disconnection through read() when
-		   in non-blocking mode.  */
-		int ret;
-		struct pollfd fds;
-
-		fds.fd = dev->device_handle;
-		fds.events = POLLIN;
-		fds.revents = 0;
-		ret = poll(&fds, 1, milliseconds);
-		if (ret == -1 || ret == 0) {
-			/* Error or timeout */
-			return ret;
-		}
-		else {
-			/* Check for errors on the file descriptor. This will
-			   indicate a device disconnection. */
-			if (fds.revents & (POLLERR | POLLHUP | POLLNVAL))
-				return -1;
-		}
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/* Feeds the gap since the previous report into the moving average. Longer gaps than the
+   largest window are pauses between requests: spinning wouldn't have caught them anyway. */
+static void note_report(hid_device *dev, long long now)
+{
+	long long gap = now - dev->last_report_ns;
+
+	if (dev->last_report_ns != 0 && gap <= dev->busy_poll_max_ns)
+		dev->report_gap_ns += (gap - dev->report_gap_ns) >> BUSY_POLL_GAP_SHIFT;
+	dev->last_report_ns = now;
+}
+
+/* Reports are stamped with CLOCK_MONOTONIC_RAW: NTP slewing would skew the latencies measured with it */
+static long long arrival_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+	return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/* The reader thread stamps the reports on arrival, the other paths when they are read */
+static int stamp_report(hid_device *dev, int bytes_read)
+{
+	if (bytes_read > 0 && !dev->reader)
+		dev->report_time_ns = arrival_ns();
+	return bytes_read;
+}
+
+/* Stamps the report hid_read_timeout() returns, which starts a new batch */
+static int stamp_first_report(hid_device *dev, int bytes_read)
+{
+	stamp_report(dev, bytes_read);
+	if (bytes_read > 0)
+		dev->batch_first_ns = dev->report_time_ns;
+	return bytes_read;
+}
+
+static int wait_for_report(hid_device *dev, unsigned char *data, size_t length, int milliseconds)
+{
+	int bytes_read;
+	int ret;
+	struct pollfd fds;
+
+	if (dev->reader)
+		return hid_reader_read(dev->reader, data, length, milliseconds, &dev->report_time_ns);
+	if (dev->uring)
+		return hid_uring_read(dev->uring, data, length, milliseconds);
+	if (dev->libusb)
+		return hid_libusb_read_timeout(dev->libusb, data, length, milliseconds);
+	if (dev->usbfs)
+		return hid_usbfs_read_timeout(dev->usbfs, data, length, milliseconds);
+
+	/* Milliseconds is either 0 (non-blocking), > 0 (contains
+	   a valid timeout) or -1 (blocking). In all cases we want to
+	   call poll() and wait for data to arrive: the descriptor is
+	   non-blocking for hid_read_many(), and some kernels don't
+	   seem to properly report device disconnection through read()
+	   when in non-blocking mode.  */
+	fds.fd = dev->device_handle;
+	fds.events = POLLIN;
+	fds.revents = 0;
+	ret = poll(&fds, 1, milliseconds);
+	if (ret == -1 || ret == 0) {
+		/* Error or timeout */
+		return ret;
+	}
+	else {
+		/* Check for errors on the file descriptor. This will
+		   indicate a device disconnection. */
+		if (fds.revents & (POLLERR | POLLHUP | POLLNVAL))
+			return -1;
 	}
 
 	bytes_read = read(dev->device_handle, data, length);
@@ -721,11 +1281,134 @@ int HID_API_EXPORT hid_read_timeout(hid_device *dev, unsigned char *data, size_t
 	return bytes_read;
 }
 
+int HID_API_EXPORT hid_read_timeout(hid_device *dev, unsigned char *data, size_t length, int milliseconds)
+{
+	long long start, now, window;
+	int bytes_read;
+
+	if (dev->busy_poll_max_ns == 0 || milliseconds == 0)
+		return stamp_first_report(dev, wait_for_report(dev, data, length, milliseconds));
+
+	/* The first attempt also posts the reads of an io_uring device */
+	bytes_read = wait_for_report(dev, data, length, 0);
+
+	start = monotonic_ns();
+	window = dev->report_gap_ns * BUSY_POLL_GAP_FACTOR;
+	if (window > dev->busy_poll_max_ns)
+		window = dev->busy_poll_max_ns;
+	if (milliseconds > 0 && window > milliseconds * 1000000LL)
+		window = milliseconds * 1000000LL;
+
+	now = start;
+	while (bytes_read == 0 && now - start < window) {
+		bytes_read = read_queued_report(dev, data, length);
+		now = monotonic_ns();
+	}
+
+	if (bytes_read == 0) {
+		/* Nothing within the window: sleep in poll() for the rest of the timeout */
+		if (milliseconds > 0) {
+			milliseconds -= (int)((now - start) / 1000000LL);
+			if (milliseconds <= 0)
+				return 0;
+		}
+		bytes_read = wait_for_report(dev, data, length, milliseconds);
+		now = monotonic_ns();
+	}
+
+	if (bytes_read > 0)
+		note_report(dev, now);
+
+	return stamp_first_report(dev, bytes_read);
+}
+
 int HID_API_EXPORT hid_read(hid_device *dev, unsigned char *data, size_t length)
 {
 	return hid_read_timeout(dev, data, length, (dev->blocking)? -1: 0);
 }
 
+/* Takes one more report if it is already queued: 0 if there is none, -1 on error */
+static int read_queued_report(hid_device *dev, unsigned char *data, size_t length)
+{
+	int bytes_read;
+
+	if (dev->reader)
+		return hid_reader_read_completed(dev->reader, data, length, &dev->report_time_ns);
+	if (dev->uring)
+		return stamp_report(dev, hid_uring_read_completed(dev->uring, data, length));
+	if (dev->libusb)
+		return stamp_report(dev, hid_libusb_read_timeout(dev->libusb, data, length, 0));
+	if (dev->usbfs)
+		return stamp_report(dev, hid_usbfs_read_timeout(dev->usbfs, data, length, 0));
+
+	/* The descriptor is non-blocking: no poll() needed, EAGAIN means the queue is empty */
+	bytes_read = read(dev->device_handle, data, length);
+	if (bytes_read < 0)
+		return (errno == EAGAIN || errno == EINTR)? 0: -1;
+
+	if (kernel_version != 0 &&
+	    kernel_version < KERNEL_VERSION(2,6,34) &&
+	    dev->uses_numbered_reports) {
+		/* Work around a kernel bug. Chop off the first byte. */
+		memmove(data, data+1, bytes_read);
+		bytes_read--;
+	}
+
+	return stamp_report(dev, bytes_read);
+}
+
+int HID_API_EXPORT hid_read_many(hid_device *dev, unsigned char *data, size_t report_length, size_t max_reports, int milliseconds)
+{
+	size_t count;
+	int bytes_read;
+
+	if (max_reports == 0)
+		return 0;
+
+	bytes_read = hid_read_timeout(dev, data, report_length, milliseconds);
+	if (bytes_read <= 0)
+		return bytes_read;
+	/* A short report would leave the bytes of an older one in its slot */
+	if ((size_t)bytes_read < report_length)
+		return -1;
+
+	for (count = 1; count < max_reports; count++) {
+		/* An error is left for the next call to see, after the reports read so far */
+		bytes_read = read_queued_report(dev, data + count * report_length, report_length);
+		if (bytes_read <= 0 || (size_t)bytes_read < report_length)
+			break;
+	}
+
+	/* The drained reports arrived during the wait, the next gap starts now */
+	if (dev->busy_poll_max_ns != 0)
+		dev->last_report_ns = monotonic_ns();
+
+	return (int)count;
+}
+
+int HID_API_EXPORT hid_get_report_times(hid_device *dev, long long *first_ns, long long *last_ns)
+{
+	if (!dev->report_time_ns)
+		return -1;
+
+	*first_ns = dev->batch_first_ns;
+	*last_ns = dev->report_time_ns;
+	return 0;
+}
+
+int HID_API_EXPORT hid_set_busy_poll(hid_device *dev, int max_spin_us)
+{
+	if (max_spin_us < 0)
+		return -1;
+
+	dev->busy_poll_max_ns = max_spin_us * 1000LL;
+	/* Start with the full window, the average adapts from the first reports on */
+	dev->report_gap_ns = dev->busy_poll_max_ns / BUSY_POLL_GAP_FACTOR;
+	dev->last_report_ns = 0;
+
+	return 0;
+}
+
 int HID_API_EXPORT hid_set_nonblocking(hid_device *dev, int nonblock)
 {
 	/* Do all non-blocking in userspace using poll(), since it looks
@@ -765,7 +1448,13 @@ void HID_API_EXPORT hid_close(hid_device *dev)
 {
 	if (!dev)
 		return;
+	if (dev->libusb || dev->usbfs)
+		close_claimed(dev);
+	/* The thread reads from the descriptor until it is stopped */
+	hid_reader_free(dev->reader);
+	hid_uring_free(dev->uring);
 	close(dev->device_handle);
+	free(dev->path);
 	free(dev);
 }
 
@@ -795,3 +1484,169 @@ HID_API_EXPORT const wchar_t * HID_API_CALL  hid_error(hid_device *dev)
 {
 	return NULL;
 }
+
+int HID_API_EXPORT HID_API_CALL hid_get_fd(hid_device *dev)
+{
+	if (!dev)
+		return -1;
+	/* The reader thread takes the reports off the descriptor, its event signals them instead */
+	if (dev->reader)
+		return hid_reader_get_fd(dev->reader);
+	/* With io_uring the reports are consumed by the posted reads, only the ring signals them */
+	if (dev->uring)
+		return hid_uring_get_fd(dev->uring);
+	/* libusb spreads its events over several descriptors, usbfs signals completed URBs as writable */
+	return (dev->libusb || dev->usbfs)? -1: dev->device_handle;
+}
+
+
+struct hid_hotplug_event_ {
+	int event;
+	struct hid_device_info *device;
+	struct hid_hotplug_event_ *next;
+};
+
+struct hid_hotplug_monitor_ {
+	unsigned short vendor_id;
+	unsigned short product_id;
+	struct udev *udev;
+	struct udev_monitor *monitor;
+	struct hid_device_info *known;       /* matching devices at the last rescan */
+	struct hid_hotplug_event_ *pending;  /* events not yet returned */
+	struct hid_hotplug_event_ *pending_tail;
+};
+
+static int same_device(const struct hid_device_info *a, const struct hid_device_info *b)
+{
+	if (!a->path || !b->path || strcmp(a->path, b->path) != 0)
+		return 0;
+	if (a->serial_number && b->serial_number)
+		return wcscmp(a->serial_number, b->serial_number) == 0;
+	return a->serial_number == b->serial_number;
+}
+
+static int contains_device(const struct hid_device_info *list, const struct hid_device_info *device)
+{
+	for (; list; list = list->next) {
+		if (same_device(list, device))
+			return 1;
+	}
+	return 0;
+}
+
+static void queue_hotplug_event(hid_hotplug_monitor *monitor, int event, const struct hid_device_info *device)
+{
+	struct hid_hotplug_event_ *entry = calloc(1, sizeof(struct hid_hotplug_event_));
+
+	entry->event = event;
+	entry->device = copy_device_info(device);
+
+	if (monitor->pending_tail)
+		monitor->pending_tail->next = entry;
+	else
+		monitor->pending = entry;
+	monitor->pending_tail = entry;
+}
+
+/* Compares a fresh enumeration with the known devices and queues the differences. */
+static void rescan_hotplug_devices(hid_hotplug_monitor *monitor)
+{
+	struct hid_device_info *current;
+	const struct hid_device_info *device;
+
+	/* The monitor of the snapshot may not have received this event yet, so it would still look valid */
+	invalidate_enumeration_cache();
+	current = hid_enumerate(monitor->vendor_id, monitor->product_id);
+
+	for (device = monitor->known; device; device = device->next) {
+		if (!contains_device(current, device))
+			queue_hotplug_event(monitor, HID_HOTPLUG_EVENT_LEFT, device);
+	}
+
+	for (device = current; device; device = device->next) {
+		if (!contains_device(monitor->known, device))
+			queue_hotplug_event(monitor, HID_HOTPLUG_EVENT_ARRIVED, device);
+	}
+
+	hid_free_enumeration(monitor->known);
+	monitor->known = current;
+}
+
+HID_API_EXPORT hid_hotplug_monitor * HID_API_CALL hid_hotplug_monitor_new(unsigned short vendor_id, unsigned short product_id)
+{
+	hid_hotplug_monitor *monitor = calloc(1, sizeof(hid_hotplug_monitor));
+
+	monitor->vendor_id = vendor_id;
+	monitor->product_id = product_id;
+
+	monitor->udev = udev_new();
+	if (!monitor->udev) {
+		printf("Can't create udev\n");
+		free(monitor);
+		return NULL;
+	}
+
+	/* Enable receiving before the first scan, so no change is missed in between */
+	monitor->monitor = new_hidraw_monitor(monitor->udev);
+	if (!monitor->monitor) {
+		udev_unref(monitor->udev);
+		free(monitor);
+		return NULL;
+	}
+
+	monitor->known = hid_enumerate(vendor_id, product_id);
+
+	return monitor;
+}
+
+int HID_API_EXPORT HID_API_CALL hid_hotplug_monitor_get_fd(hid_hotplug_monitor *monitor)
+{
+	if (!monitor)
+		return -1;
+	return udev_monitor_get_fd(monitor->monitor);
+}
+
+int HID_API_EXPORT HID_API_CALL hid_hotplug_monitor_receive(hid_hotplug_monitor *monitor, int *event, struct hid_device_info **device)
+{
+	struct hid_hotplug_event_ *entry;
+
+	if (!monitor || !event || !device)
+		return -1;
+
+	/* Events of other devices on the subsystem only cost a rescan of the snapshot */
+	if (!monitor->pending && drain_monitor(monitor->monitor) > 0)
+		rescan_hotplug_devices(monitor);
+
+	entry = monitor->pending;
+	if (!entry)
+		return 0;
+
+	monitor->pending = entry->next;
+	if (!monitor->pending)
+		monitor->pending_tail = NULL;
+
+	*event = entry->event;
+	*device = entry->device;
+	free(entry);
+
+	return 1;
+}
+
+void HID_API_EXPORT HID_API_CALL hid_hotplug_monitor_free(hid_hotplug_monitor *monitor)
+{
+	struct hid_hotplug_event_ *entry;
+
+	if (!monitor)
+		return;
+
+	while ((entry = monitor->pending) != NULL) {
+		monitor->pending = entry->next;
+		hid_free_enumeration(entry->device);
+		free(entry);
+	}
+
+	hid_free_enumeration(monitor->known);
+	udev_monitor_unref(monitor->monitor);
+	udev_unref(monitor->udev);
+	free(monitor);
+}
@@ -0,0 +1,319 @@
+/*******************************************************
+ libusb report transport, see hid_libusb.h
+********************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include <libusb.h>
+
+#include "hid_libusb.h"
+
+#define HID_INTERFACE_CLASS 3
+#define HID_SET_REPORT 0x09
+#define HID_OUTPUT_REPORT_TYPE 0x02
+
+struct hid_libusb_report {
+	unsigned char data[HID_LIBUSB_MAX_REPORT_SIZE];
+	int length;
+};
+
+struct hid_libusb {
+	libusb_context *context;
+	libusb_device_handle *handle;
+	int interface_number;
+	unsigned char input_endpoint;
+	unsigned char output_endpoint;  /* 0 when output reports go through SET_REPORT */
+	int input_packet_size;
+
+	struct libusb_transfer *transfers[HID_LIBUSB_IN_TRANSFERS];
+	int active_transfers;
+	int disconnected;
+
+	struct hid_libusb_report queue[HID_LIBUSB_QUEUE_LENGTH];
+	unsigned queue_head;
+	unsigned queue_count;
+};
+
+int hid_libusb_requested(void)
+{
+	const char *value = getenv(HID_BACKEND_ENV);
+
+	return value && strcmp(value, HID_BACKEND_LIBUSB) == 0;
+}
+
+static void read_callback(struct libusb_transfer *transfer)
+{
+	struct hid_libusb *dev = transfer->user_data;
+
+	if (transfer->status == LIBUSB_TRANSFER_COMPLETED) {
+		struct hid_libusb_report *report;
+
+		if (dev->queue_count == HID_LIBUSB_QUEUE_LENGTH) {
+			dev->queue_head = (dev->queue_head + 1) % HID_LIBUSB_QUEUE_LENGTH;
+			dev->queue_count--;
+		}
+
+		report = &dev->queue[(dev->queue_head + dev->queue_count) % HID_LIBUSB_QUEUE_LENGTH];
+		report->length = (transfer->actual_length < HID_LIBUSB_MAX_REPORT_SIZE)? transfer->actual_length: HID_LIBUSB_MAX_REPORT_SIZE;
+		memcpy(report->data, transfer->buffer, report->length);
+		dev->queue_count++;
+	} else if (transfer->status == LIBUSB_TRANSFER_NO_DEVICE) {
+		dev->disconnected = 1;
+	}
+
+	if (transfer->status == LIBUSB_TRANSFER_CANCELLED || dev->disconnected ||
+	    libusb_submit_transfer(transfer) != LIBUSB_SUCCESS)
+		dev->active_transfers--;
+}
+
+/* Finds the interrupt endpoints of the HID interface */
+static int find_endpoints(struct hid_libusb *dev, libusb_device *usb_dev)
+{
+	struct libusb_config_descriptor *config;
+	const struct libusb_interface_descriptor *interface;
+	int i, found = 0;
+
+	if (libusb_get_active_config_descriptor(usb_dev, &config) != LIBUSB_SUCCESS)
+		return 0;
+
+	if (dev->interface_number < config->bNumInterfaces &&
+	    config->interface[dev->interface_number].num_altsetting > 0) {
+		interface = &config->interface[dev->interface_number].altsetting[0];
+
+		if (interface->bInterfaceClass == HID_INTERFACE_CLASS) {
+			for (i = 0; i < interface->bNumEndpoints; i++) {
+				const struct libusb_endpoint_descriptor *ep = &interface->endpoint[i];
+
+				if ((ep->bmAttributes & LIBUSB_TRANSFER_TYPE_MASK) != LIBUSB_TRANSFER_TYPE_INTERRUPT)
+					continue;
+
+				if (ep->bEndpointAddress & LIBUSB_ENDPOINT_IN) {
+					dev->input_endpoint = ep->bEndpointAddress;
+					dev->input_packet_size = ep->wMaxPacketSize;
+					found = 1;
+				} else {
+					dev->output_endpoint = ep->bEndpointAddress;
+				}
+			}
+		}
+	}
+
+	libusb_free_config_descriptor(config);
+	return found;
+}
+
+struct hid_libusb *hid_libusb_open(int busnum, int devnum, int interface_number)
+{
+	struct hid_libusb *dev;
+	libusb_device **list;
+	ssize_t count, i;
+	int res;
+
+	dev = calloc(1, sizeof(struct hid_libusb));
+	dev->interface_number = interface_number;
+
+	if (libusb_init(&dev->context) != LIBUSB_SUCCESS) {
+		free(dev);
+		return NULL;
+	}
+
+	count = libusb_get_device_list(dev->context, &list);
+	for (i = 0; i < count; i++) {
+		if (libusb_get_bus_number(list[i]) == busnum && libusb_get_device_address(list[i]) == devnum) {
+			if (find_endpoints(dev, list[i]) && libusb_open(list[i], &dev->handle) != LIBUSB_SUCCESS)
+				dev->handle = NULL;
+			break;
+		}
+	}
+	if (count >= 0)
+		libusb_free_device_list(list, 1);
+
+	if (!dev->handle)
+		goto fail;
+
+	/* usbhid gets the interface back on release, and with it the hidraw node */
+	libusb_set_auto_detach_kernel_driver(dev->handle, 1);
+	if (libusb_claim_interface(dev->handle, interface_number) != LIBUSB_SUCCESS)
+		goto fail;
+
+	if (dev->input_packet_size > HID_LIBUSB_MAX_REPORT_SIZE)
+		dev->input_packet_size = HID_LIBUSB_MAX_REPORT_SIZE;
+
+	for (i = 0; i < HID_LIBUSB_IN_TRANSFERS; i++) {
+		struct libusb_transfer *transfer = libusb_alloc_transfer(0);
+
+		libusb_fill_interrupt_transfer(transfer, dev->handle, dev->input_endpoint,
+		                               malloc(dev->input_packet_size), dev->input_packet_size,
+		                               read_callback, dev, 0);
+		transfer->flags = LIBUSB_TRANSFER_FREE_BUFFER;
+		dev->transfers[i] = transfer;
+
+		res = libusb_submit_transfer(transfer);
+		if (res == LIBUSB_SUCCESS)
+			dev->active_transfers++;
+	}
+
+	if (!dev->active_transfers) {
+		hid_libusb_close(dev);
+		return NULL;
+	}
+
+	return dev;
+
+fail:
+	if (dev->handle)
+		libusb_close(dev->handle);
+	libusb_exit(dev->context);
+	free(dev);
+	return NULL;
+}
+
+void hid_libusb_close(struct hid_libusb *dev)
+{
+	int i;
+
+	if (!dev)
+		return;
+
+	for (i = 0; i < HID_LIBUSB_IN_TRANSFERS; i++) {
+		if (dev->transfers[i])
+			libusb_cancel_transfer(dev->transfers[i]);
+	}
+
+	/* The transfers may only be freed after their cancellation has completed */
+	while (dev->active_transfers > 0) {
+		if (libusb_handle_events(dev->context) != LIBUSB_SUCCESS)
+			break;
+	}
+
+	for (i = 0; i < HID_LIBUSB_IN_TRANSFERS; i++) {
+		if (dev->transfers[i])
+			libusb_free_transfer(dev->transfers[i]);
+	}
+
+	libusb_release_interface(dev->handle, dev->interface_number);
+	libusb_close(dev->handle);
+	libusb_exit(dev->context);
+	free(dev);
+}
+
+int hid_libusb_write(struct hid_libusb *dev, const unsigned char *data, size_t length)
+{
+	int report_number = data[0];
+	int skipped_report_id = 0;
+	int transferred = 0;
+	int res;
+
+	/* Like hidraw, a leading report ID 0 is not sent on the wire */
+	if (report_number == 0x0) {
+		data++;
+		length--;
+		skipped_report_id = 1;
+	}
+
+	if (dev->output_endpoint) {
+		res = libusb_interrupt_transfer(dev->handle, dev->output_endpoint, (unsigned char *)data, (int)length,
+		                                &transferred, HID_LIBUSB_WRITE_TIMEOUT_MS);
+		if (res != LIBUSB_SUCCESS)
+			return -1;
+	} else {
+		transferred = libusb_control_transfer(dev->handle,
+		                                      LIBUSB_REQUEST_TYPE_CLASS | LIBUSB_RECIPIENT_INTERFACE | LIBUSB_ENDPOINT_OUT,
+		                                      HID_SET_REPORT, (HID_OUTPUT_REPORT_TYPE << 8) | report_number,
+		                                      dev->interface_number, (unsigned char *)data, (uint16_t)length,
+		                                      HID_LIBUSB_WRITE_TIMEOUT_MS);
+		if (transferred < 0)
+			return -1;
+	}
+
+	return transferred + skipped_report_id;
+}
+
+int hid_libusb_read_timeout(struct hid_libusb *dev, unsigned char *data, size_t length, int milliseconds)
+{
+	struct timeval tv, deadline, now;
+	struct hid_libusb_report *report;
+	int res;
+
+	if (milliseconds > 0) {
+		gettimeofday(&deadline, NULL);
+		deadline.tv_sec += milliseconds / 1000;
+		deadline.tv_usec += (milliseconds % 1000) * 1000;
+		if (deadline.tv_usec >= 1000000) {
+			deadline.tv_sec++;
+			deadline.tv_usec -= 1000000;
+		}
+	}
+
+	/* The transfer callbacks run from here and fill the queue */
+	while (!dev->queue_count) {
+		if (dev->disconnected || dev->active_transfers == 0)
+			return -1;
+
+		if (milliseconds < 0) {
+			res = libusb_handle_events(dev->context);
+		} else {
+			tv.tv_sec = 0;
+			tv.tv_usec = 0;
+			if (milliseconds > 0) {
+				gettimeofday(&now, NULL);
+				if (!timercmp(&now, &deadline, <))
+					return 0;
+				timersub(&deadline, &now, &tv);
+			}
+
+			res = libusb_handle_events_timeout(dev->context, &tv);
+			if (milliseconds == 0 && !dev->queue_count)
+				return 0;
+		}
+
+		if (res != LIBUSB_SUCCESS && res != LIBUSB_ERROR_INTERRUPTED)
+			return -1;
+	}
+
+	report = &dev->queue[dev->queue_head];
+	if (length > (size_t)report->length)
+		length = report->length;
+	memcpy(data, report->data, length);
+
+	dev->queue_head = (dev->queue_head + 1) % HID_LIBUSB_QUEUE_LENGTH;
+	dev->queue_count--;
+
+	return (int)length;
+}
+
+int hid_libusb_get_string(struct hid_libusb *dev, int string_id, wchar_t *string, size_t maxlen)
+{
+	struct libusb_device_descriptor desc;
+	unsigned char buffer[256];
+	uint8_t index;
+	int res;
+
+	if (libusb_get_device_descriptor(libusb_get_device(dev->handle), &desc) != LIBUSB_SUCCESS)
+		return -1;
+
+	switch (string_id) {
+		case HID_LIBUSB_STRING_MANUFACTURER:
+			index = desc.iManufacturer;
+			break;
+		case HID_LIBUSB_STRING_PRODUCT:
+			index = desc.iProduct;
+			break;
+		case HID_LIBUSB_STRING_SERIAL:
+			index = desc.iSerialNumber;
+			break;
+		default:
+			return -1;
+	}
+
+	if (!index)
+		return -1;
+
+	res = libusb_get_string_descriptor_ascii(dev->handle, index, buffer, sizeof(buffer));
+	if (res < 0)
+		return -1;
+
+	return (mbstowcs(string, (const char *)buffer, maxlen) == (size_t)-1)? -1: 0;
+}
@@ -0,0 +1,257 @@
+/*******************************************************
+ Reader thread report transport, see hid_reader.h
+********************************************************/
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/eventfd.h>
+
+#include "hid_reader.h"
+
+/* How long the thread waits for the consumer to make room in a full ring */
+#define HID_READER_FULL_WAIT_MS 1
+
+struct hid_reader_report {
+	unsigned char data[HID_READER_REPORT_SIZE];
+	int length;
+	long long time_ns;
+};
+
+struct hid_reader {
+	int fd;
+	int event_fd; /* counts the batches pushed, the consumer waits on it */
+	int stop_fd;  /* wakes the thread up when the device is closed */
+	pthread_t thread;
+
+	/* Each index is written by one side only; separate cache lines keep them from bouncing */
+	unsigned head __attribute__((aligned(64))); /* next report to read, owned by the consumer */
+	unsigned tail __attribute__((aligned(64))); /* next slot to fill, owned by the thread */
+	int failed; /* set by the thread after the last report when the device is gone */
+
+	struct hid_reader_report ring[HID_READER_RING_LENGTH];
+};
+
+int hid_reader_enabled(void)
+{
+	const char *value = getenv(HID_READER_ENV);
+
+	return value && *value && strcmp(value, "0") != 0;
+}
+
+static long long monotonic_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/* Arrival stamps use the clock NTP doesn't slew, like the stamps of hid.c */
+static long long arrival_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+	return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/* Moves every report hidraw has queued into the ring. Returns the number of reports
+   moved, -1 when the device is gone and sets *full when the ring has no room left. */
+static int drain_descriptor(struct hid_reader *reader, int *full)
+{
+	unsigned tail = reader->tail;
+	struct hid_reader_report *slot;
+	int count = 0;
+	int res;
+
+	*full = 0;
+	for (;;) {
+		if (tail - __atomic_load_n(&reader->head, __ATOMIC_ACQUIRE) == HID_READER_RING_LENGTH) {
+			*full = 1;
+			return count;
+		}
+
+		slot = &reader->ring[tail & (HID_READER_RING_LENGTH - 1)];
+		res = read(reader->fd, slot->data, HID_READER_REPORT_SIZE);
+		if (res < 0) {
+			if (errno == EINTR)
+				continue;
+			return (errno == EAGAIN)? count: -1;
+		}
+
+		slot->length = res;
+		slot->time_ns = arrival_ns();
+		tail++;
+		__atomic_store_n(&reader->tail, tail, __ATOMIC_RELEASE);
+		count++;
+	}
+}
+
+static void *reader_thread(void *arg)
+{
+	struct hid_reader *reader = arg;
+	struct pollfd fds[2];
+	int full = 0;
+	int res;
+
+	fds[0].fd = reader->stop_fd;
+	fds[0].events = POLLIN;
+	fds[1].fd = reader->fd;
+	fds[1].events = POLLIN;
+
+	for (;;) {
+		/* With a full ring only the stop request is watched, until the consumer catches up */
+		fds[0].revents = 0;
+		fds[1].revents = 0;
+		res = poll(fds, full? 1: 2, full? HID_READER_FULL_WAIT_MS: -1);
+		if (res < 0 && errno != EINTR)
+			break;
+		if (fds[0].revents)
+			return NULL;
+		if (fds[1].revents & (POLLERR | POLLHUP | POLLNVAL))
+			break;
+
+		res = drain_descriptor(reader, &full);
+		if (res < 0)
+			break;
+		if (res > 0)
+			eventfd_write(reader->event_fd, 1);
+	}
+
+	/* The consumer sees the failure once it has taken the reports received before */
+	__atomic_store_n(&reader->failed, 1, __ATOMIC_RELEASE);
+	eventfd_write(reader->event_fd, 1);
+	return NULL;
+}
+
+struct hid_reader *hid_reader_new(int fd)
+{
+	struct hid_reader *reader;
+
+	if (posix_memalign((void **)&reader, 64, sizeof(struct hid_reader)) != 0)
+		return NULL;
+	memset(reader, 0, sizeof(struct hid_reader));
+	reader->fd = fd;
+
+	reader->event_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	reader->stop_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	if (reader->event_fd < 0 || reader->stop_fd < 0)
+		goto fail;
+
+	if (pthread_create(&reader->thread, NULL, reader_thread, reader) != 0)
+		goto fail;
+
+	return reader;
+
+fail:
+	if (reader->event_fd >= 0)
+		close(reader->event_fd);
+	if (reader->stop_fd >= 0)
+		close(reader->stop_fd);
+	free(reader);
+	return NULL;
+}
+
+void hid_reader_free(struct hid_reader *reader)
+{
+	if (!reader)
+		return;
+
+	eventfd_write(reader->stop_fd, 1);
+	pthread_join(reader->thread, NULL);
+
+	close(reader->event_fd);
+	close(reader->stop_fd);
+	free(reader);
+}
+
+int hid_reader_get_fd(struct hid_reader *reader)
+{
+	return reader->event_fd;
+}
+
+/* Copies the oldest report of the ring, returns -2 if it is empty */
+static int pop_report(struct hid_reader *reader, unsigned char *data, size_t length, long long *time_ns)
+{
+	unsigned head = reader->head;
+	struct hid_reader_report *slot;
+	int res;
+
+	if (head == __atomic_load_n(&reader->tail, __ATOMIC_ACQUIRE))
+		return -2;
+
+	slot = &reader->ring[head & (HID_READER_RING_LENGTH - 1)];
+	res = slot->length;
+	if ((size_t)res > length)
+		res = length;
+	memcpy(data, slot->data, res);
+	if (time_ns)
+		*time_ns = slot->time_ns;
+
+	__atomic_store_n(&reader->head, head + 1, __ATOMIC_RELEASE);
+
+	return res;
+}
+
+int hid_reader_read(struct hid_reader *reader, unsigned char *data, size_t length, int milliseconds, long long *time_ns)
+{
+	struct pollfd fds;
+	eventfd_t count;
+	long long deadline = 0, remaining;
+	int failed;
+	int res;
+
+	if (milliseconds > 0)
+		deadline = monotonic_ns() + milliseconds * 1000000LL;
+
+	for (;;) {
+		res = pop_report(reader, data, length, time_ns);
+		if (res != -2)
+			return res;
+
+		/* Reset the event before looking again, a report pushed meanwhile sets it anew.
+		   The failure flag is read first: once it is set, the ring holds all the reports left. */
+		eventfd_read(reader->event_fd, &count);
+		failed = __atomic_load_n(&reader->failed, __ATOMIC_ACQUIRE);
+		res = pop_report(reader, data, length, time_ns);
+		if (res != -2)
+			return res;
+		if (failed)
+			return -1;
+
+		if (milliseconds == 0)
+			return 0;
+
+		fds.fd = reader->event_fd;
+		fds.events = POLLIN;
+		fds.revents = 0;
+		if (milliseconds > 0) {
+			remaining = deadline - monotonic_ns();
+			if (remaining <= 0)
+				return 0;
+			/* Round up, poll() would otherwise spin through the last millisecond */
+			res = poll(&fds, 1, (int)((remaining + 999999) / 1000000));
+		} else {
+			res = poll(&fds, 1, -1);
+		}
+		if (res < 0 && errno != EINTR)
+			return -1;
+	}
+}
+
+int hid_reader_read_completed(struct hid_reader *reader, unsigned char *data, size_t length, long long *time_ns)
+{
+	int failed = __atomic_load_n(&reader->failed, __ATOMIC_ACQUIRE);
+	int res = pop_report(reader, data, length, time_ns);
+
+	if (res != -2)
+		return res;
+
+	return failed? -1: 0;
+}
@@ -0,0 +1,303 @@
+/*******************************************************
+ io_uring report transport, see hid_uring.h
+
+ Talks to the kernel through the raw system calls, no liburing needed.
+********************************************************/
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#include <linux/io_uring.h>
+#include <linux/time_types.h>
+
+#include "hid_uring.h"
+
+struct hid_uring {
+	int ring_fd;
+	int fd;
+
+	void *sq_ptr;
+	size_t sq_len;
+	unsigned *sq_tail;
+	unsigned *sq_mask;
+	unsigned *sq_array;
+	struct io_uring_sqe *sqes;
+	size_t sqes_len;
+
+	void *cq_ptr;    /* equals sq_ptr with IORING_FEAT_SINGLE_MMAP */
+	size_t cq_len;
+	unsigned *cq_head;
+	unsigned *cq_tail;
+	unsigned *cq_mask;
+	struct io_uring_cqe *cqes;
+
+	unsigned in_flight;  /* reads of the current chain not reaped yet */
+	unsigned to_submit;  /* queued in the SQ ring, not passed to the kernel yet */
+	unsigned char *buffers;
+};
+
+static int io_uring_setup(unsigned entries, struct io_uring_params *p)
+{
+	return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int io_uring_enter(int ring_fd, unsigned to_submit, unsigned min_complete, unsigned flags, void *arg, size_t argsz)
+{
+	return (int)syscall(__NR_io_uring_enter, ring_fd, to_submit, min_complete, flags, arg, argsz);
+}
+
+int hid_uring_enabled(void)
+{
+	const char *value = getenv(HID_URING_ENV);
+
+	return value && *value && strcmp(value, "0") != 0;
+}
+
+/* Queues a new chain of reads once the previous one is fully reaped */
+static void queue_read_chain(struct hid_uring *ring)
+{
+	unsigned tail = *ring->sq_tail;
+	unsigned slot;
+
+	for (slot = 0; slot < HID_URING_DEPTH; slot++, tail++) {
+		unsigned index = tail & *ring->sq_mask;
+		struct io_uring_sqe *sqe = &ring->sqes[index];
+
+		memset(sqe, 0, sizeof(*sqe));
+		sqe->opcode = IORING_OP_READ;
+		sqe->fd = ring->fd;
+		sqe->off = (__u64)-1;
+		sqe->addr = (__u64)(uintptr_t)(ring->buffers + slot * HID_URING_REPORT_SIZE);
+		sqe->len = HID_URING_REPORT_SIZE;
+		sqe->user_data = slot;
+		/* A hard link survives the short read of every report */
+		if (slot + 1 < HID_URING_DEPTH)
+			sqe->flags = IOSQE_IO_HARDLINK;
+
+		ring->sq_array[index] = index;
+	}
+
+	__atomic_store_n(ring->sq_tail, tail, __ATOMIC_RELEASE);
+
+	ring->to_submit += HID_URING_DEPTH;
+	ring->in_flight = HID_URING_DEPTH;
+}
+
+/* Passes the queued reads to the kernel without waiting, returns -1 on error */
+static int submit_queued(struct hid_uring *ring)
+{
+	int res;
+
+	while (ring->to_submit) {
+		res = io_uring_enter(ring->ring_fd, ring->to_submit, 0, 0, NULL, 0);
+		if (res < 0 && errno != EINTR)
+			return -1;
+		if (res > 0)
+			ring->to_submit -= res;
+	}
+
+	return 0;
+}
+
+struct hid_uring *hid_uring_new(int fd)
+{
+	struct io_uring_params params;
+	struct hid_uring *ring;
+
+	ring = calloc(1, sizeof(struct hid_uring));
+	if (!ring)
+		return NULL;
+	ring->fd = fd;
+	ring->sq_ptr = MAP_FAILED;
+	ring->cq_ptr = MAP_FAILED;
+	ring->sqes = MAP_FAILED;
+
+	memset(&params, 0, sizeof(params));
+	ring->ring_fd = io_uring_setup(HID_URING_DEPTH, &params);
+	if (ring->ring_fd < 0) {
+		free(ring);
+		return NULL;
+	}
+
+	/* Waiting with a timeout needs IORING_ENTER_EXT_ARG (5.11), which also implies IORING_OP_READ */
+	if (!(params.features & IORING_FEAT_EXT_ARG) || params.sq_entries < HID_URING_DEPTH)
+		goto fail;
+
+	ring->sq_len = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+	ring->cq_len = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+	if (params.features & IORING_FEAT_SINGLE_MMAP) {
+		if (ring->cq_len > ring->sq_len)
+			ring->sq_len = ring->cq_len;
+		ring->cq_len = ring->sq_len;
+	}
+
+	ring->sq_ptr = mmap(NULL, ring->sq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->ring_fd, IORING_OFF_SQ_RING);
+	if (ring->sq_ptr == MAP_FAILED)
+		goto fail;
+
+	if (params.features & IORING_FEAT_SINGLE_MMAP) {
+		ring->cq_ptr = ring->sq_ptr;
+	} else {
+		ring->cq_ptr = mmap(NULL, ring->cq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->ring_fd, IORING_OFF_CQ_RING);
+		if (ring->cq_ptr == MAP_FAILED)
+			goto fail;
+	}
+
+	ring->sqes_len = params.sq_entries * sizeof(struct io_uring_sqe);
+	ring->sqes = mmap(NULL, ring->sqes_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->ring_fd, IORING_OFF_SQES);
+	if (ring->sqes == MAP_FAILED)
+		goto fail;
+
+	ring->sq_tail = (unsigned *)((char *)ring->sq_ptr + params.sq_off.tail);
+	ring->sq_mask = (unsigned *)((char *)ring->sq_ptr + params.sq_off.ring_mask);
+	ring->sq_array = (unsigned *)((char *)ring->sq_ptr + params.sq_off.array);
+
+	ring->cq_head = (unsigned *)((char *)ring->cq_ptr + params.cq_off.head);
+	ring->cq_tail = (unsigned *)((char *)ring->cq_ptr + params.cq_off.tail);
+	ring->cq_mask = (unsigned *)((char *)ring->cq_ptr + params.cq_off.ring_mask);
+	ring->cqes = (struct io_uring_cqe *)((char *)ring->cq_ptr + params.cq_off.cqes);
+
+	/* The posted reads write into these, the kernel must never get a NULL address */
+	ring->buffers = malloc(HID_URING_DEPTH * HID_URING_REPORT_SIZE);
+	if (!ring->buffers)
+		goto fail;
+
+	/* Only queued: the kernel cancels the reads of a thread that exits, and the device may be opened
+	   by a short-lived one, so they are submitted by the first thread reading or polling the ring */
+	queue_read_chain(ring);
+
+	return ring;
+
+fail:
+	hid_uring_free(ring);
+	return NULL;
+}
+
+void hid_uring_free(struct hid_uring *ring)
+{
+	if (!ring)
+		return;
+
+	/* Closing the ring cancels the reads still posted */
+	if (ring->sqes != MAP_FAILED)
+		munmap(ring->sqes, ring->sqes_len);
+	if (ring->cq_ptr != MAP_FAILED && ring->cq_ptr != ring->sq_ptr)
+		munmap(ring->cq_ptr, ring->cq_len);
+	if (ring->sq_ptr != MAP_FAILED)
+		munmap(ring->sq_ptr, ring->sq_len);
+	close(ring->ring_fd);
+
+	free(ring->buffers);
+	free(ring);
+}
+
+int hid_uring_get_fd(struct hid_uring *ring)
+{
+	/* The ring only signals the reports of reads the kernel has */
+	if (submit_queued(ring) < 0)
+		return -1;
+
+	return ring->ring_fd;
+}
+
+/* Copies the oldest completed report, returns -2 if none has completed */
+static int reap_report(struct hid_uring *ring, unsigned char *data, size_t length)
+{
+	unsigned head = *ring->cq_head;
+	struct io_uring_cqe *cqe;
+	int res;
+
+	if (head == __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE))
+		return -2;
+
+	cqe = &ring->cqes[head & *ring->cq_mask];
+	res = cqe->res;
+	if (res > 0) {
+		if ((size_t)res > length)
+			res = length;
+		memcpy(data, ring->buffers + cqe->user_data * HID_URING_REPORT_SIZE, res);
+	}
+
+	__atomic_store_n(ring->cq_head, head + 1, __ATOMIC_RELEASE);
+	ring->in_flight--;
+
+	/* The chain is re-armed as soon as its last report is taken, also when no read waits on the ring */
+	if (ring->in_flight == 0) {
+		queue_read_chain(ring);
+		submit_queued(ring);
+	}
+
+	return (res < 0)? -1: res;
+}
+
+int hid_uring_read(struct hid_uring *ring, unsigned char *data, size_t length, int milliseconds)
+{
+	struct io_uring_getevents_arg arg;
+	struct __kernel_timespec ts;
+	struct timespec now, deadline;
+	int res;
+
+	if (milliseconds > 0) {
+		clock_gettime(CLOCK_MONOTONIC, &deadline);
+		deadline.tv_sec += milliseconds / 1000;
+		deadline.tv_nsec += (milliseconds % 1000) * 1000000L;
+		if (deadline.tv_nsec >= 1000000000L) {
+			deadline.tv_sec++;
+			deadline.tv_nsec -= 1000000000L;
+		}
+	}
+
+	for (;;) {
+		res = reap_report(ring, data, length);
+		if (res != -2)
+			return res;
+
+		memset(&arg, 0, sizeof(arg));
+		if (milliseconds >= 0) {
+			ts.tv_sec = 0;
+			ts.tv_nsec = 0;
+			if (milliseconds > 0) {
+				/* The call may return early after submitting, wait only for the remaining time */
+				clock_gettime(CLOCK_MONOTONIC, &now);
+				ts.tv_sec = deadline.tv_sec - now.tv_sec;
+				ts.tv_nsec = deadline.tv_nsec - now.tv_nsec;
+				if (ts.tv_nsec < 0) {
+					ts.tv_sec--;
+					ts.tv_nsec += 1000000000L;
+				}
+				if (ts.tv_sec < 0)
+					return 0;
+			}
+			arg.ts = (__u64)(uintptr_t)&ts;
+		}
+
+		/* Submit the chain and wait in the same call; a zero timeout only submits */
+		res = io_uring_enter(ring->ring_fd, ring->to_submit, (milliseconds == 0)? 0: 1,
+		                     IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg, sizeof(arg));
+		if (res >= 0) {
+			ring->to_submit -= res;
+		} else if (errno == ETIME) {
+			return 0;
+		} else if (errno != EINTR) {
+			return -1;
+		}
+
+		if (milliseconds == 0) {
+			res = reap_report(ring, data, length);
+			return (res == -2)? 0: res;
+		}
+	}
+}
+
+int hid_uring_read_completed(struct hid_uring *ring, unsigned char *data, size_t length)
+{
+	int res = reap_report(ring, data, length);
+
+	return (res == -2)? 0: res;
+}
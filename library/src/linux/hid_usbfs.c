@@ -0,0 +1,395 @@
+/*******************************************************
+ usbfs report transport, see hid_usbfs.h
+
+ Talks to the kernel through the usbfs ioctls, no libusb needed.
+********************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+
+#include <linux/usbdevice_fs.h>
+#include <linux/usb/ch9.h>
+
+#include "hid_usbfs.h"
+
+#define HID_SET_REPORT 0x09
+#define HID_OUTPUT_REPORT_TYPE 0x02
+#define USB_DEVICE_DESCRIPTOR_SIZE 18
+/* Room for the device descriptor and every configuration descriptor usbfs returns */
+#define DESCRIPTORS_BUFFER_SIZE 4096
+#define STRING_DESCRIPTOR_SIZE 255
+#define STRING_LANGUAGE_US_ENGLISH 0x0409
+
+struct hid_usbfs {
+	int fd;
+	int interface_number;
+	unsigned char input_endpoint;
+	unsigned char output_endpoint;  /* 0 when output reports go through SET_REPORT */
+	int input_packet_size;
+	unsigned char string_indices[3]; /* HID_USBFS_STRING_* to string descriptor index */
+
+	struct usbdevfs_urb urbs[HID_USBFS_URBS];
+	unsigned char buffers[HID_USBFS_URBS][HID_USBFS_MAX_REPORT_SIZE];
+	int submitted; /* URBs owned by the kernel */
+	int disconnected;
+};
+
+int hid_usbfs_requested(void)
+{
+	const char *value = getenv(HID_BACKEND_ENV);
+
+	return value && strcmp(value, HID_BACKEND_USBFS) == 0;
+}
+
+/* Finds the string indices and the interrupt endpoints of the HID interface in the
+   descriptors usbfs hands out on read() */
+static int parse_descriptors(struct hid_usbfs *dev)
+{
+	unsigned char *buffer;
+	ssize_t length, pos;
+	int in_interface = 0, found = 0;
+
+	buffer = malloc(DESCRIPTORS_BUFFER_SIZE);
+	length = read(dev->fd, buffer, DESCRIPTORS_BUFFER_SIZE);
+	if (length < USB_DEVICE_DESCRIPTOR_SIZE) {
+		free(buffer);
+		return 0;
+	}
+
+	dev->string_indices[HID_USBFS_STRING_MANUFACTURER] = buffer[14];
+	dev->string_indices[HID_USBFS_STRING_PRODUCT] = buffer[15];
+	dev->string_indices[HID_USBFS_STRING_SERIAL] = buffer[16];
+
+	for (pos = USB_DEVICE_DESCRIPTOR_SIZE; pos + 2 <= length && buffer[pos] >= 2; pos += buffer[pos]) {
+		const unsigned char *desc = buffer + pos;
+
+		if (pos + desc[0] > length)
+			break;
+
+		switch (desc[1]) {
+			case USB_DT_CONFIG:
+				/* The first configuration providing the interface is the one used */
+				if (found)
+					goto end;
+				in_interface = 0;
+				break;
+			case USB_DT_INTERFACE:
+				in_interface = desc[0] >= USB_DT_INTERFACE_SIZE &&
+				               desc[2] == dev->interface_number &&
+				               desc[3] == 0 &&
+				               desc[5] == USB_CLASS_HID;
+				break;
+			case USB_DT_ENDPOINT:
+				if (!in_interface || desc[0] < USB_DT_ENDPOINT_SIZE)
+					break;
+				if ((desc[3] & USB_ENDPOINT_XFERTYPE_MASK) != USB_ENDPOINT_XFER_INT)
+					break;
+
+				if (desc[2] & USB_DIR_IN) {
+					dev->input_endpoint = desc[2];
+					dev->input_packet_size = (desc[4] | (desc[5] << 8)) & 0x7FF;
+					found = 1;
+				} else {
+					dev->output_endpoint = desc[2];
+				}
+				break;
+			default:
+				break;
+		}
+	}
+
+end:
+	free(buffer);
+	return found;
+}
+
+/* Takes the interface from usbhid, which removes its hidraw node until the release */
+static int claim_interface(struct hid_usbfs *dev)
+{
+	struct usbdevfs_disconnect_claim claim;
+	struct usbdevfs_ioctl command;
+	unsigned int interface_number = dev->interface_number;
+
+	memset(&claim, 0, sizeof(claim));
+	claim.interface = interface_number;
+	claim.flags = USBDEVFS_DISCONNECT_CLAIM_EXCEPT_DRIVER;
+	strcpy(claim.driver, "usbfs");
+	if (ioctl(dev->fd, USBDEVFS_DISCONNECT_CLAIM, &claim) == 0)
+		return 1;
+
+	/* Before Linux 3.9: detach the driver first, then claim */
+	command.ifno = interface_number;
+	command.ioctl_code = USBDEVFS_DISCONNECT;
+	command.data = NULL;
+	ioctl(dev->fd, USBDEVFS_IOCTL, &command);
+
+	return ioctl(dev->fd, USBDEVFS_CLAIMINTERFACE, &interface_number) == 0;
+}
+
+static void release_interface(struct hid_usbfs *dev)
+{
+	struct usbdevfs_ioctl command;
+	unsigned int interface_number = dev->interface_number;
+
+	ioctl(dev->fd, USBDEVFS_RELEASEINTERFACE, &interface_number);
+
+	/* usbhid gets the interface back, and with it the hidraw node */
+	command.ifno = interface_number;
+	command.ioctl_code = USBDEVFS_CONNECT;
+	command.data = NULL;
+	ioctl(dev->fd, USBDEVFS_IOCTL, &command);
+}
+
+static int submit_urb(struct hid_usbfs *dev, struct usbdevfs_urb *urb)
+{
+	unsigned char *buffer = dev->buffers[urb - dev->urbs];
+
+	memset(urb, 0, sizeof(*urb));
+	urb->type = USBDEVFS_URB_TYPE_INTERRUPT;
+	urb->endpoint = dev->input_endpoint;
+	urb->buffer = buffer;
+	urb->buffer_length = dev->input_packet_size;
+
+	if (ioctl(dev->fd, USBDEVFS_SUBMITURB, urb) != 0)
+		return -1;
+
+	dev->submitted++;
+	return 0;
+}
+
+struct hid_usbfs *hid_usbfs_open(int busnum, int devnum, int interface_number)
+{
+	struct hid_usbfs *dev;
+	char path[64];
+	int i;
+
+	snprintf(path, sizeof(path), "/dev/bus/usb/%03d/%03d", busnum, devnum);
+
+	dev = calloc(1, sizeof(struct hid_usbfs));
+	dev->interface_number = interface_number;
+
+	dev->fd = open(path, O_RDWR | O_CLOEXEC);
+	if (dev->fd < 0) {
+		free(dev);
+		return NULL;
+	}
+
+	if (!parse_descriptors(dev) || !claim_interface(dev)) {
+		close(dev->fd);
+		free(dev);
+		return NULL;
+	}
+
+	if (dev->input_packet_size > HID_USBFS_MAX_REPORT_SIZE)
+		dev->input_packet_size = HID_USBFS_MAX_REPORT_SIZE;
+
+	for (i = 0; i < HID_USBFS_URBS; i++)
+		submit_urb(dev, &dev->urbs[i]);
+
+	if (!dev->submitted) {
+		hid_usbfs_close(dev);
+		return NULL;
+	}
+
+	return dev;
+}
+
+void hid_usbfs_close(struct hid_usbfs *dev)
+{
+	struct usbdevfs_urb *urb;
+	int i;
+
+	if (!dev)
+		return;
+
+	for (i = 0; i < HID_USBFS_URBS; i++)
+		ioctl(dev->fd, USBDEVFS_DISCARDURB, &dev->urbs[i]);
+
+	/* The discarded URBs still reference their buffers until they are reaped */
+	while (dev->submitted > 0 && ioctl(dev->fd, USBDEVFS_REAPURB, &urb) == 0)
+		dev->submitted--;
+
+	release_interface(dev);
+	close(dev->fd);
+	free(dev);
+}
+
+int hid_usbfs_write(struct hid_usbfs *dev, const unsigned char *data, size_t length)
+{
+	int report_number = data[0];
+	int skipped_report_id = 0;
+	int res;
+
+	/* Like hidraw, a leading report ID 0 is not sent on the wire */
+	if (report_number == 0x0) {
+		data++;
+		length--;
+		skipped_report_id = 1;
+	}
+
+	if (dev->output_endpoint) {
+		struct usbdevfs_bulktransfer transfer;
+
+		/* usbfs runs an interrupt transfer for an interrupt endpoint */
+		transfer.ep = dev->output_endpoint;
+		transfer.len = (unsigned int)length;
+		transfer.timeout = HID_USBFS_WRITE_TIMEOUT_MS;
+		transfer.data = (void *)data;
+		res = ioctl(dev->fd, USBDEVFS_BULK, &transfer);
+	} else {
+		struct usbdevfs_ctrltransfer transfer;
+
+		transfer.bRequestType = USB_DIR_OUT | USB_TYPE_CLASS | USB_RECIP_INTERFACE;
+		transfer.bRequest = HID_SET_REPORT;
+		transfer.wValue = (HID_OUTPUT_REPORT_TYPE << 8) | report_number;
+		transfer.wIndex = dev->interface_number;
+		transfer.wLength = (uint16_t)length;
+		transfer.timeout = HID_USBFS_WRITE_TIMEOUT_MS;
+		transfer.data = (void *)data;
+		res = ioctl(dev->fd, USBDEVFS_CONTROL, &transfer);
+	}
+
+	if (res < 0)
+		return -1;
+
+	return res + skipped_report_id;
+}
+
+/* Copies the report of a reaped URB and puts the URB back in the queue. Returns the
+   report length, 0 for a failed transfer worth retrying and -1 once the device is gone. */
+static int take_urb(struct hid_usbfs *dev, struct usbdevfs_urb *urb, unsigned char *data, size_t length)
+{
+	int res = 0;
+
+	dev->submitted--;
+
+	if (urb->status == -ENODEV || urb->status == -ESHUTDOWN) {
+		dev->disconnected = 1;
+		return -1;
+	}
+
+	if (urb->status == 0) {
+		res = urb->actual_length;
+		if ((size_t)res > length)
+			res = length;
+		memcpy(data, urb->buffer, res);
+	}
+
+	if (submit_urb(dev, urb) != 0 && errno == ENODEV)
+		dev->disconnected = 1;
+
+	return res;
+}
+
+int hid_usbfs_read_timeout(struct hid_usbfs *dev, unsigned char *data, size_t length, int milliseconds)
+{
+	struct usbdevfs_urb *urb;
+	struct timespec deadline, now;
+	struct pollfd fds;
+	int timeout;
+	int res;
+
+	if (milliseconds > 0) {
+		clock_gettime(CLOCK_MONOTONIC, &deadline);
+		deadline.tv_sec += milliseconds / 1000;
+		deadline.tv_nsec += (milliseconds % 1000) * 1000000L;
+		if (deadline.tv_nsec >= 1000000000L) {
+			deadline.tv_sec++;
+			deadline.tv_nsec -= 1000000000L;
+		}
+	}
+
+	for (;;) {
+		/* URBs of one endpoint complete in order, so the reports come out in arrival order */
+		if (ioctl(dev->fd, USBDEVFS_REAPURBNDELAY, &urb) == 0) {
+			res = take_urb(dev, urb, data, length);
+			if (res != 0)
+				return res;
+			continue;
+		}
+
+		if (errno != EAGAIN || dev->disconnected || dev->submitted == 0)
+			return -1;
+
+		if (milliseconds == 0)
+			return 0;
+
+		timeout = -1;
+		if (milliseconds > 0) {
+			clock_gettime(CLOCK_MONOTONIC, &now);
+			timeout = (int)((deadline.tv_sec - now.tv_sec) * 1000 + (deadline.tv_nsec - now.tv_nsec + 999999) / 1000000);
+			if (timeout <= 0)
+				return 0;
+		}
+
+		/* usbfs reports completed URBs as writable */
+		fds.fd = dev->fd;
+		fds.events = POLLOUT;
+		fds.revents = 0;
+		res = poll(&fds, 1, timeout);
+		if (res == 0)
+			return 0;
+		if (res < 0 && errno != EINTR)
+			return -1;
+	}
+}
+
+/* Runs a GET_DESCRIPTOR request for a string descriptor, returns its length or -1 */
+static int get_string_descriptor(struct hid_usbfs *dev, int index, int language, unsigned char *buffer)
+{
+	struct usbdevfs_ctrltransfer transfer;
+	int res;
+
+	transfer.bRequestType = USB_DIR_IN | USB_TYPE_STANDARD | USB_RECIP_DEVICE;
+	transfer.bRequest = USB_REQ_GET_DESCRIPTOR;
+	transfer.wValue = (USB_DT_STRING << 8) | index;
+	transfer.wIndex = language;
+	transfer.wLength = STRING_DESCRIPTOR_SIZE;
+	transfer.timeout = HID_USBFS_WRITE_TIMEOUT_MS;
+	transfer.data = buffer;
+
+	res = ioctl(dev->fd, USBDEVFS_CONTROL, &transfer);
+	if (res < 2 || buffer[1] != USB_DT_STRING)
+		return -1;
+
+	return (buffer[0] < res)? buffer[0]: res;
+}
+
+int hid_usbfs_get_string(struct hid_usbfs *dev, int string_id, wchar_t *string, size_t maxlen)
+{
+	unsigned char buffer[STRING_DESCRIPTOR_SIZE];
+	int language = STRING_LANGUAGE_US_ENGLISH;
+	int index, length, pos;
+	size_t count = 0;
+
+	if (string_id < 0 || string_id > HID_USBFS_STRING_SERIAL)
+		return -1;
+
+	index = dev->string_indices[string_id];
+	if (!index)
+		return -1;
+
+	/* Descriptor 0 lists the languages, the first one is used */
+	if (get_string_descriptor(dev, 0, 0, buffer) >= 4)
+		language = buffer[2] | (buffer[3] << 8);
+
+	length = get_string_descriptor(dev, index, language, buffer);
+	if (length < 0)
+		return -1;
+
+	/* UTF-16LE code units */
+	for (pos = 2; pos + 1 < length && count < maxlen; pos += 2)
+		string[count++] = buffer[pos] | (buffer[pos + 1] << 8);
+	if (count < maxlen)
+		string[count] = 0;
+
+	return 0;
+}
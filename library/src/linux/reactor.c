@@ -0,0 +1,584 @@
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+
+#include "libspectrometer.h"
+#include "internal.h"
+
+/*
+ * Single thread reactor: the hidraw descriptors of all registered devices live in one epoll set,
+ * every device runs at most one request at a time and its state machine advances as reports arrive.
+ * Completed requests only record their result while the reports are processed, the callbacks run
+ * afterwards, when no pointer into the device list is held any more.
+ */
+
+#define REACTOR_MAX_EVENTS 64
+#define REACTOR_MAX_REPORTS 32
+
+typedef enum ReactorOperation_t {REACTOR_IDLE, REACTOR_GET_STATUS, REACTOR_GET_FRAME, REACTOR_READ_FLASH} ReactorOperation_t;
+
+typedef struct ReactorDevice_t {
+    struct Reactor_t* reactor;
+    uintptr_t* deviceContextPtr;
+    int fileDescriptor;             //-1 while the descriptor is not in the epoll set
+
+    ReactorOperation_t operation;
+    ReactorCallback_t callback;
+    void* userData;
+    unsigned long long deadline;    //milliseconds of CLOCK_MONOTONIC
+
+    uint8_t* statusFlags;
+    uint16_t* framesInMemory;
+
+    uint16_t* framePixelsBuffer;
+    uint8_t* flashBuffer;
+    uint32_t flashOffset;           //offset of the current request relative to the start of the buffer
+    uint32_t absoluteOffset;
+    uint32_t bytesToRead;
+
+    uint8_t numOfPacketsToGet;
+    uint8_t numOfPacketsReceived;
+
+    bool completed;                 //the callback is due with completionResult
+    int completionResult;
+
+    struct ReactorDevice_t* next;
+} ReactorDevice_t;
+
+typedef struct Reactor_t {
+    int epollFileDescriptor;
+    ReactorDevice_t* devices;
+    bool running;                   //runReactor() is calling the callbacks
+    bool destroyed;                 //destroyReactor() was called by a callback, runReactor() frees the reactor
+} Reactor_t;
+
+static unsigned long long _monotonicMilliseconds()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000ULL + ts.tv_nsec / 1000000;
+}
+
+static Reactor_t* _getReactor(uintptr_t* reactorPtr)
+{
+    return (reactorPtr && *reactorPtr)? (Reactor_t*)(*reactorPtr) : NULL;
+}
+
+static ReactorDevice_t* _findReactorDevice(Reactor_t* reactor, uintptr_t* deviceContextPtr)
+{
+    ReactorDevice_t* device = reactor->devices;
+
+    while (device && device->deviceContextPtr != deviceContextPtr) {
+        device = device->next;
+    }
+
+    return device;
+}
+
+static void _completeOperation(ReactorDevice_t* device, int result)
+{
+    /* The device is idle again before the callback runs, so the callback may submit the next request */
+    device->operation = REACTOR_IDLE;
+    device->completed = true;
+    device->completionResult = result;
+}
+
+/* Calls the callbacks of the completed requests. A callback may remove devices or destroy the reactor,
+   so the list is searched again from its head after every call. */
+static void _runCallbacks(Reactor_t* reactor)
+{
+    ReactorDevice_t* device = NULL;
+    ReactorCallback_t callback = NULL;
+    uintptr_t* deviceContextPtr = NULL;
+    void* userData = NULL;
+    int result = OK;
+
+    reactor->running = true;
+
+    for (;;) {
+        for (device = reactor->devices; device && !device->completed; device = device->next) {
+        }
+        if (!device) {
+            break;
+        }
+
+        /* A request submitted by the callback replaces these */
+        device->completed = false;
+        callback = device->callback;
+        deviceContextPtr = device->deviceContextPtr;
+        userData = device->userData;
+        result = device->completionResult;
+
+        if (callback) {
+            callback(result, deviceContextPtr, userData);
+        }
+    }
+
+    reactor->running = false;
+}
+
+/* Puts the current descriptor of the device into the epoll set. It changes when the device was reconnected,
+   and a reused number may belong to a new descriptor that epoll dropped with the old one. */
+static int _watchDescriptor(ReactorDevice_t* device)
+{
+    DeviceContext_t* deviceContext = (DeviceContext_t*)(*device->deviceContextPtr);
+    int epollFileDescriptor = device->reactor->epollFileDescriptor;
+    int fileDescriptor = hid_get_fd(deviceContext->handle);
+    struct epoll_event event;
+
+    if (fileDescriptor < 0) {
+        return REACTOR_FAILED;
+    }
+
+    if (device->fileDescriptor >= 0 && device->fileDescriptor != fileDescriptor) {
+        epoll_ctl(epollFileDescriptor, EPOLL_CTL_DEL, device->fileDescriptor, NULL);
+    }
+
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN;
+    event.data.ptr = device;
+
+    if (epoll_ctl(epollFileDescriptor, EPOLL_CTL_MOD, fileDescriptor, &event) != 0 &&
+        (errno != ENOENT || epoll_ctl(epollFileDescriptor, EPOLL_CTL_ADD, fileDescriptor, &event) != 0)) {
+        device->fileDescriptor = -1;
+        return REACTOR_FAILED;
+    }
+
+    device->fileDescriptor = fileDescriptor;
+
+    return OK;
+}
+
+/* Looks up an idle registered device, the common part of all submit functions */
+static int _prepareSubmit(ReactorDevice_t** device, uintptr_t* deviceContextPtr, uintptr_t* reactorPtr)
+{
+    Reactor_t* reactor = _getReactor(reactorPtr);
+    int result = _verifyDeviceContextByPtr(deviceContextPtr);
+
+    if (result != OK) {
+        return result;
+    }
+
+    if (!reactor) {
+        return REACTOR_FAILED;
+    }
+
+    *device = _findReactorDevice(reactor, deviceContextPtr);
+    if (!(*device)) {
+        return REACTOR_FAILED;
+    }
+
+    if ((*device)->operation != REACTOR_IDLE) {
+        return OPERATION_IN_PROGRESS;
+    }
+
+    return OK;
+}
+
+static int _writeRequest(ReactorDevice_t* device, unsigned char* const report)
+{
+    DeviceContext_t* deviceContext = (DeviceContext_t*)(*device->deviceContextPtr);
+    int result = _watchDescriptor(device);
+
+    if (result != OK) {
+        return result;
+    }
+
+    if (hid_write(deviceContext->handle, (const unsigned char*)report, EXTENDED_PACKET_SIZE) != HID_OPERATION_WRITE_SUCCESS) {
+        return WRITING_PROCESS_FAILED;
+    }
+
+    device->deadline = _monotonicMilliseconds() + STANDARD_TIMEOUT_MILLISECONDS;
+    device->numOfPacketsReceived = 0;
+
+    return OK;
+}
+
+static int _requestNextFlashChunk(ReactorDevice_t* device)
+{
+    unsigned char report[EXTENDED_PACKET_SIZE];
+    uint32_t numOfPacketsLeft = (device->bytesToRead - device->flashOffset + READ_FLASH_PAYLOAD - 1) / READ_FLASH_PAYLOAD;
+
+    device->numOfPacketsToGet = (numOfPacketsLeft > MAX_READ_FLASH_PACKETS)? MAX_READ_FLASH_PACKETS : numOfPacketsLeft;
+
+    _fillReadFlashRequest(report, device->absoluteOffset + device->flashOffset, device->numOfPacketsToGet);
+    return _writeRequest(device, report);
+}
+
+/* Feeds one input report to the state machine of the device */
+static void _handleReport(ReactorDevice_t* device, const unsigned char* const report)
+{
+    DeviceContext_t* deviceContext = (DeviceContext_t*)(*device->deviceContextPtr);
+    uint8_t numOfPacketsLeft = 0;
+    int result = OK;
+
+    device->deadline = _monotonicMilliseconds() + STANDARD_TIMEOUT_MILLISECONDS;
+
+    switch (device->operation) {
+        case REACTOR_GET_STATUS:
+            if (report[0] != CORRECT_STATUS_REPLY) {
+                _completeOperation(device, WRONG_ANSWER);
+                return;
+            }
+
+            if (device->statusFlags) {
+                *device->statusFlags = report[1];
+            }
+            if (device->framesInMemory) {
+                *device->framesInMemory = (report[3] << 8) | report[2];
+            }
+
+            _completeOperation(device, OK);
+            return;
+
+        case REACTOR_GET_FRAME:
+            ++device->numOfPacketsReceived;
+
+            result = _parseGetFramePacket(report, device->numOfPacketsToGet, device->numOfPacketsReceived,
+                                          0, deviceContext->numOfPixelsInFrame, device->framePixelsBuffer, &numOfPacketsLeft);
+            if (result != OK || numOfPacketsLeft == 0) {
+                _completeOperation(device, result);
+            }
+            return;
+
+        case REACTOR_READ_FLASH:
+            ++device->numOfPacketsReceived;
+
+            result = _parseReadFlashPacket(report, device->numOfPacketsToGet, device->numOfPacketsReceived,
+                                           device->bytesToRead - device->flashOffset, device->flashBuffer + device->flashOffset, &numOfPacketsLeft);
+            if (result != OK) {
+                _completeOperation(device, result);
+                return;
+            }
+
+            if (numOfPacketsLeft == 0) {
+                device->flashOffset += device->numOfPacketsToGet * READ_FLASH_PAYLOAD;
+
+                if (device->flashOffset < device->bytesToRead) {
+                    result = _requestNextFlashChunk(device);
+                    if (result != OK) {
+                        _completeOperation(device, result);
+                    }
+                } else {
+                    _completeOperation(device, OK);
+                }
+            }
+            return;
+
+        default:
+            //a late reply to a failed request: nobody waits for it
+            return;
+    }
+}
+
+int createReactor(uintptr_t* reactorPtr)
+{
+    Reactor_t* reactor = NULL;
+
+    if (!reactorPtr) {
+        return NO_DEVICE_CONTEXT_ERROR;
+    }
+
+    destroyReactor(reactorPtr);
+
+    reactor = calloc(1, sizeof(Reactor_t));
+    if (!reactor) {
+        return REACTOR_FAILED;
+    }
+
+    reactor->epollFileDescriptor = epoll_create1(EPOLL_CLOEXEC);
+    if (reactor->epollFileDescriptor < 0) {
+        free(reactor);
+        return REACTOR_FAILED;
+    }
+
+    *reactorPtr = (uintptr_t)reactor;
+
+    return OK;
+}
+
+int destroyReactor(uintptr_t* reactorPtr)
+{
+    Reactor_t* reactor = _getReactor(reactorPtr);
+    ReactorDevice_t* device = NULL;
+
+    if (!reactor) {
+        return OK;
+    }
+
+    while ((device = reactor->devices) != NULL) {
+        reactor->devices = device->next;
+        free(device);
+    }
+
+    close(reactor->epollFileDescriptor);
+    *reactorPtr = 0;
+
+    /* Called by a callback: runReactor() still uses the reactor and frees it on return */
+    if (reactor->running) {
+        reactor->destroyed = true;
+        return OK;
+    }
+
+    free(reactor);
+
+    return OK;
+}
+
+int addDeviceToReactor(uintptr_t* deviceContextPtr, uintptr_t* reactorPtr)
+{
+    Reactor_t* reactor = _getReactor(reactorPtr);
+    DeviceContext_t* deviceContext = NULL;
+    ReactorDevice_t* device = NULL;
+    int result = OK;
+
+    result = _verifyDeviceContextByPtr(deviceContextPtr);
+    if (result != OK) {
+        return result;
+    }
+
+    if (!reactor) {
+        return REACTOR_FAILED;
+    }
+
+    deviceContext = (DeviceContext_t*)(*deviceContextPtr);
+
+    if (!deviceContext->handle) {
+        result = _reconnect(deviceContextPtr);
+        if (result != OK) {
+            return result;
+        }
+    }
+
+    if (_findReactorDevice(reactor, deviceContextPtr)) {
+        return OK;
+    }
+
+    device = calloc(1, sizeof(ReactorDevice_t));
+    if (!device) {
+        return REACTOR_FAILED;
+    }
+
+    device->reactor = reactor;
+    device->deviceContextPtr = deviceContextPtr;
+    device->fileDescriptor = -1;
+    device->operation = REACTOR_IDLE;
+
+    result = _watchDescriptor(device);
+    if (result != OK) {
+        free(device);
+        return result;
+    }
+
+    device->next = reactor->devices;
+    reactor->devices = device;
+
+    return OK;
+}
+
+int removeDeviceFromReactor(uintptr_t* deviceContextPtr, uintptr_t* reactorPtr)
+{
+    Reactor_t* reactor = _getReactor(reactorPtr);
+    ReactorDevice_t** link = NULL;
+    ReactorDevice_t* device = NULL;
+
+    if (!reactor) {
+        return REACTOR_FAILED;
+    }
+
+    for (link = &reactor->devices; *link; link = &(*link)->next) {
+        if ((*link)->deviceContextPtr == deviceContextPtr) {
+            device = *link;
+            *link = device->next;
+
+            if (device->fileDescriptor >= 0) {
+                epoll_ctl(reactor->epollFileDescriptor, EPOLL_CTL_DEL, device->fileDescriptor, NULL);
+            }
+            free(device);
+            return OK;
+        }
+    }
+
+    return REACTOR_FAILED;
+}
+
+int submitGetStatus(uint8_t* statusFlags, uint16_t* framesInMemory, ReactorCallback_t callback, void* userData,
+                    uintptr_t* deviceContextPtr, uintptr_t* reactorPtr)
+{
+    unsigned char report[EXTENDED_PACKET_SIZE];
+    ReactorDevice_t* device = NULL;
+    int result = _prepareSubmit(&device, deviceContextPtr, reactorPtr);
+
+    if (result != OK) {
+        return result;
+    }
+
+    report[0] = ZERO_REPORT_ID;
+    report[1] = STATUS_REQUEST;
+
+    device->statusFlags = statusFlags;
+    device->framesInMemory = framesInMemory;
+    device->callback = callback;
+    device->userData = userData;
+
+    result = _writeRequest(device, report);
+    if (result != OK) {
+        return result;
+    }
+
+    device->operation = REACTOR_GET_STATUS;
+    return OK;
+}
+
+int submitGetFrame(uint16_t* framePixelsBuffer, uint16_t numOfFrame, ReactorCallback_t callback, void* userData,
+                   uintptr_t* deviceContextPtr, uintptr_t* reactorPtr)
+{
+    unsigned char report[EXTENDED_PACKET_SIZE];
+    ReactorDevice_t* device = NULL;
+    DeviceContext_t* deviceContext = NULL;
+    uint16_t numOfPacketsToGet = 0;
+    int result = _prepareSubmit(&device, deviceContextPtr, reactorPtr);
+
+    if (result != OK) {
+        return result;
+    }
+
+    if (!framePixelsBuffer) {
+        return INPUT_PARAMETER_NOT_INITIALIZED;
+    }
+
+    deviceContext = (DeviceContext_t*)(*deviceContextPtr);
+
+    /* Only the first frame of a device costs a blocking round trip */
+    if (!deviceContext->numOfPixelsInFrame) {
+        result = getFrameFormat(NULL, NULL, NULL, NULL, deviceContextPtr);
+        if (result != OK) {
+            return result;
+        }
+    }
+
+    numOfPacketsToGet = (deviceContext->numOfPixelsInFrame + NUM_OF_PIXELS_IN_PACKET - 1) / NUM_OF_PIXELS_IN_PACKET;
+    if (numOfPacketsToGet > MAX_PACKETS_IN_FRAME) {
+        return NUM_OF_PACKETS_IN_FRAME_ERROR;
+    }
+
+    device->framePixelsBuffer = framePixelsBuffer;
+    device->numOfPacketsToGet = (uint8_t)numOfPacketsToGet;
+    device->callback = callback;
+    device->userData = userData;
+
+    _fillGetFrameRequest(report, 0, numOfFrame, device->numOfPacketsToGet);
+
+    result = _writeRequest(device, report);
+    if (result != OK) {
+        return result;
+    }
+
+    device->operation = REACTOR_GET_FRAME;
+    return OK;
+}
+
+int submitReadFlash(uint8_t* buffer, uint32_t absoluteOffset, uint32_t bytesToRead, ReactorCallback_t callback, void* userData,
+                    uintptr_t* deviceContextPtr, uintptr_t* reactorPtr)
+{
+    ReactorDevice_t* device = NULL;
+    int result = _prepareSubmit(&device, deviceContextPtr, reactorPtr);
+
+    if (result != OK) {
+        return result;
+    }
+
+    /* Nothing would be sent, so no report could ever complete the request */
+    if (!buffer || !bytesToRead) {
+        return INPUT_PARAMETER_NOT_INITIALIZED;
+    }
+
+    device->flashBuffer = buffer;
+    device->absoluteOffset = absoluteOffset;
+    device->bytesToRead = bytesToRead;
+    device->flashOffset = 0;
+    device->callback = callback;
+    device->userData = userData;
+
+    result = _requestNextFlashChunk(device);
+    if (result != OK) {
+        return result;
+    }
+
+    device->operation = REACTOR_READ_FLASH;
+    return OK;
+}
+
+int runReactor(int timeoutMilliseconds, uintptr_t* reactorPtr)
+{
+    Reactor_t* reactor = _getReactor(reactorPtr);
+    struct epoll_event events[REACTOR_MAX_EVENTS];
+    unsigned char reports[REACTOR_MAX_REPORTS][PACKET_SIZE];
+    int numOfReportsRead = 0, reportIndex = 0;
+    unsigned long long now = 0;
+    ReactorDevice_t* device = NULL;
+    int numOfEvents = 0;
+    int index = 0;
+
+    if (!reactor) {
+        return REACTOR_FAILED;
+    }
+
+    /* Never sleep past the deadline of a running request */
+    now = _monotonicMilliseconds();
+    for (device = reactor->devices; device; device = device->next) {
+        if (device->operation != REACTOR_IDLE) {
+            int untilDeadline = (device->deadline > now)? (int)(device->deadline - now) : 0;
+            if (timeoutMilliseconds < 0 || untilDeadline < timeoutMilliseconds) {
+                timeoutMilliseconds = untilDeadline;
+            }
+        }
+    }
+
+    numOfEvents = epoll_wait(reactor->epollFileDescriptor, events, REACTOR_MAX_EVENTS, timeoutMilliseconds);
+    if (numOfEvents < 0) {
+        return (errno == EINTR)? OK : REACTOR_FAILED;
+    }
+
+    for (index = 0; index < numOfEvents; ++index) {
+        device = (ReactorDevice_t*)events[index].data.ptr;
+
+        if (events[index].events & (EPOLLERR | EPOLLHUP)) {
+            /* A level triggered hang-up would wake every later wait at once, the next submit watches the descriptor again */
+            epoll_ctl(reactor->epollFileDescriptor, EPOLL_CTL_DEL, device->fileDescriptor, NULL);
+            device->fileDescriptor = -1;
+
+            if (device->operation != REACTOR_IDLE) {
+                _completeOperation(device, READING_PROCESS_FAILED);
+            }
+            continue;
+        }
+
+        /* Take every report that is already queued, the descriptor stays readable until then */
+        do {
+            numOfReportsRead = hid_read_many(((DeviceContext_t*)(*device->deviceContextPtr))->handle, (unsigned char*)reports,
+                                             PACKET_SIZE, REACTOR_MAX_REPORTS, 0);
+            for (reportIndex = 0; reportIndex < numOfReportsRead; ++reportIndex) {
+                _handleReport(device, reports[reportIndex]);
+            }
+        } while (numOfReportsRead == REACTOR_MAX_REPORTS);
+    }
+
+    now = _monotonicMilliseconds();
+    for (device = reactor->devices; device; device = device->next) {
+        if (device->operation != REACTOR_IDLE && device->deadline <= now) {
+            _completeOperation(device, READING_PROCESS_FAILED);
+        }
+    }
+
+    _runCallbacks(reactor);
+
+    if (reactor->destroyed) {
+        free(reactor);
+    }
+
+    return OK;
+}
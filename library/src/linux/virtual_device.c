@@ -0,0 +1,781 @@
+/*******************************************************
+ Virtual spectrometer - firmware model and in-process transport.
+
+ See virtual_device.h for an overview. Frames are not stored as pixel
+ arrays: the model keeps the time the current run started and derives the
+ number of captured frames from the exposure, scan mode and blank scans,
+ so the timing of framesInMemory and of the status flags follows the
+ configured exposure exactly. Pixel values are a deterministic function
+ of the frame, its exposure and the pixel index.
+********************************************************/
+
+/* C */
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <time.h>
+
+/* Unix */
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+
+#include "internal.h"
+#include "virtual_device.h"
+
+#define NANOSECONDS_IN_EXPOSURE_UNIT 10000ULL /* exposure is a multiple of 10 us */
+
+#define STATUS_FLAG_ACQUISITION_ACTIVE 0x01
+#define STATUS_FLAG_MEMORY_FULL 0x02
+
+#define VIRTUAL_REPLY_ERROR 0xFF
+
+#define DEFAULT_EXPOSURE 10
+#define DARK_LEVEL 1500
+
+struct virtual_device {
+	pthread_mutex_t lock;
+	unsigned int index;
+	char serial[32];
+
+	/* frame format */
+	unsigned short start_element;
+	unsigned short end_element;
+	unsigned char reduction_mode;
+	unsigned short pixels_in_frame;
+
+	/* acquisition parameters */
+	unsigned short scans;
+	unsigned short blank_scans;
+	unsigned char scan_mode;
+	unsigned int exposure;
+
+	/* triggers */
+	unsigned char trigger_enable;
+	unsigned char trigger_front;
+	unsigned char optical_mode;
+	unsigned short optical_pixel;
+	unsigned short optical_threshold;
+
+	/* acquisition state */
+	int acquiring;
+	unsigned long long run_started_ns;  /* start of the current run of frame slots */
+	unsigned int run_base_frames;       /* frames stored before run_started_ns */
+	unsigned int pending_triggers;      /* EVERY_FRAME_IDLE_MODE: slots allowed by software triggers */
+	unsigned int slots_done;            /* EVERY_FRAME_IDLE_MODE: slots read, including blank ones */
+	unsigned int frames_stored;
+	unsigned int frame_exposure[VIRTUAL_DEVICE_MAX_FRAMES];
+
+	int detached;
+
+	unsigned char flash[VIRTUAL_DEVICE_FLASH_SIZE];
+};
+
+struct firmware_link {
+	struct virtual_device *device;
+	int fd;
+	long interval_us;
+	unsigned long long next_report_ns;
+	unsigned long loss_period;  /* one report in loss_period is dropped, 0 for none */
+	unsigned int loss_state;    /* xorshift state, the same losses on every run */
+};
+
+/* Replies of one request, built under the device lock and emitted once it is released */
+#define MAX_REPLIES ((MAX_PACKETS_IN_FRAME > MAX_READ_FLASH_PACKETS)? MAX_PACKETS_IN_FRAME: MAX_READ_FLASH_PACKETS)
+
+struct reply_batch {
+	unsigned int count;
+	unsigned char reports[MAX_REPLIES][PACKET_SIZE];
+};
+
+static pthread_mutex_t devices_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct virtual_device *devices[VIRTUAL_DEVICE_MAX_COUNT];
+
+static unsigned long long monotonic_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static unsigned long env_unsigned(const char *name)
+{
+	const char *value = getenv(name);
+	if (!value || !*value)
+		return 0;
+	return strtoul(value, NULL, 10);
+}
+
+unsigned int virtual_device_count(void)
+{
+	unsigned long count = env_unsigned(VIRTUAL_DEVICE_COUNT_ENV);
+	return (count > VIRTUAL_DEVICE_MAX_COUNT)? VIRTUAL_DEVICE_MAX_COUNT: (unsigned int)count;
+}
+
+int virtual_device_parse_path(const char *path, unsigned int *index)
+{
+	size_t prefix_length = strlen(VIRTUAL_DEVICE_PATH_PREFIX);
+	char *end = NULL;
+	unsigned long value;
+
+	if (!path || strncmp(path, VIRTUAL_DEVICE_PATH_PREFIX, prefix_length) != 0)
+		return 0;
+
+	value = strtoul(path + prefix_length, &end, 10);
+	if (end == path + prefix_length || *end != '\0' || value >= VIRTUAL_DEVICE_MAX_COUNT)
+		return 0;
+
+	if (index)
+		*index = (unsigned int)value;
+	return 1;
+}
+
+struct hid_device_info *virtual_device_enumerate(unsigned short vendor_id, unsigned short product_id)
+{
+	struct hid_device_info *root = NULL, *cur_dev = NULL;
+	unsigned int count = virtual_device_count();
+	unsigned int index;
+	char buffer[64];
+
+	if ((vendor_id != 0x0 && vendor_id != VIRTUAL_DEVICE_VID) ||
+	    (product_id != 0x0 && product_id != VIRTUAL_DEVICE_PID))
+		return NULL;
+
+	for (index = 0; index < count; ++index) {
+		struct hid_device_info *tmp = calloc(1, sizeof(struct hid_device_info));
+		if (cur_dev)
+			cur_dev->next = tmp;
+		else
+			root = tmp;
+		cur_dev = tmp;
+
+		snprintf(buffer, sizeof(buffer), VIRTUAL_DEVICE_PATH_PREFIX "%u", index);
+		cur_dev->path = strdup(buffer);
+		cur_dev->vendor_id = VIRTUAL_DEVICE_VID;
+		cur_dev->product_id = VIRTUAL_DEVICE_PID;
+
+		snprintf(buffer, sizeof(buffer), VIRTUAL_DEVICE_SERIAL_FORMAT, index);
+		cur_dev->serial_number = calloc(strlen(buffer) + 1, sizeof(wchar_t));
+		mbstowcs(cur_dev->serial_number, buffer, strlen(buffer) + 1);
+
+		cur_dev->manufacturer_string = wcsdup(VIRTUAL_DEVICE_MANUFACTURER);
+		cur_dev->product_string = wcsdup(VIRTUAL_DEVICE_PRODUCT);
+		cur_dev->interface_number = 0;
+	}
+
+	return root;
+}
+
+static unsigned short frame_pixels(unsigned short start, unsigned short end, unsigned char reduction)
+{
+	return VIRTUAL_DEVICE_LEADING_PIXELS + ((end - start + 1) >> reduction) + VIRTUAL_DEVICE_TRAILING_PIXELS;
+}
+
+static void reset_parameters(struct virtual_device *device)
+{
+	device->start_element = 0;
+	device->end_element = VIRTUAL_DEVICE_MAX_ELEMENT;
+	device->reduction_mode = NO_AVERAGE;
+	device->pixels_in_frame = frame_pixels(device->start_element, device->end_element, device->reduction_mode);
+
+	device->scans = 1;
+	device->blank_scans = 0;
+	device->scan_mode = CONTINUOUS_MODE;
+	device->exposure = DEFAULT_EXPOSURE;
+
+	device->trigger_enable = EXTERNAL_TRIGGER_DISABLED;
+	device->trigger_front = FRONT_DISABLED;
+	device->optical_mode = OPTICAL_TRIGGER_DISABLED;
+	device->optical_pixel = 0;
+	device->optical_threshold = 0;
+}
+
+static void clear_memory(struct virtual_device *device)
+{
+	device->acquiring = 0;
+	device->frames_stored = 0;
+	device->run_base_frames = 0;
+	device->pending_triggers = 0;
+	device->slots_done = 0;
+}
+
+struct virtual_device *virtual_device_new(unsigned int index)
+{
+	struct virtual_device *device = calloc(1, sizeof(struct virtual_device));
+	if (!device)
+		return NULL;
+
+	pthread_mutex_init(&device->lock, NULL);
+	device->index = index;
+	snprintf(device->serial, sizeof(device->serial), VIRTUAL_DEVICE_SERIAL_FORMAT, index);
+	memset(device->flash, 0xFF, sizeof(device->flash));
+
+	reset_parameters(device);
+	clear_memory(device);
+
+	return device;
+}
+
+void virtual_device_free(struct virtual_device *device)
+{
+	if (!device)
+		return;
+	pthread_mutex_destroy(&device->lock);
+	free(device);
+}
+
+struct virtual_device *virtual_device_get(unsigned int index)
+{
+	struct virtual_device *device = NULL;
+
+	if (index >= VIRTUAL_DEVICE_MAX_COUNT)
+		return NULL;
+
+	pthread_mutex_lock(&devices_lock);
+	if (!devices[index])
+		devices[index] = virtual_device_new(index);
+	device = devices[index];
+	pthread_mutex_unlock(&devices_lock);
+
+	return device;
+}
+
+const char *virtual_device_serial(const struct virtual_device *device)
+{
+	return device? device->serial: NULL;
+}
+
+static unsigned int frame_capacity(const struct virtual_device *device)
+{
+	if (device->scan_mode == FRAME_AVERAGING_MODE)
+		return 1;
+	return (device->scans > VIRTUAL_DEVICE_MAX_FRAMES)? VIRTUAL_DEVICE_MAX_FRAMES: device->scans;
+}
+
+static unsigned long long exposure_period_ns(const struct virtual_device *device)
+{
+	unsigned int exposure = device->exposure? device->exposure: 1;
+	return exposure * NANOSECONDS_IN_EXPOSURE_UNIT;
+}
+
+static void store_frames(struct virtual_device *device, unsigned int frames)
+{
+	unsigned int capacity = frame_capacity(device);
+
+	if (frames > capacity)
+		frames = capacity;
+
+	while (device->frames_stored < frames) {
+		device->frame_exposure[device->frames_stored] = device->exposure;
+		++device->frames_stored;
+	}
+
+	if (device->frames_stored == capacity &&
+	    device->scan_mode != CONTINUOUS_MODE &&
+	    device->scan_mode != FRAME_AVERAGING_MODE) {
+		/* idle modes stop reading the CCD once all the frames are taken */
+		device->acquiring = 0;
+	}
+}
+
+/* Brings frames_stored up to date with the current time. */
+static void advance_acquisition(struct virtual_device *device, unsigned long long now)
+{
+	unsigned long long period = exposure_period_ns(device);
+	unsigned long long slots;
+
+	if (!device->acquiring || now < device->run_started_ns)
+		return;
+
+	slots = (now - device->run_started_ns) / period;
+
+	switch (device->scan_mode) {
+		case EVERY_FRAME_IDLE_MODE:
+			/* every slot, including blank ones, needs its own trigger */
+			if (slots > device->pending_triggers)
+				slots = device->pending_triggers;
+			while (slots--) {
+				if (device->slots_done % (device->blank_scans + 1) == 0)
+					store_frames(device, device->frames_stored + 1);
+				++device->slots_done;
+				--device->pending_triggers;
+				device->run_started_ns += period;
+			}
+			break;
+
+		case FRAME_AVERAGING_MODE:
+			/* one averaged frame becomes available after every numOfScans frames */
+			if (slots >= (device->scans? device->scans: 1))
+				store_frames(device, 1);
+			break;
+
+		case CONTINUOUS_MODE:
+		case FIRST_FRAME_IDLE_MODE:
+		default:
+			/* frame k is completed after k * (blank_scans + 1) + 1 slots */
+			if (slots > 0)
+				store_frames(device, device->run_base_frames + (unsigned int)((slots - 1) / (device->blank_scans + 1) + 1));
+			break;
+	}
+}
+
+/* Starts a new run of frame slots at 'now', keeping the frames that are already stored. */
+static void rebase_acquisition(struct virtual_device *device, unsigned long long now)
+{
+	advance_acquisition(device, now);
+	device->run_started_ns = now;
+	device->run_base_frames = device->frames_stored;
+}
+
+static void trigger(struct virtual_device *device, unsigned long long now)
+{
+	if (device->scan_mode == EVERY_FRAME_IDLE_MODE) {
+		advance_acquisition(device, now);
+		if (!device->acquiring || !device->pending_triggers) {
+			device->run_started_ns = now;
+		}
+		device->acquiring = (device->frames_stored < frame_capacity(device));
+		if (device->acquiring)
+			++device->pending_triggers;
+		return;
+	}
+
+	clear_memory(device);
+	device->acquiring = 1;
+	device->run_started_ns = now;
+}
+
+static unsigned char status_flags(const struct virtual_device *device)
+{
+	unsigned char flags = 0;
+
+	if (device->acquiring)
+		flags |= STATUS_FLAG_ACQUISITION_ACTIVE;
+
+	if (device->scan_mode != FRAME_AVERAGING_MODE &&
+	    device->frames_stored > 0 &&
+	    device->frames_stored >= frame_capacity(device))
+		flags |= STATUS_FLAG_MEMORY_FULL;
+
+	return flags;
+}
+
+/* Dark level, two emission lines scaled by exposure and a deterministic ripple. */
+static unsigned short pixel_value(unsigned int frame_id, unsigned int exposure, unsigned int pixel)
+{
+	static const unsigned int lines[] = {900, 2400};
+	unsigned int value = DARK_LEVEL;
+	unsigned int scale = (exposure > 2000)? 2000: exposure;
+	unsigned int i;
+
+	for (i = 0; i < sizeof(lines) / sizeof(lines[0]); ++i) {
+		unsigned int distance = (pixel > lines[i])? pixel - lines[i]: lines[i] - pixel;
+		if (distance < 40)
+			value += (40 - distance) * scale / 2;
+	}
+
+	value += ((pixel * 2654435761U) ^ (frame_id * 40503U)) >> 28;
+
+	return (value > 0xFFFF)? 0xFFFF: (unsigned short)value;
+}
+
+static void emit_reply(struct reply_batch *batch, unsigned char *reply)
+{
+	if (batch->count < MAX_REPLIES)
+		memcpy(batch->reports[batch->count++], reply, PACKET_SIZE);
+}
+
+static void emit_error(struct reply_batch *batch, unsigned char code, unsigned char *reply)
+{
+	memset(reply, 0, PACKET_SIZE);
+	reply[0] = code;
+	reply[3] = VIRTUAL_REPLY_ERROR;
+	emit_reply(batch, reply);
+}
+
+static void handle_get_frame(struct virtual_device *device, const unsigned char *request, struct reply_batch *batch)
+{
+	unsigned char reply[PACKET_SIZE];
+	unsigned int offset = request[1] | (request[2] << 8);
+	unsigned int frame = request[3] | (request[4] << 8);
+	unsigned int packets = request[5];
+	unsigned int frame_id, exposure;
+	unsigned int packet, pixel, index;
+
+	if (frame == 0xFFFF) {
+		if (!device->frames_stored) {
+			emit_error(batch, CORRECT_GET_FRAME_REPLY, reply);
+			return;
+		}
+		frame_id = (device->scan_mode == FRAME_AVERAGING_MODE)? 0xFFFF: device->frames_stored - 1;
+		exposure = device->frame_exposure[device->frames_stored - 1];
+	} else {
+		if (frame >= device->frames_stored) {
+			emit_error(batch, CORRECT_GET_FRAME_REPLY, reply);
+			return;
+		}
+		frame_id = frame;
+		exposure = device->frame_exposure[frame];
+	}
+
+	if (!packets || packets > MAX_PACKETS_IN_FRAME || offset >= device->pixels_in_frame) {
+		emit_error(batch, CORRECT_GET_FRAME_REPLY, reply);
+		return;
+	}
+
+	for (packet = 0; packet < packets; ++packet) {
+		pixel = offset + packet * NUM_OF_PIXELS_IN_PACKET;
+
+		memset(reply, 0, sizeof(reply));
+		reply[0] = CORRECT_GET_FRAME_REPLY;
+		reply[1] = LOW_BYTE(pixel);
+		reply[2] = HIGH_BYTE(pixel);
+		reply[3] = (unsigned char)(packets - packet - 1);
+
+		for (index = 0; index < NUM_OF_PIXELS_IN_PACKET && pixel + index < device->pixels_in_frame; ++index) {
+			unsigned short value = pixel_value(frame_id, exposure, pixel + index);
+			reply[4 + 2 * index] = LOW_BYTE(value);
+			reply[5 + 2 * index] = HIGH_BYTE(value);
+		}
+
+		emit_reply(batch, reply);
+	}
+}
+
+static void handle_read_flash(struct virtual_device *device, const unsigned char *request, struct reply_batch *batch)
+{
+	unsigned char reply[PACKET_SIZE];
+	const unsigned int payload = PACKET_SIZE - 4;
+	unsigned int offset = request[1] | (request[2] << 8) | (request[3] << 16) | ((unsigned int)request[4] << 24);
+	unsigned int packets = request[5];
+	unsigned int packet, local, index;
+
+	if (!packets || packets > MAX_READ_FLASH_PACKETS || offset >= VIRTUAL_DEVICE_FLASH_SIZE) {
+		emit_error(batch, CORRECT_READ_FLASH_REPLY, reply);
+		return;
+	}
+
+	for (packet = 0; packet < packets; ++packet) {
+		local = packet * payload;
+
+		reply[0] = CORRECT_READ_FLASH_REPLY;
+		reply[1] = LOW_BYTE(local);
+		reply[2] = HIGH_BYTE(local);
+		reply[3] = (unsigned char)(packets - packet - 1);
+
+		for (index = 0; index < payload; ++index) {
+			unsigned int address = offset + local + index;
+			reply[4 + index] = (address < VIRTUAL_DEVICE_FLASH_SIZE)? device->flash[address]: 0xFF;
+		}
+
+		emit_reply(batch, reply);
+	}
+}
+
+static unsigned char handle_write_flash(struct virtual_device *device, const unsigned char *request, size_t length)
+{
+	unsigned int offset = request[1] | (request[2] << 8) | (request[3] << 16) | ((unsigned int)request[4] << 24);
+	unsigned int count = request[5];
+	unsigned int index;
+
+	if (count > MAX_FLASH_WRITE_PAYLOAD || 6 + count > length || offset + count > VIRTUAL_DEVICE_FLASH_SIZE)
+		return 1;
+
+	/* programming can only clear bits, erasing sets them back */
+	for (index = 0; index < count; ++index)
+		device->flash[offset + index] &= request[6 + index];
+
+	return 0;
+}
+
+static void handle_report(struct virtual_device *device, const unsigned char *report, size_t length, struct reply_batch *batch)
+{
+	unsigned char reply[PACKET_SIZE];
+	unsigned long long now = monotonic_ns();
+
+	if (device->detached)
+		return;
+
+	advance_acquisition(device, now);
+	memset(reply, 0, sizeof(reply));
+
+	switch (report[0]) {
+		case STATUS_REQUEST:
+			reply[0] = CORRECT_STATUS_REPLY;
+			reply[1] = status_flags(device);
+			reply[2] = LOW_BYTE(device->frames_stored);
+			reply[3] = HIGH_BYTE(device->frames_stored);
+			emit_reply(batch, reply);
+			break;
+
+		case SET_EXPOSURE_REQUEST: {
+			unsigned int exposure = report[1] | (report[2] << 8) | (report[3] << 16) | ((unsigned int)report[4] << 24);
+			reply[0] = CORRECT_SET_EXPOSURE_REPLY;
+			if (exposure) {
+				/* applied from the next frame on */
+				rebase_acquisition(device, now);
+				device->exposure = exposure;
+			} else {
+				reply[1] = 1;
+			}
+			emit_reply(batch, reply);
+			break;
+		}
+
+		case SET_ACQUISITION_PARAMETERS_REQUEST:
+		case SET_ALL_PARAMETERS_REQUEST: {
+			unsigned int exposure = report[6] | (report[7] << 8) | (report[8] << 16) | ((unsigned int)report[9] << 24);
+			unsigned char scan_mode = report[5];
+
+			reply[0] = (report[0] == SET_ALL_PARAMETERS_REQUEST)? CORRECT_SET_ALL_PARAMETERS_REPLY: CORRECT_SET_ACQUISITION_PARAMETERS_REPLY;
+			if (scan_mode > FRAME_AVERAGING_MODE || !exposure) {
+				reply[1] = 1;
+				emit_reply(batch, reply);
+				break;
+			}
+
+			clear_memory(device);
+			device->scans = report[1] | (report[2] << 8);
+			device->blank_scans = report[3] | (report[4] << 8);
+			device->scan_mode = scan_mode;
+			device->exposure = exposure;
+
+			if (report[0] == SET_ALL_PARAMETERS_REQUEST) {
+				device->trigger_enable = report[10];
+				device->trigger_front = report[11];
+				if (device->trigger_enable == EXTERNAL_TRIGGER_DISABLED || device->trigger_front == FRONT_DISABLED)
+					trigger(device, now);
+			}
+			emit_reply(batch, reply);
+			break;
+		}
+
+		case SET_FRAME_FORMAT_REQUEST: {
+			unsigned short start = report[1] | (report[2] << 8);
+			unsigned short end = report[3] | (report[4] << 8);
+
+			reply[0] = CORRECT_SET_FRAME_FORMAT_REPLY;
+			if (start > end || end > VIRTUAL_DEVICE_MAX_ELEMENT || report[5] > AVERAGE_OF_8) {
+				reply[1] = 1;
+			} else {
+				clear_memory(device);
+				device->start_element = start;
+				device->end_element = end;
+				device->reduction_mode = report[5];
+				device->pixels_in_frame = frame_pixels(start, end, report[5]);
+			}
+			reply[2] = LOW_BYTE(device->pixels_in_frame);
+			reply[3] = HIGH_BYTE(device->pixels_in_frame);
+			emit_reply(batch, reply);
+			break;
+		}
+
+		case SET_EXTERNAL_TRIGGER_REQUEST:
+			device->trigger_enable = report[1];
+			device->trigger_front = report[2];
+			reply[0] = CORRECT_SET_EXTERNAL_TRIGGER_REPLY;
+			emit_reply(batch, reply);
+			break;
+
+		case SET_SOFTWARE_TRIGGER_REQUEST:
+			trigger(device, now);
+			break;
+
+		case CLEAR_MEMORY_REQUEST:
+			clear_memory(device);
+			reply[0] = CORRECT_CLEAR_MEMORY_REPLY;
+			emit_reply(batch, reply);
+			break;
+
+		case GET_FRAME_FORMAT_REQUEST:
+			reply[0] = CORRECT_GET_FRAME_FORMAT_REPLY;
+			reply[1] = LOW_BYTE(device->start_element);
+			reply[2] = HIGH_BYTE(device->start_element);
+			reply[3] = LOW_BYTE(device->end_element);
+			reply[4] = HIGH_BYTE(device->end_element);
+			reply[5] = device->reduction_mode;
+			reply[6] = LOW_BYTE(device->pixels_in_frame);
+			reply[7] = HIGH_BYTE(device->pixels_in_frame);
+			emit_reply(batch, reply);
+			break;
+
+		case GET_ACQUISITION_PARAMETERS_REQUEST:
+			reply[0] = CORRECT_GET_ACQUISITION_PARAMETERS_REPLY;
+			reply[1] = LOW_BYTE(device->scans);
+			reply[2] = HIGH_BYTE(device->scans);
+			reply[3] = LOW_BYTE(device->blank_scans);
+			reply[4] = HIGH_BYTE(device->blank_scans);
+			reply[5] = device->scan_mode;
+			reply[6] = LOW_BYTE(LOW_WORD(device->exposure));
+			reply[7] = HIGH_BYTE(LOW_WORD(device->exposure));
+			reply[8] = LOW_BYTE(HIGH_WORD(device->exposure));
+			reply[9] = HIGH_BYTE(HIGH_WORD(device->exposure));
+			emit_reply(batch, reply);
+			break;
+
+		case GET_FRAME_REQUEST:
+			handle_get_frame(device, report, batch);
+			break;
+
+		case SET_OPTICAl_TRIGGER_REQUEST:
+			device->optical_mode = report[1];
+			device->optical_pixel = report[2] | (report[3] << 8);
+			device->optical_threshold = report[4] | (report[5] << 8);
+			reply[0] = CORRECT_SET_OPTICAL_TRIGGER_REPLY;
+			emit_reply(batch, reply);
+			break;
+
+		case READ_FLASH_REQUEST:
+			handle_read_flash(device, report, batch);
+			break;
+
+		case WRITE_FLASH_REQUEST:
+			reply[0] = CORRECT_WRITE_FLASH_REPLY;
+			reply[1] = handle_write_flash(device, report, length);
+			emit_reply(batch, reply);
+			break;
+
+		case ERASE_FLASH_REQUEST:
+			memset(device->flash, 0xFF, sizeof(device->flash));
+			reply[0] = CORRECT_ERASE_FLASH_REPLY;
+			emit_reply(batch, reply);
+			break;
+
+		case RESET_REQUEST:
+			reset_parameters(device);
+			clear_memory(device);
+			break;
+
+		case DETACH_REQUEST:
+			/* gone from the bus until the process restarts */
+			device->detached = 1;
+			break;
+
+		default:
+			/* unknown requests are ignored by the firmware */
+			break;
+	}
+}
+
+void virtual_device_handle_report(struct virtual_device *device, const unsigned char *request, size_t length,
+                                  virtual_device_emit_fn emit, void *context)
+{
+	struct reply_batch batch;
+	unsigned char report[PACKET_SIZE];
+	unsigned int index;
+
+	if (!device || !request || !length)
+		return;
+
+	batch.count = 0;
+
+	/* short output reports are zero padded by the HID layer */
+	memset(report, 0, sizeof(report));
+	memcpy(report, request, (length > sizeof(report))? sizeof(report): length);
+
+	pthread_mutex_lock(&device->lock);
+	handle_report(device, report, length, &batch);
+	pthread_mutex_unlock(&device->lock);
+
+	/* paced or blocking transports must not hold up the other users of the device */
+	for (index = 0; emit && index < batch.count; ++index)
+		emit(context, batch.reports[index], PACKET_SIZE);
+}
+
+static void emit_to_socket(void *context, const unsigned char *report, size_t length)
+{
+	struct firmware_link *link = (struct firmware_link *)context;
+
+	if (link->interval_us > 0) {
+		struct timespec ts;
+		unsigned long long now = monotonic_ns();
+
+		if (link->next_report_ns > now) {
+			ts.tv_sec = link->next_report_ns / 1000000000ULL;
+			ts.tv_nsec = link->next_report_ns % 1000000000ULL;
+			while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+				;
+		} else {
+			link->next_report_ns = now;
+		}
+		link->next_report_ns += link->interval_us * 1000ULL;
+	}
+
+	if (link->loss_period) {
+		link->loss_state ^= link->loss_state << 13;
+		link->loss_state ^= link->loss_state >> 17;
+		link->loss_state ^= link->loss_state << 5;
+		if (link->loss_state % link->loss_period == 0)
+			return;
+	}
+
+	/* MSG_NOSIGNAL: the host side may already be closed */
+	send(link->fd, report, length, MSG_NOSIGNAL);
+}
+
+static void *firmware_thread(void *argument)
+{
+	struct firmware_link *link = (struct firmware_link *)argument;
+	unsigned char report[EXTENDED_PACKET_SIZE];
+	ssize_t received;
+
+	for (;;) {
+		received = recv(link->fd, report, sizeof(report), 0);
+		if (received < 0 && errno == EINTR)
+			continue;
+		if (received <= 0)
+			break;
+
+		/* output reports start with the report ID, exactly as written to hidraw */
+		if (received > 1)
+			virtual_device_handle_report(link->device, report + 1, received - 1, emit_to_socket, link);
+	}
+
+	close(link->fd);
+	free(link);
+	return NULL;
+}
+
+int virtual_device_open(unsigned int index)
+{
+	struct virtual_device *device = virtual_device_get(index);
+	struct firmware_link *link = NULL;
+	pthread_attr_t attributes;
+	pthread_t thread;
+	int fds[2];
+	int ret;
+
+	if (!device || index >= virtual_device_count())
+		return -1;
+
+	if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, fds) < 0)
+		return -1;
+
+	link = calloc(1, sizeof(struct firmware_link));
+	if (!link) {
+		close(fds[0]);
+		close(fds[1]);
+		return -1;
+	}
+	link->device = device;
+	link->fd = fds[1];
+	link->interval_us = (long)env_unsigned(VIRTUAL_DEVICE_PACKET_INTERVAL_ENV);
+	link->loss_period = env_unsigned(VIRTUAL_DEVICE_PACKET_LOSS_ENV);
+	link->loss_state = 2463534242u + index;
+
+	pthread_attr_init(&attributes);
+	pthread_attr_setdetachstate(&attributes, PTHREAD_CREATE_DETACHED);
+	ret = pthread_create(&thread, &attributes, firmware_thread, link);
+	pthread_attr_destroy(&attributes);
+
+	if (ret != 0) {
+		close(fds[0]);
+		close(fds[1]);
+		free(link);
+		return -1;
+	}
+
+	return fds[0];
+}
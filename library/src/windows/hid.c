@@ -740,6 +740,31 @@ int HID_API_EXPORT HID_API_CALL hid_read(hid_device *dev, unsigned char *data, s
 	return hid_read_timeout(dev, data, length, (dev->blocking)? -1: 0);
 }
 
+int HID_API_EXPORT HID_API_CALL hid_read_many(hid_device *dev, unsigned char *data, size_t report_length, size_t max_reports, int milliseconds)
+{
+	size_t count;
+	int bytes_read;
+
+	if (max_reports == 0)
+		return 0;
+
+	bytes_read = hid_read_timeout(dev, data, report_length, milliseconds);
+	if (bytes_read <= 0)
+		return bytes_read;
+	/* A short report would leave the bytes of an older one in its slot */
+	if ((size_t)bytes_read < report_length)
+		return -1;
+
+	/* The overlapped read completes at once when a report is already buffered */
+	for (count = 1; count < max_reports; count++) {
+		bytes_read = hid_read_timeout(dev, data + count * report_length, report_length, 0);
+		if (bytes_read <= 0 || (size_t)bytes_read < report_length)
+			break;
+	}
+
+	return (int)count;
+}
+
 int HID_API_EXPORT HID_API_CALL hid_set_nonblocking(hid_device *dev, int nonblock)
 {
 	dev->blocking = !nonblock;
@@ -872,6 +897,44 @@ HID_API_EXPORT const wchar_t * HID_API_CALL  hid_error(hid_device *dev)
 	return (wchar_t*)dev->last_error_str;
 }
 
+int HID_API_EXPORT HID_API_CALL hid_get_report_times(hid_device *dev, long long *first_ns, long long *last_ns)
+{
+	/* Reports are not stamped on Windows */
+	return -1;
+}
+
+int HID_API_EXPORT HID_API_CALL hid_set_busy_poll(hid_device *dev, int max_spin_us)
+{
+	/* Overlapped reads always wait on their event */
+	return -1;
+}
+
+int HID_API_EXPORT HID_API_CALL hid_get_fd(hid_device *dev)
+{
+	/* Overlapped reads have no pollable descriptor */
+	return -1;
+}
+
+HID_API_EXPORT hid_hotplug_monitor * HID_API_CALL hid_hotplug_monitor_new(unsigned short vendor_id, unsigned short product_id)
+{
+	/* Hotplug notifications are not implemented on Windows */
+	return NULL;
+}
+
+int HID_API_EXPORT HID_API_CALL hid_hotplug_monitor_get_fd(hid_hotplug_monitor *monitor)
+{
+	return -1;
+}
+
+int HID_API_EXPORT HID_API_CALL hid_hotplug_monitor_receive(hid_hotplug_monitor *monitor, int *event, struct hid_device_info **device)
+{
+	return -1;
+}
+
+void HID_API_EXPORT HID_API_CALL hid_hotplug_monitor_free(hid_hotplug_monitor *monitor)
+{
+}
+
 
 /*#define PICPGM*/
 /*#define S11*/